@@ -0,0 +1,34 @@
+#!/bin/sh
+# Generate the kernel symbol table (C source using the KernelSymbol type from
+# src/kernel/ksyms.h) from a linked kernel and write it to stdout; the Makefile
+# saves it as $(BUILD_DIR)/ksyms_table.c.
+# Usage: gen_ksyms.sh <nm> <kernel.elf> > ksyms_table.c
+NM="$1"
+ELF="$2"
+
+"$NM" -n "$ELF" | awk '
+BEGIN { n = 0 }
+NF == 3 && $2 ~ /^[Tt]$/ {
+    addr[n] = $1; name[n] = $3; n++
+    if ($3 == "ksyms_find") anchor = $1
+}
+END {
+    print "// Generated by scripts/gen_ksyms.sh - do not edit"
+    print "#include \"ksyms.h\""
+    print ""
+    printf "const uint32_t ksyms_table_size = %d;\n", n
+    printf "const uint64_t ksyms_anchor = 0x%sULL;\n", (anchor == "" ? "0" : anchor)
+    print ""
+    print "const KernelSymbol ksyms_table[] = {"
+    off = 0
+    for (i = 0; i < n; i++) {
+        printf "    {0x%sULL, %d},\n", addr[i], off
+        off += length(name[i]) + 1
+    }
+    if (n == 0) print "    {0, 0},"
+    print "};"
+    print ""
+    print "const char ksyms_names[] ="
+    for (i = 0; i < n; i++) printf "    \"%s\\0\"\n", name[i]
+    print "    \"\";"
+}'
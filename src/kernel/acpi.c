@@ -0,0 +1,81 @@
+#include "acpi.h"
+#include "limine.h"
+#include "platform.h"
+#include <stddef.h>
+
+__attribute__((used, section(".requests")))
+static volatile struct limine_rsdp_request rsdp_request = {
+    .id = LIMINE_RSDP_REQUEST,
+    .revision = 0,
+    .response = NULL
+};
+
+static const acpi_rsdp_t *rsdp = NULL;
+static const acpi_sdt_header_t *root_table = NULL;  // XSDT, or RSDT on ACPI 1.0
+static bool root_is_xsdt = false;
+
+static bool acpi_checksum_ok(const void *table, uint32_t length) {
+    const uint8_t *p = (const uint8_t *)table;
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) sum += p[i];
+    return sum == 0;
+}
+
+// Limine hands out the RSDP through the HHDM on older base revisions and as a
+// physical address on newer ones
+static const void *acpi_map(uint64_t addr) {
+    if (addr < p2v(0)) addr = p2v(addr);
+    return (const void *)(uintptr_t)addr;
+}
+
+void acpi_init(void) {
+    if (!rsdp_request.response || !rsdp_request.response->address) return;
+
+    const acpi_rsdp_t *r = (const acpi_rsdp_t *)acpi_map((uint64_t)(uintptr_t)rsdp_request.response->address);
+    if (!acpi_checksum_ok(r, 20)) return;
+    rsdp = r;
+
+    if (r->revision >= 2 && r->xsdt_address) {
+        root_table = (const acpi_sdt_header_t *)acpi_map(r->xsdt_address);
+        root_is_xsdt = true;
+    } else {
+        root_table = (const acpi_sdt_header_t *)acpi_map(r->rsdt_address);
+        root_is_xsdt = false;
+    }
+
+    if (!acpi_checksum_ok(root_table, root_table->length)) {
+        root_table = NULL;
+    }
+}
+
+bool acpi_available(void) {
+    return root_table != NULL;
+}
+
+const acpi_sdt_header_t *acpi_find_table(const char *signature) {
+    if (!root_table) return NULL;
+
+    int entry_size = root_is_xsdt ? 8 : 4;
+    int entries = (root_table->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    const uint8_t *list = (const uint8_t *)root_table + sizeof(acpi_sdt_header_t);
+
+    for (int i = 0; i < entries; i++) {
+        uint64_t phys;
+        if (root_is_xsdt) {
+            // Entries are only 4-byte aligned
+            const uint32_t *e = (const uint32_t *)(list + i * 8);
+            phys = (uint64_t)e[0] | ((uint64_t)e[1] << 32);
+        } else {
+            phys = ((const uint32_t *)list)[i];
+        }
+        if (!phys) continue;
+
+        const acpi_sdt_header_t *t = (const acpi_sdt_header_t *)acpi_map(phys);
+        if (t->signature[0] == signature[0] && t->signature[1] == signature[1] &&
+            t->signature[2] == signature[2] && t->signature[3] == signature[3]) {
+            if (!acpi_checksum_ok(t, t->length)) return NULL;
+            return t;
+        }
+    }
+    return NULL;
+}
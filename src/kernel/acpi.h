@@ -0,0 +1,104 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+    char signature[8];          // "RSD PTR "
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;           // 0 = ACPI 1.0 (RSDT only), 2+ = has XSDT
+    uint32_t rsdt_address;
+    // ACPI 2.0+
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+typedef struct {
+    char signature[4];
+    uint32_t length;            // Whole table, header included
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+// Generic Address Structure
+typedef struct {
+    uint8_t address_space;      // 0 = system memory, 1 = system I/O
+    uint8_t bit_width;
+    uint8_t bit_offset;
+    uint8_t access_size;
+    uint64_t address;
+} __attribute__((packed)) acpi_gas_t;
+
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t event_timer_block_id;
+    acpi_gas_t base_address;
+    uint8_t hpet_number;
+    uint16_t minimum_tick;
+    uint8_t page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+// Multiple APIC Description Table ("APIC")
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t local_apic_address;
+    uint32_t flags;             // Bit 0: legacy 8259 PICs are present
+} __attribute__((packed)) acpi_madt_t;
+
+// MADT entries follow the fixed part, each starting with type and length
+#define ACPI_MADT_LOCAL_APIC          0
+#define ACPI_MADT_IO_APIC             1
+#define ACPI_MADT_INTERRUPT_OVERRIDE  2
+#define ACPI_MADT_LOCAL_APIC_OVERRIDE 5
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) acpi_madt_entry_t;
+
+typedef struct {
+    acpi_madt_entry_t entry;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags;             // Bit 0: enabled, bit 1: online capable
+} __attribute__((packed)) acpi_madt_local_apic_t;
+
+typedef struct {
+    acpi_madt_entry_t entry;
+    uint8_t io_apic_id;
+    uint8_t reserved;
+    uint32_t address;
+    uint32_t gsi_base;
+} __attribute__((packed)) acpi_madt_io_apic_t;
+
+typedef struct {
+    acpi_madt_entry_t entry;
+    uint8_t bus;                // Always 0 (ISA)
+    uint8_t source;             // ISA IRQ
+    uint32_t gsi;
+    uint16_t flags;             // Polarity in bits 0-1, trigger mode in bits 2-3
+} __attribute__((packed)) acpi_madt_override_t;
+
+typedef struct {
+    acpi_madt_entry_t entry;
+    uint16_t reserved;
+    uint64_t address;
+} __attribute__((packed)) acpi_madt_lapic_override_t;
+
+void acpi_init(void);
+bool acpi_available(void);
+
+// Find a table by its 4-character signature (e.g. "APIC", "HPET").
+// Returns a pointer through the HHDM, or NULL if absent or corrupt.
+const acpi_sdt_header_t *acpi_find_table(const char *signature);
+
+#endif
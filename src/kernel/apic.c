@@ -0,0 +1,280 @@
+#include "apic.h"
+#include "acpi.h"
+#include "clock.h"
+#include "platform.h"
+#include "io.h"
+#include <stddef.h>
+
+// Local APIC registers (byte offsets)
+#define LAPIC_ID          0x020
+#define LAPIC_TPR         0x080
+#define LAPIC_EOI         0x0B0
+#define LAPIC_SVR         0x0F0
+#define LAPIC_ICR_LOW     0x300
+#define LAPIC_ICR_HIGH    0x310
+#define LAPIC_LVT_TIMER   0x320
+#define LAPIC_LVT_LINT0   0x350
+#define LAPIC_TIMER_INIT  0x380
+#define LAPIC_TIMER_CUR   0x390
+#define LAPIC_TIMER_DIV   0x3E0
+
+#define LAPIC_SVR_ENABLE      0x100
+#define LAPIC_LVT_MASKED      0x10000
+#define LAPIC_TIMER_PERIODIC  0x20000
+#define LAPIC_TIMER_DIV_16    0x3
+#define LAPIC_ICR_PENDING     0x1000
+#define LAPIC_ICR_ASSERT      0x4000
+
+#define IA32_APIC_BASE_MSR    0x1B
+#define IA32_APIC_BASE_ENABLE 0x800
+
+// I/O APIC registers (indices through IOREGSEL/IOWIN)
+#define IOAPIC_VER        0x01
+#define IOAPIC_REDIR      0x10
+
+#define IOAPIC_ACTIVE_LOW 0x2000
+#define IOAPIC_LEVEL      0x8000
+#define IOAPIC_MASKED     0x10000
+
+#define MAX_IOAPICS 4
+
+typedef struct {
+    volatile uint32_t *regs;
+    uint32_t gsi_base;
+    uint32_t gsi_count;
+} IoApic;
+
+// MADT interrupt source override for one ISA IRQ
+typedef struct {
+    bool present;
+    uint32_t gsi;
+    uint16_t flags;
+} IrqOverride;
+
+static volatile uint32_t *lapic = NULL;
+static IoApic ioapics[MAX_IOAPICS];
+static int ioapic_count = 0;
+static IrqOverride overrides[16];
+static bool enabled = false;
+
+static uint64_t timer_hz = 0;
+static uint64_t timer_ticks_per_ns_q32 = 0;  // Timer ticks per ns, 32.32 fixed point
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t val) {
+    lapic[reg / 4] = val;
+}
+
+static uint32_t ioapic_read(IoApic *io, uint8_t reg) {
+    io->regs[0] = reg;
+    return io->regs[4];
+}
+
+static void ioapic_write(IoApic *io, uint8_t reg, uint32_t val) {
+    io->regs[0] = reg;
+    io->regs[4] = val;
+}
+
+static bool cpu_has_apic(void) {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+    return (edx >> 9) & 1;
+}
+
+static void parse_madt(const acpi_madt_t *madt, uint64_t *lapic_phys) {
+    *lapic_phys = madt->local_apic_address;
+
+    const uint8_t *p = (const uint8_t *)madt + sizeof(acpi_madt_t);
+    const uint8_t *end = (const uint8_t *)madt + madt->header.length;
+    while (p + sizeof(acpi_madt_entry_t) <= end) {
+        const acpi_madt_entry_t *e = (const acpi_madt_entry_t *)p;
+        if (e->length < sizeof(acpi_madt_entry_t) || p + e->length > end) break;
+
+        if (e->type == ACPI_MADT_IO_APIC && ioapic_count < MAX_IOAPICS) {
+            const acpi_madt_io_apic_t *io = (const acpi_madt_io_apic_t *)e;
+            ioapics[ioapic_count].regs = (volatile uint32_t *)(uintptr_t)p2v(io->address);
+            ioapics[ioapic_count].gsi_base = io->gsi_base;
+            ioapic_count++;
+        } else if (e->type == ACPI_MADT_INTERRUPT_OVERRIDE) {
+            const acpi_madt_override_t *o = (const acpi_madt_override_t *)e;
+            if (o->bus == 0 && o->source < 16) {
+                overrides[o->source].present = true;
+                overrides[o->source].gsi = o->gsi;
+                overrides[o->source].flags = o->flags;
+            }
+        } else if (e->type == ACPI_MADT_LOCAL_APIC_OVERRIDE) {
+            *lapic_phys = ((const acpi_madt_lapic_override_t *)e)->address;
+        }
+        p += e->length;
+    }
+}
+
+// Count down from the maximum for 10ms of TSC time
+static void calibrate_timer(void) {
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+
+    uint64_t t0 = clock_cycles();
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    clock_delay_ns(10 * CLOCK_NS_PER_MS);
+    uint32_t remaining = lapic_read(LAPIC_TIMER_CUR);
+    uint64_t ns = clock_cycles_to_ns(clock_cycles() - t0);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+
+    uint64_t elapsed = 0xFFFFFFFFu - remaining;
+    if (ns == 0 || elapsed == 0) return;
+    timer_hz = elapsed * CLOCK_NS_PER_SEC / ns;
+    timer_ticks_per_ns_q32 = (timer_hz << 32) / CLOCK_NS_PER_SEC;
+}
+
+bool apic_init(void) {
+    const acpi_madt_t *madt = (const acpi_madt_t *)acpi_find_table("APIC");
+    if (!madt || !cpu_has_apic()) return false;
+
+    uint64_t lapic_phys;
+    parse_madt(madt, &lapic_phys);
+    if (!lapic_phys || ioapic_count == 0) return false;
+
+    uint64_t apic_base = rdmsr(IA32_APIC_BASE_MSR);
+    wrmsr(IA32_APIC_BASE_MSR, apic_base | IA32_APIC_BASE_ENABLE);
+    lapic = (volatile uint32_t *)(uintptr_t)p2v(lapic_phys);
+
+    // Calibrate before touching LINT0 or the I/O APICs: if it fails the
+    // caller falls back to the PIC, which still needs the virtual wire
+    calibrate_timer();
+    if (!timer_hz) {
+        wrmsr(IA32_APIC_BASE_MSR, apic_base);
+        lapic = NULL;
+        return false;
+    }
+
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    // The PIC's virtual-wire output comes in on LINT0; it's masked from now on
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+
+    // Start with every I/O APIC input masked
+    for (int i = 0; i < ioapic_count; i++) {
+        IoApic *io = &ioapics[i];
+        io->gsi_count = ((ioapic_read(io, IOAPIC_VER) >> 16) & 0xFF) + 1;
+        for (uint32_t pin = 0; pin < io->gsi_count; pin++) {
+            ioapic_write(io, IOAPIC_REDIR + pin * 2, IOAPIC_MASKED);
+            ioapic_write(io, IOAPIC_REDIR + pin * 2 + 1, 0);
+        }
+    }
+
+    enabled = true;
+    return true;
+}
+
+void apic_init_ap(void) {
+    if (!enabled) return;
+    wrmsr(IA32_APIC_BASE_MSR, rdmsr(IA32_APIC_BASE_MSR) | IA32_APIC_BASE_ENABLE);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+}
+
+bool apic_enabled(void) {
+    return enabled;
+}
+
+uint8_t apic_id(void) {
+    return lapic ? (uint8_t)(lapic_read(LAPIC_ID) >> 24) : 0;
+}
+
+void apic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+// Fixed delivery to one CPU by APIC ID
+void apic_send_ipi(uint8_t dest, uint8_t vector) {
+    if (!enabled) return;
+    uint64_t flags = irq_save();
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) asm volatile ("pause");
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)dest << 24);
+    lapic_write(LAPIC_ICR_LOW, LAPIC_ICR_ASSERT | vector);
+    irq_restore(flags);
+}
+
+// --- Local APIC timer ---
+
+void apic_timer_periodic(uint32_t hz, uint8_t vector) {
+    if (!enabled || hz == 0) return;
+    uint64_t count = timer_hz / hz;
+    if (count == 0) count = 1;
+    if (count > 0xFFFFFFFF) count = 0xFFFFFFFF;
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | vector);
+    lapic_write(LAPIC_TIMER_INIT, (uint32_t)count);
+}
+
+void apic_timer_oneshot_ns(uint64_t ns, uint8_t vector) {
+    if (!enabled) return;
+    uint64_t count = (uint64_t)(((unsigned __int128)ns * timer_ticks_per_ns_q32) >> 32);
+    if (count == 0) count = 1;
+    if (count > 0xFFFFFFFF) count = 0xFFFFFFFF;
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+    lapic_write(LAPIC_LVT_TIMER, vector);
+    lapic_write(LAPIC_TIMER_INIT, (uint32_t)count);
+}
+
+void apic_timer_stop(void) {
+    if (!enabled) return;
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INIT, 0);
+}
+
+uint64_t apic_timer_hz(void) {
+    return timer_hz;
+}
+
+// --- I/O APIC ---
+
+static IoApic *ioapic_for_gsi(uint32_t gsi) {
+    for (int i = 0; i < ioapic_count; i++) {
+        IoApic *io = &ioapics[i];
+        if (gsi >= io->gsi_base && gsi < io->gsi_base + io->gsi_count) return io;
+    }
+    return NULL;
+}
+
+void ioapic_route_irq(uint8_t irq, uint8_t vector, bool pci) {
+    if (!enabled) return;
+
+    uint32_t gsi = irq;
+    bool level = pci;
+    bool active_low = pci;
+    if (irq < 16 && overrides[irq].present) {
+        gsi = overrides[irq].gsi;
+        uint16_t polarity = overrides[irq].flags & 0x3;
+        uint16_t trigger = (overrides[irq].flags >> 2) & 0x3;
+        if (polarity == 1) active_low = false;
+        else if (polarity == 3) active_low = true;
+        if (trigger == 1) level = false;
+        else if (trigger == 3) level = true;
+    }
+
+    IoApic *io = ioapic_for_gsi(gsi);
+    if (!io) return;
+
+    uint32_t pin = gsi - io->gsi_base;
+    uint32_t low = vector;                  // Fixed delivery, physical destination
+    if (active_low) low |= IOAPIC_ACTIVE_LOW;
+    if (level) low |= IOAPIC_LEVEL;
+    ioapic_write(io, IOAPIC_REDIR + pin * 2 + 1, (uint32_t)apic_id() << 24);
+    ioapic_write(io, IOAPIC_REDIR + pin * 2, low);
+}
+
+void ioapic_mask_irq(uint8_t irq) {
+    if (!enabled) return;
+    uint32_t gsi = (irq < 16 && overrides[irq].present) ? overrides[irq].gsi : irq;
+    IoApic *io = ioapic_for_gsi(gsi);
+    if (!io) return;
+    uint32_t pin = gsi - io->gsi_base;
+    ioapic_write(io, IOAPIC_REDIR + pin * 2, ioapic_read(io, IOAPIC_REDIR + pin * 2) | IOAPIC_MASKED);
+}
@@ -0,0 +1,31 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Local APIC and I/O APIC, configured from the ACPI MADT. When apic_init()
+// fails, idt.c keeps using the 8259 PIC and the PIT.
+
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+bool apic_init(void);
+void apic_init_ap(void);                // Enable the calling AP's local APIC
+bool apic_enabled(void);
+uint8_t apic_id(void);
+void apic_eoi(void);
+void apic_send_ipi(uint8_t dest, uint8_t vector);
+
+// Local APIC timer (bus clock / 16, calibrated against the TSC)
+void apic_timer_periodic(uint32_t hz, uint8_t vector);
+void apic_timer_oneshot_ns(uint64_t ns, uint8_t vector);
+void apic_timer_stop(void);
+uint64_t apic_timer_hz(void);
+
+// Route a legacy IRQ number through the I/O APIC. ISA IRQs default to
+// edge-triggered active-high and PCI interrupt lines to level-triggered
+// active-low; MADT interrupt source overrides win over both.
+void ioapic_route_irq(uint8_t irq, uint8_t vector, bool pci);
+void ioapic_mask_irq(uint8_t irq);
+
+#endif
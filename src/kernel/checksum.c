@@ -0,0 +1,123 @@
+#include "checksum.h"
+
+// Unaligned, aliasing-safe loads; x86 takes them at full speed
+typedef uint64_t __attribute__((may_alias, aligned(1))) u64_loose;
+typedef uint32_t __attribute__((may_alias, aligned(1))) u32_loose;
+typedef uint16_t __attribute__((may_alias, aligned(1))) u16_loose;
+
+// 64-bit one's complement addition: the carry out wraps around into bit 0
+static inline uint64_t add64(uint64_t a, uint64_t b) {
+    a += b;
+    return a + (a < b);
+}
+
+// The 16-bit one's complement sum of a buffer equals that of its 64-bit
+// words folded down, as long as every word starts at an even offset, so the
+// bulk is summed 8 bytes at a time and only the tail in smaller pieces
+static uint32_t fold64(uint64_t acc) {
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    return (uint32_t)acc;
+}
+
+static uint64_t sum_tail(const uint8_t* p, size_t len, uint64_t acc) {
+    while (len >= 8) {
+        acc = add64(acc, *(const u64_loose*)p);
+        p += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        acc = add64(acc, *(const u32_loose*)p);
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        acc = add64(acc, *(const u16_loose*)p);
+        p += 2;
+        len -= 2;
+    }
+    if (len) acc = add64(acc, *p);
+    return acc;
+}
+
+uint32_t csum_partial(const void* data, size_t len, uint32_t sum) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t acc = sum;
+    // 64 bytes per iteration on one add-with-carry chain
+    while (len >= 64) {
+        asm ("addq 0(%[p]), %[acc]\n\t"
+             "adcq 8(%[p]), %[acc]\n\t"
+             "adcq 16(%[p]), %[acc]\n\t"
+             "adcq 24(%[p]), %[acc]\n\t"
+             "adcq 32(%[p]), %[acc]\n\t"
+             "adcq 40(%[p]), %[acc]\n\t"
+             "adcq 48(%[p]), %[acc]\n\t"
+             "adcq 56(%[p]), %[acc]\n\t"
+             "adcq $0, %[acc]"
+             : [acc] "+r"(acc)
+             : [p] "r"(p), "m"(*(const uint8_t(*)[64])p)
+             : "cc");
+        p += 64;
+        len -= 64;
+    }
+    return fold64(sum_tail(p, len, acc));
+}
+
+uint32_t csum_partial_copy(void* dest, const void* src, size_t len, uint32_t sum) {
+    uint8_t* d = (uint8_t*)dest;
+    const uint8_t* s = (const uint8_t*)src;
+    uint64_t acc = sum;
+    while (len >= 32) {
+        uint64_t a = ((const u64_loose*)s)[0];
+        uint64_t b = ((const u64_loose*)s)[1];
+        uint64_t c = ((const u64_loose*)s)[2];
+        uint64_t e = ((const u64_loose*)s)[3];
+        ((u64_loose*)d)[0] = a;
+        ((u64_loose*)d)[1] = b;
+        ((u64_loose*)d)[2] = c;
+        ((u64_loose*)d)[3] = e;
+        acc = add64(add64(acc, a), b);
+        acc = add64(add64(acc, c), e);
+        s += 32;
+        d += 32;
+        len -= 32;
+    }
+    for (size_t i = 0; i < len; i++) d[i] = s[i];
+    return fold64(sum_tail(s, len, acc));
+}
+
+uint16_t csum_reduce(uint32_t sum) {
+    while (sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+uint32_t csum_add(uint32_t a, uint32_t b) {
+    a += b;
+    return a + (a < b);
+}
+
+uint32_t csum_pseudo(const uint8_t src_ip[4], const uint8_t dest_ip[4], uint8_t protocol, uint16_t len) {
+    uint8_t ph[12];
+    for (int i = 0; i < 4; i++) {
+        ph[i] = src_ip[i];
+        ph[4 + i] = dest_ip[i];
+    }
+    ph[8] = 0;
+    ph[9] = protocol;
+    ph[10] = (uint8_t)(len >> 8);
+    ph[11] = (uint8_t)len;
+    return csum_partial(ph, sizeof(ph), 0);
+}
+
+// RFC 1624, eqn. 3: HC' = ~(~HC + ~m + m')
+void csum_replace2(uint16_t* check, uint16_t old_value, uint16_t new_value) {
+    uint32_t sum = (uint32_t)(uint16_t)~*check + (uint16_t)~old_value + new_value;
+    *check = csum_fold(sum);
+}
+
+void csum_replace4(uint16_t* check, uint32_t old_value, uint32_t new_value) {
+    uint32_t sum = (uint32_t)(uint16_t)~*check;
+    sum += (uint16_t)~old_value + (uint16_t)~(old_value >> 16);
+    sum += (new_value & 0xFFFF) + (new_value >> 16);
+    *check = csum_fold(sum);
+}
@@ -0,0 +1,33 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Internet checksum (RFC 1071). Partial sums are kept in 32 bits and folded
+// at the end; the result is stored in the header as it comes out, since the
+// one's complement sum is the same in either byte order. Data is summed 64
+// bits at a time with end-around carry.
+
+// Add len bytes to sum. Only the last block of a packet may have an odd
+// length.
+uint32_t csum_partial(const void* data, size_t len, uint32_t sum);
+// Copy len bytes and sum them in the same pass
+uint32_t csum_partial_copy(void* dest, const void* src, size_t len, uint32_t sum);
+// Fold a partial sum to 16 bits, without complementing it
+uint16_t csum_reduce(uint32_t sum);
+// The value that goes into a checksum field
+static inline uint16_t csum_fold(uint32_t sum) { return (uint16_t)~csum_reduce(sum); }
+// Combine two partial sums; b must cover data starting at an even offset
+uint32_t csum_add(uint32_t a, uint32_t b);
+
+// Sum of the TCP/UDP pseudo-header for an IPv4 packet; len is the length of
+// the TCP/UDP header plus payload
+uint32_t csum_pseudo(const uint8_t src_ip[4], const uint8_t dest_ip[4], uint8_t protocol, uint16_t len);
+
+// Incremental update (RFC 1624) after a 16- or 32-bit field of the covered
+// data changes. Values are taken as they sit in the packet.
+void csum_replace2(uint16_t* check, uint16_t old_value, uint16_t new_value);
+void csum_replace4(uint16_t* check, uint32_t old_value, uint32_t new_value);
+
+#endif
@@ -10,6 +10,8 @@ void cli_cmd_cowsay(char *args);
 void cli_cmd_reboot(char *args);
 void cli_cmd_shutdown(char *args);
 void cli_cmd_uptime(char *args);
+void cli_cmd_cpus(char *args);
+void cli_cmd_threads(char *args);
 void cli_cmd_man(char *args);
 void cli_cmd_license(char *args);
 void cli_cmd_txtedit(char *args);
@@ -43,10 +45,20 @@ void cli_cmd_memtest(char *args);
 void cli_cmd_netinit(char *args);
 void cli_cmd_netinfo(char *args);
 void cli_cmd_ipset(char *args);
+void cli_cmd_netitr(char *args);
+void cli_cmd_netcsum(char *args);
 void cli_cmd_udpsend(char *args);
 void cli_cmd_udptest(char *args);
 void cli_cmd_msgrc(char *args);
 
+// Performance
+void cli_cmd_perfhud(char *args);
+void cli_cmd_wmbench(char *args);
+void cli_cmd_csumbench(char *args);
+void cli_cmd_perf(char *args);
+void cli_cmd_trace(char *args);
+void cli_cmd_irqstat(char *args);
+
 // PCI commands
 void cli_cmd_pcilist(char *args);
 
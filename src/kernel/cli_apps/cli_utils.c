@@ -1,5 +1,7 @@
 #include "cli_utils.h"
 #include "wm.h"
+#include "clock.h"
+#include "thread.h"
 
 // Forward declarations - these will be provided by cmd.c
 extern void cmd_putchar(char c);
@@ -81,12 +83,6 @@ void cli_delay(int iterations) {
 }
 
 void cli_sleep(int ms) {
-    // Timer is ~60Hz, so 1 tick = 16.66ms
-    uint32_t ticks = ms / 16;
-    if (ticks == 0 && ms > 0) ticks = 1;
-    
-    uint32_t target = wm_get_ticks() + ticks;
-    while (wm_get_ticks() < target) {
-        __asm__ __volatile__("hlt");
-    }
+    if (ms <= 0) return;
+    thread_sleep((uint64_t)ms * CLOCK_NS_PER_MS);
 }
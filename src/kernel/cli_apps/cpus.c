@@ -0,0 +1,38 @@
+#include "cli_utils.h"
+#include "../smp.h"
+#include "../clock.h"
+
+static void report_cpu(void *arg) {
+    *(volatile int *)arg = this_cpu()->id;
+}
+
+// List the CPUs and run a trivial call on each one
+void cli_cmd_cpus(char *args) {
+    (void)args;
+    int n = smp_cpu_count();
+    cli_write("CPUs online: ");
+    cli_write_int(n);
+    cli_write("\n");
+
+    for (int i = 0; i < n; i++) {
+        PerCpu *cpu = smp_cpu(i);
+        volatile int ran_on = -1;
+        uint64_t t0 = clock_cycles();
+        bool ok = smp_call(i, report_cpu, (void *)&ran_on, true);
+        uint64_t ns = clock_cycles_to_ns(clock_cycles() - t0);
+
+        cli_write("  CPU ");
+        cli_write_int(i);
+        cli_write("  APIC ID ");
+        cli_write_int((int)cpu->lapic_id);
+        if (i == 0) cli_write(" (BSP)");
+        if (ok && ran_on == i) {
+            cli_write("  call ");
+            cli_write_int((int)ns);
+            cli_write("ns");
+        } else {
+            cli_write("  not responding");
+        }
+        cli_write("\n");
+    }
+}
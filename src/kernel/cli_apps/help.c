@@ -11,9 +11,18 @@ void cli_cmd_help(char *args) {
     cli_write("  MAN      - Show user manual (interactive)\n");
     cli_write("  LICENSE  - Show license (interactive)\n");
     cli_write("  UPTIME   - System uptime\n");
+    cli_write("  CPUS     - List processors\n");
+    cli_write("  THREADS  - List kernel threads (also PS)\n");
     cli_write("  BEEP     - Make a sound\n");
     cli_write("  COWSAY   - cowsay <msg>\n");
     cli_write("  REBOOT   - Reboot system\n");
     cli_write("  SHUTDOWN - Shutdown system\n");
     cli_write("  MEMINFO  - Gives memory info\n");
+    cli_write("  PERFHUD  - Frame timing overlay (also FPS)\n");
+    cli_write("  WMBENCH  - Scripted window manager benchmark\n");
+    cli_write("  CSUMBENCH - Internet checksum throughput, old vs new\n");
+    cli_write("  TCPBENCH - TCP bulk send throughput per congestion control\n");
+    cli_write("  PERF     - Sampling profiler (perf record/report/top)\n");
+    cli_write("  TRACE    - Event tracing, dumped as Chrome trace JSON\n");
+    cli_write("  IRQSTAT  - Interrupt counts, handler times and latency\n");
 }
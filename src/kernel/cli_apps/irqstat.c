@@ -0,0 +1,120 @@
+#include "cli_utils.h"
+#include "../irqstat.h"
+#include "../idt.h"
+#include "../smp.h"
+#include "../clock.h"
+#include "../ksyms.h"
+
+static void pad(int len, int width) {
+    while (len++ < width) cli_putchar(' ');
+}
+
+static int digits(uint64_t n) {
+    int d = 1;
+    while (n >= 10) {
+        n /= 10;
+        d++;
+    }
+    return d;
+}
+
+static void write_u64(uint64_t n, int width) {
+    char buf[21];
+    int len = 0;
+    do {
+        buf[len++] = (char)('0' + n % 10);
+        n /= 10;
+    } while (n);
+    pad(len, width);
+    while (len) cli_putchar(buf[--len]);
+}
+
+// Nanoseconds as microseconds with one decimal, right-aligned
+static void write_us(uint64_t ns, int width) {
+    uint64_t tenths = ns / 100;
+    pad(digits(tenths / 10) + 2, width);
+    write_u64(tenths / 10, 0);
+    cli_putchar('.');
+    cli_putchar((char)('0' + tenths % 10));
+}
+
+static void print_vectors(void) {
+    cli_write("Vector  Name              Count   Avg us   Max us\n");
+    for (int v = 0; v < 256; v++) {
+        IrqVectorStat s;
+        irqstat_vector((uint8_t)v, &s);
+        if (s.count == 0) continue;
+        const char *name = irq_vector_name((uint8_t)v);
+        write_u64((uint64_t)v, 6);
+        cli_write("  ");
+        cli_write(name);
+        pad((int)cli_strlen(name), 12);
+        write_u64(s.count, 11);
+        write_us(clock_cycles_to_ns(s.total_cycles / s.count), 9);
+        write_us(clock_cycles_to_ns(s.max_cycles), 9);
+        cli_write("\n");
+    }
+}
+
+static void print_irqoff(void) {
+    cli_write("Interrupts disabled:\n");
+    for (int cpu = 0; cpu < smp_cpu_count(); cpu++) {
+        IrqOffStat s;
+        irqstat_irqoff(cpu, &s);
+        cli_write("  CPU ");
+        cli_write_int(cpu);
+        cli_write(": ");
+        write_u64(s.sections, 0);
+        cli_write(" sections, ");
+        write_us(clock_cycles_to_ns(s.total_cycles), 0);
+        cli_write(" us total, longest ");
+        write_us(clock_cycles_to_ns(s.max_cycles), 0);
+        cli_write(" us in ");
+        if (s.max_cycles == 0) {
+            cli_write("-");
+        } else if (s.max_site == 0) {
+            cli_write(irq_vector_name(s.max_vector));
+            cli_write(" handler");
+        } else {
+            int sym = ksyms_find(s.max_site);
+            cli_write(sym >= 0 ? ksyms_name(sym) : "[unknown]");
+        }
+        cli_write("\n");
+    }
+}
+
+static void print_latency(void) {
+    IrqLatencyStat s;
+    irqstat_latency(&s);
+    cli_write("Timer interrupt latency: ");
+    if (s.samples == 0) {
+        cli_write("not measured (needs the local APIC timer)\n");
+        return;
+    }
+    write_u64(s.samples, 0);
+    cli_write(" samples, avg ");
+    write_us(s.total_ns / s.samples, 0);
+    cli_write(" us, max ");
+    write_us(s.max_ns, 0);
+    cli_write(" us\n");
+}
+
+// irqstat          - per-vector counts and handler times, interrupts-off
+//                    sections and timer latency since boot or the last reset
+// irqstat reset    - zero the counters
+void cli_cmd_irqstat(char *args) {
+    while (args && *args == ' ') args++;
+    if (args && *args) {
+        if (cli_strcmp(args, "reset") == 0) {
+            irqstat_reset();
+            cli_write("Interrupt statistics reset\n");
+        } else {
+            cli_write("Usage: irqstat [reset]\n");
+        }
+        return;
+    }
+
+    print_vectors();
+    print_irqoff();
+    print_latency();
+}
@@ -3,6 +3,8 @@
 #include "fat32.h"
 #include "cmd.h"
 #include "memory_manager.h"
+#include "workqueue.h"
+#include "io.h"
 
 static void print_mac(const mac_address_t* mac){
     char buf[64];
@@ -18,9 +20,19 @@ static void print_mac(const mac_address_t* mac){
     cli_write(buf);
 }
 
+// NETINIT [rx ring] [tx ring]
 void cli_cmd_netinit(char *args){
-    (void)args;
-    int r=network_init();
+    int sizes[2]={0,0};
+    for(int n=0;n<2 && args && *args;n++){
+        while(*args==' ') args++;
+        sizes[n]=cli_atoi(args);
+        while(*args && *args!=' ') args++;
+    }
+    if(sizes[0]<0||sizes[0]>E1000_RING_MAX||sizes[1]<0||sizes[1]>E1000_RING_MAX){
+        cli_write("Usage: NETINIT [rx ring] [tx ring] (up to 4096 descriptors each)\n");
+        return;
+    }
+    int r=network_init_with_rings((uint16_t)sizes[0],(uint16_t)sizes[1]);
     if(r==0){
         cli_write("Network initialized\n");
         int d=network_dhcp_acquire();
@@ -52,6 +64,57 @@ void cli_cmd_netinfo(char *args){
     cli_write("E1000 receive calls: "); cli_write_int(network_get_e1000_receive_calls()); cli_write("\n");
     cli_write("E1000 receive empty: "); cli_write_int(network_get_e1000_receive_empty()); cli_write("\n");
     cli_write("Process calls: "); cli_write_int(network_get_process_calls()); cli_write("\n");
+    e1000_device_t* dev=e1000_get_device();
+    if(dev){
+        e1000_update_stats();
+        cli_write("Rings: RX "); cli_write_int(dev->rx_ring_size);
+        cli_write(" TX "); cli_write_int(dev->tx_ring_size); cli_write(" descriptors\n");
+        cli_write("RX drops: missed "); cli_write_int((int)dev->rx_missed);
+        cli_write(" no buffer "); cli_write_int((int)dev->rx_no_buffer);
+        cli_write(" overruns "); cli_write_int((int)dev->rx_overruns);
+        cli_write(" pool empty "); cli_write_int((int)dev->rx_pool_empty); cli_write("\n");
+        cli_write("RX: "); cli_write(network_rx_irq()?"interrupts on IRQ ":"polled");
+        if(network_rx_irq()) cli_write_int(dev->irq_line);
+        cli_write(", "); cli_write_int((int)dev->irq_count); cli_write(" interrupts, ITR ");
+        if(dev->itr_rate){ cli_write_int((int)dev->itr_rate); cli_write("/s\n"); } else cli_write("off\n");
+        cli_write("TX sent: "); cli_write_int((int)dev->tx_sent);
+        cli_write(" queued: "); cli_write_int((int)dev->tx_queued);
+        cli_write(" dropped: "); cli_write_int((int)dev->tx_dropped);
+        cli_write(" doorbells: "); cli_write_int((int)dev->tx_doorbells); cli_write("\n");
+        cli_write("Checksums: offload "); cli_write(dev->csum_offload?"on":"off");
+        cli_write(", "); cli_write_int((int)dev->tx_offloaded); cli_write(" sent offloaded, ");
+        cli_write_int((int)dev->tx_contexts); cli_write(" contexts, ");
+        cli_write_int(network_get_csum_errors()); cli_write(" bad received\n");
+        netbuf_stats_t nbs; netbuf_get_stats(&nbs);
+        cli_write("Netbufs: "); cli_write_int((int)nbs.free); cli_write("/"); cli_write_int((int)nbs.total);
+        cli_write(" free, low "); cli_write_int((int)nbs.low_water);
+        cli_write(", alloc failures "); cli_write_int((int)nbs.alloc_failures); cli_write("\n");
+    }
+}
+
+void cli_cmd_netitr(char *args){
+    e1000_device_t* dev=e1000_get_device();
+    if(!dev){ cli_write("Network not initialized\n"); return; }
+    if(args&&*args){
+        int rate=cli_atoi(args);
+        if(rate<0){ cli_write("Usage: NETITR [interrupts per second, 0 = unthrottled]\n"); return; }
+        e1000_set_itr((uint32_t)rate);
+    }
+    cli_write("ITR: ");
+    if(dev->itr_rate){ cli_write_int((int)dev->itr_rate); cli_write(" interrupts/s max\n"); } else cli_write("unthrottled\n");
+}
+
+// NETCSUM [on|off] - IPv4/TCP/UDP checksums in the NIC or in software
+void cli_cmd_netcsum(char *args){
+    e1000_device_t* dev=e1000_get_device();
+    if(!dev){ cli_write("Network not initialized\n"); return; }
+    while(args&&*args==' ') args++;
+    if(args&&*args){
+        if(cli_strcmp(args,"on")==0) e1000_set_csum_offload(1);
+        else if(cli_strcmp(args,"off")==0) e1000_set_csum_offload(0);
+        else { cli_write("Usage: NETCSUM [on|off]\n"); return; }
+    }
+    cli_write("Checksum offload: "); cli_write(dev->csum_offload?"on\n":"off (software)\n");
 }
 
 void cli_cmd_ipset(char *args){
@@ -98,17 +161,41 @@ void cli_cmd_udpsend(char *args){
     if(r==0) cli_write("Sent\n"); else cli_write("Send failed\n");
 }
 
-static void udp_print_callback(const ipv4_address_t* src_ip,uint16_t src_port,const mac_address_t* src_mac,const void* data,size_t length){
-    (void)src_mac;
-    
-    FAT32_FileHandle *fh = fat32_open("messages", "a");
-    if (fh) {
+// Datagrams arrive in the network softirq, which must not take the
+// filesystem lock, so they are queued here and appended to "messages" from
+// the work queue
+#define UDP_LOG_SLOTS 8
+#define UDP_LOG_MAX 256
+
+typedef struct {
+    ipv4_address_t src_ip;
+    uint16_t src_port;
+    uint16_t length;
+    char data[UDP_LOG_MAX];
+} udp_log_entry_t;
+
+static udp_log_entry_t udp_log[UDP_LOG_SLOTS];
+static int udp_log_head=0, udp_log_count=0;
+
+static void udp_log_work(void *arg){
+    (void)arg;
+    for(;;){
+        udp_log_entry_t e;
+        uint64_t flags=irq_save();
+        if(!udp_log_count){ irq_restore(flags); break; }
+        e=udp_log[udp_log_head];
+        udp_log_head=(udp_log_head+1)%UDP_LOG_SLOTS;
+        udp_log_count--;
+        irq_restore(flags);
+        
+        FAT32_FileHandle *fh = fat32_open("messages", "a");
+        if (!fh) continue;
         char buf[32];
         fat32_write(fh, "UDP from ", 9);
         
         // Write IP
         for(int i=0;i<4;i++){ 
-            cli_itoa(src_ip->bytes[i], buf);
+            cli_itoa(e.src_ip.bytes[i], buf);
             fat32_write(fh, buf, cli_strlen(buf));
             if(i<3) fat32_write(fh, ".", 1);
         }
@@ -116,13 +203,13 @@ static void udp_print_callback(const ipv4_address_t* src_ip,uint16_t src_port,co
         fat32_write(fh, ":", 1);
         
         // Write Port
-        cli_itoa(src_port, buf);
+        cli_itoa(e.src_port, buf);
         fat32_write(fh, buf, cli_strlen(buf));
         
         fat32_write(fh, " ", 1);
         
         // Write Message
-        fat32_write(fh, data, length);
+        fat32_write(fh, e.data, e.length);
         fat32_write(fh, "\n", 1);
         
         fat32_close(fh);
@@ -131,6 +218,24 @@ static void udp_print_callback(const ipv4_address_t* src_ip,uint16_t src_port,co
     }
 }
 
+static WorkItem udp_log_item = WORK_INIT(udp_log_work, NULL);
+
+static void udp_print_callback(const ipv4_address_t* src_ip,uint16_t src_port,const mac_address_t* src_mac,const void* data,size_t length){
+    (void)src_mac;
+    uint64_t flags=irq_save();
+    if(udp_log_count<UDP_LOG_SLOTS){
+        udp_log_entry_t* e=&udp_log[(udp_log_head+udp_log_count)%UDP_LOG_SLOTS];
+        e->src_ip=*src_ip;
+        e->src_port=src_port;
+        e->length=(uint16_t)(length<UDP_LOG_MAX?length:UDP_LOG_MAX);
+        const uint8_t* d=(const uint8_t*)data;
+        for(int i=0;i<e->length;i++) e->data[i]=(char)d[i];
+        udp_log_count++;
+    }
+    irq_restore(flags);
+    work_queue(&udp_log_item);
+}
+
 void cli_cmd_udptest(char *args){
     if(!args||!*args){ cli_write("Usage: UDPTEST port\n"); return; }
     int port=cli_atoi(args);
@@ -0,0 +1,184 @@
+#include "cli_utils.h"
+#include "../profiler.h"
+#include "../ksyms.h"
+
+#define DEFAULT_SECONDS 5
+#define REPORT_LINES 15
+#define TOP_LINES 10
+
+static ProfHotspot report[REPORT_LINES];
+
+static void write_hex(uint64_t n) {
+    char buf[19];
+    buf[0] = '0';
+    buf[1] = 'x';
+    for (int i = 0; i < 16; i++) {
+        int d = (int)((n >> (60 - 4 * i)) & 0xF);
+        buf[2 + i] = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+    }
+    buf[18] = 0;
+    cli_write(buf);
+}
+
+// Right-aligned percentage with one decimal, e.g. " 12.3%"
+static void write_percent(uint32_t part, uint32_t whole) {
+    int tenths = whole ? (int)((uint64_t)part * 1000 / whole) : 0;
+    if (tenths < 1000) cli_write(" ");
+    if (tenths < 100) cli_write(" ");
+    cli_write_int(tenths / 10);
+    cli_write(".");
+    cli_write_int(tenths % 10);
+    cli_write("%");
+}
+
+static void print_report(int lines, bool by_total) {
+    uint32_t samples = profiler_sample_count();
+    if (samples == 0) {
+        cli_write("No samples recorded\n");
+        return;
+    }
+
+    int n = profiler_report(report, lines, by_total);
+    cli_write("Samples: ");
+    cli_write_int((int)samples);
+    if (profiler_overwritten()) {
+        cli_write(" (");
+        cli_write_int((int)profiler_overwritten());
+        cli_write(" older ones overwritten)");
+    }
+    cli_write("\n    Self   Total  Function\n");
+    for (int i = 0; i < n; i++) {
+        cli_write("  ");
+        write_percent(report[i].self, samples);
+        cli_write("  ");
+        write_percent(report[i].total, samples);
+        cli_write("  ");
+        if (report[i].symbol >= 0) {
+            cli_write(ksyms_name(report[i].symbol));
+        } else {
+            cli_write("[unknown]");
+        }
+        cli_write("\n");
+    }
+    if (ksyms_count() == 0) {
+        cli_write("(This kernel was linked without a symbol table)\n");
+    }
+}
+
+static const char *next_word(const char *s, char *word, int max) {
+    while (*s == ' ') s++;
+    int n = 0;
+    while (*s && *s != ' ') {
+        if (n < max - 1) word[n++] = *s;
+        s++;
+    }
+    word[n] = 0;
+    return s;
+}
+
+static bool start(uint32_t hz, bool callchains) {
+    if (callchains && !profiler_has_frame_pointers()) {
+        cli_write("Note: call chains need a kernel built with PROFILE=1; recording without\n");
+        callchains = false;
+    }
+    if (!profiler_start(hz, callchains)) {
+        cli_write("Error: not enough memory for the sample buffers\n");
+        return false;
+    }
+    return true;
+}
+
+// perf record [seconds] [hz] [-g]  - sample for a while, then report
+// perf report [-g] [lines]         - report on the last recording
+//                                    (-g sorts by time including callees)
+// perf top [seconds]               - hottest functions, refreshed every second
+// perf lookup <hex address>        - which function an address is in
+void cli_cmd_perf(char *args) {
+    char word[24];
+    const char *p = next_word(args ? args : "", word, sizeof(word));
+
+    if (cli_strcmp(word, "record") == 0) {
+        int seconds = DEFAULT_SECONDS;
+        uint32_t hz = PROFILER_DEFAULT_HZ;
+        bool callchains = false;
+        int positional = 0;
+        for (;;) {
+            p = next_word(p, word, sizeof(word));
+            if (!word[0]) break;
+            if (cli_strcmp(word, "-g") == 0) {
+                callchains = true;
+            } else if (positional++ == 0) {
+                seconds = cli_atoi(word);
+            } else {
+                hz = (uint32_t)cli_atoi(word);
+            }
+        }
+        if (seconds <= 0) seconds = DEFAULT_SECONDS;
+
+        if (!start(hz, callchains)) return;
+        cli_write("Recording for ");
+        cli_write_int(seconds);
+        cli_write("s...\n");
+        cli_sleep(seconds * 1000);
+        profiler_stop();
+        print_report(REPORT_LINES, false);
+    } else if (cli_strcmp(word, "report") == 0) {
+        bool by_total = false;
+        int lines = REPORT_LINES;
+        for (;;) {
+            p = next_word(p, word, sizeof(word));
+            if (!word[0]) break;
+            if (cli_strcmp(word, "-g") == 0) {
+                by_total = true;
+            } else {
+                lines = cli_atoi(word);
+            }
+        }
+        if (lines <= 0 || lines > REPORT_LINES) lines = REPORT_LINES;
+        print_report(lines, by_total);
+    } else if (cli_strcmp(word, "top") == 0) {
+        next_word(p, word, sizeof(word));
+        int seconds = word[0] ? cli_atoi(word) : DEFAULT_SECONDS;
+        if (seconds <= 0) seconds = DEFAULT_SECONDS;
+
+        if (!start(PROFILER_DEFAULT_HZ, false)) return;
+        for (int i = 0; i < seconds; i++) {
+            cli_sleep(1000);
+            cli_write("--- ");
+            cli_write_int(i + 1);
+            cli_write("s ---\n");
+            print_report(TOP_LINES, false);
+            profiler_clear();
+        }
+        profiler_stop();
+    } else if (cli_strcmp(word, "lookup") == 0) {
+        next_word(p, word, sizeof(word));
+        uint64_t addr = 0;
+        const char *h = word;
+        if (h[0] == '0' && (h[1] == 'x' || h[1] == 'X')) h += 2;
+        for (; *h; h++) {
+            char c = *h;
+            int d = c >= '0' && c <= '9' ? c - '0' :
+                    c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                    c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+            if (d < 0) break;
+            addr = (addr << 4) | (uint64_t)d;
+        }
+        int sym = ksyms_find(addr);
+        write_hex(addr);
+        if (sym < 0) {
+            cli_write(" is not in the symbol table\n");
+        } else {
+            cli_write(" = ");
+            cli_write(ksyms_name(sym));
+            cli_write("+");
+            cli_write_int((int)(addr - ksyms_addr(sym)));
+            cli_write("\n");
+        }
+    } else {
+        cli_write("Usage: perf record [seconds] [hz] [-g]\n");
+        cli_write("       perf report [-g] [lines]\n");
+        cli_write("       perf top [seconds]\n");
+        cli_write("       perf lookup <address>\n");
+    }
+}
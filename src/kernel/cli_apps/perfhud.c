@@ -0,0 +1,79 @@
+#include "cli_utils.h"
+#include "../perf.h"
+#include "../clock.h"
+#include "../wm.h"
+
+static int starts_with(const char *s, const char *prefix) {
+    while (*prefix) {
+        if (*s++ != *prefix++) return 0;
+    }
+    return 1;
+}
+
+static void write_time(uint64_t cycles) {
+    cli_write_int((int)clock_cycles_to_us(cycles));
+    cli_write("us");
+}
+
+static void print_summary(void) {
+    PerfSummary s;
+    perf_get_summary(&s);
+
+    cli_write("Frames: "); cli_write_int((int)s.frames);
+    cli_write("  FPS: "); cli_write_int((int)s.fps);
+    cli_write("\nFrame time p50: "); write_time(s.p50_cycles);
+    cli_write("  p99: "); write_time(s.p99_cycles);
+    cli_write("  max: "); write_time(s.max_cycles);
+    cli_write("\nAvg background: "); write_time(s.avg_stage_cycles[PERF_STAGE_BACKGROUND]);
+    cli_write("  windows: "); write_time(s.avg_stage_cycles[PERF_STAGE_WINDOWS]);
+    cli_write("  flip: "); write_time(s.avg_stage_cycles[PERF_STAGE_FLIP]);
+    cli_write("\nAvg pixels written: "); cli_write_int((int)s.avg_pixels_written);
+    cli_write("  bytes flipped: "); cli_write_int((int)s.avg_bytes_flipped);
+    cli_write("\n");
+}
+
+// perfhud            - toggle the overlay and print a summary
+// perfhud on|off     - show / hide the overlay
+// perfhud stats      - print a summary only
+// perfhud reset      - clear the frame history
+// perfhud dump FILE  - write the frame history as CSV
+void cli_cmd_perfhud(char *args) {
+    while (args && *args == ' ') args++;
+
+    if (!args || !*args) {
+        perf_hud_set_visible(!perf_hud_visible());
+        cli_write(perf_hud_visible() ? "Performance HUD on\n" : "Performance HUD off\n");
+        print_summary();
+    } else if (cli_strcmp(args, "on") == 0) {
+        perf_hud_set_visible(true);
+    } else if (cli_strcmp(args, "off") == 0) {
+        perf_hud_set_visible(false);
+    } else if (cli_strcmp(args, "stats") == 0) {
+        print_summary();
+        return;
+    } else if (cli_strcmp(args, "reset") == 0) {
+        perf_reset();
+        cli_write("Frame history cleared\n");
+        return;
+    } else if (starts_with(args, "dump")) {
+        const char *path = args + 4;
+        while (*path == ' ') path++;
+        if (!*path) path = "perf.csv";
+        if (perf_dump_csv(path)) {
+            cli_write("Wrote ");
+            cli_write(path);
+            cli_write("\n");
+        } else {
+            cli_write("Error: could not write ");
+            cli_write(path);
+            cli_write("\n");
+        }
+        return;
+    } else {
+        cli_write("Usage: perfhud [on|off|stats|reset|dump <file>]\n");
+        return;
+    }
+
+    // The overlay appears or disappears on the next frame
+    wm_refresh();
+}
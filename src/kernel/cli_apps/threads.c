@@ -0,0 +1,34 @@
+#include "cli_utils.h"
+#include "../thread.h"
+#include "../clock.h"
+
+#define MAX_LISTED 32
+
+static void write_padded(const char *s, int width) {
+    cli_write(s);
+    for (int i = cli_strlen(s); i < width; i++) cli_write(" ");
+}
+
+static void write_int_padded(int n, int width) {
+    char buf[16];
+    cli_itoa(n, buf);
+    write_padded(buf, width);
+}
+
+void cli_cmd_threads(char *args) {
+    (void)args;
+    static Thread list[MAX_LISTED];
+    int n = thread_snapshot(list, MAX_LISTED);
+
+    cli_write("ID  NAME                    STATE    PRI CPU(ms)  SWITCHES\n");
+    for (int i = n - 1; i >= 0; i--) {
+        Thread *t = &list[i];
+        write_int_padded(t->id, 4);
+        write_padded(t->name, 24);
+        write_padded(thread_state_name(t->state), 9);
+        write_int_padded(t->priority, 4);
+        write_int_padded((int)(clock_cycles_to_us(t->runtime_cycles) / 1000), 9);
+        cli_write_int((int)t->switches);
+        cli_write("\n");
+    }
+}
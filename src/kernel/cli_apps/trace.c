@@ -0,0 +1,111 @@
+#include "cli_utils.h"
+#include "../trace.h"
+
+#define DEFAULT_FILE "trace.json"
+
+static const char *next_word(const char *s, char *word, int max) {
+    while (*s == ' ') s++;
+    int n = 0;
+    while (*s && *s != ' ') {
+        if (n < max - 1) word[n++] = *s;
+        s++;
+    }
+    word[n] = 0;
+    return s;
+}
+
+static void print_categories(uint32_t mask) {
+    bool any = false;
+    for (int i = 0; i < TRACE_CAT_COUNT; i++) {
+        if (!(mask & (1u << i))) continue;
+        cli_write(" ");
+        cli_write(trace_category_name(i));
+        any = true;
+    }
+    if (!any) cli_write(" (none)");
+    cli_write("\n");
+}
+
+static void print_status(void) {
+    cli_write("Tracing: ");
+    cli_write(trace_mask ? "on\n" : "off\n");
+    cli_write("Categories:");
+    print_categories(trace_mask);
+    uint64_t recorded = trace_recorded();
+    cli_write("Records: ");
+    cli_write_int((int)(recorded < TRACE_RING_SIZE ? recorded : TRACE_RING_SIZE));
+    if (recorded > TRACE_RING_SIZE) {
+        cli_write(" (");
+        cli_write_int((int)(recorded - TRACE_RING_SIZE));
+        cli_write(" older ones overwritten)");
+    }
+    cli_write("\n");
+}
+
+// trace on [category...]   - start tracing (all categories by default)
+// trace off                - stop, keeping what was recorded
+// trace clear              - drop recorded events
+// trace status             - what is enabled and how much is recorded
+// trace dump [file]        - write Chrome trace JSON (default trace.json)
+void cli_cmd_trace(char *args) {
+    char word[24];
+    const char *p = next_word(args ? args : "", word, sizeof(word));
+
+    if (cli_strcmp(word, "on") == 0) {
+        uint32_t mask = 0;
+        for (;;) {
+            p = next_word(p, word, sizeof(word));
+            if (!word[0]) break;
+            if (cli_strcmp(word, "all") == 0) {
+                mask = TRACE_CAT_ALL;
+                continue;
+            }
+            int bit = trace_category_bit(word);
+            if (bit < 0) {
+                cli_write("Unknown category: ");
+                cli_write(word);
+                cli_write("\nCategories:");
+                print_categories(TRACE_CAT_ALL);
+                return;
+            }
+            mask |= 1u << bit;
+        }
+        if (!mask) mask = TRACE_CAT_ALL;
+        if (!trace_set_mask(mask)) {
+            cli_write("Error: not enough memory for the trace buffer\n");
+            return;
+        }
+        cli_write("Tracing:");
+        print_categories(mask);
+    } else if (cli_strcmp(word, "off") == 0) {
+        trace_set_mask(0);
+        cli_write("Tracing stopped\n");
+    } else if (cli_strcmp(word, "clear") == 0) {
+        trace_clear();
+        cli_write("Trace cleared\n");
+    } else if (cli_strcmp(word, "status") == 0) {
+        print_status();
+    } else if (cli_strcmp(word, "dump") == 0) {
+        char file[32];
+        next_word(p, file, sizeof(file));
+        const char *path = file[0] ? file : DEFAULT_FILE;
+        int events = trace_dump_json(path);
+        if (events < 0) {
+            cli_write("Error: could not write ");
+            cli_write(path);
+            cli_write("\n");
+            return;
+        }
+        cli_write("Wrote ");
+        cli_write_int(events);
+        cli_write(" events to ");
+        cli_write(path);
+        cli_write("\n");
+    } else {
+        cli_write("Usage: trace on [category...]\n");
+        cli_write("       trace off | clear | status\n");
+        cli_write("       trace dump [file]\n");
+        cli_write("Categories:");
+        print_categories(TRACE_CAT_ALL);
+    }
+}
@@ -1,4 +1,6 @@
 #include "cli_utils.h"
+#include "../clock.h"
+#include "../timer.h"
 
 // Forward declarations from cmd.c
 extern void rtc_get_datetime(int *y, int *m, int *d, int *h, int *min, int *s);
@@ -23,4 +25,16 @@ void cli_cmd_uptime(char *args) {
     cli_write_int(up_h); cli_write("h ");
     cli_write_int(up_m); cli_write("m ");
     cli_write_int(up_s); cli_write("s\n");
+    
+    // Timer wakeups per second since boot - low when the system is idle
+    uint64_t secs = clock_monotonic_ns() / CLOCK_NS_PER_SEC;
+    uint64_t wakeups = timer_interrupt_count();
+    cli_write("Timer interrupts: ");
+    cli_write_int((int)wakeups);
+    if (secs > 0) {
+        cli_write(" (");
+        cli_write_int((int)(wakeups / secs));
+        cli_write("/s)");
+    }
+    cli_write("\n");
 }
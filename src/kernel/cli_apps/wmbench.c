@@ -0,0 +1,271 @@
+#include "cli_utils.h"
+#include "../wm.h"
+#include "../graphics.h"
+#include "../perf.h"
+#include "../clock.h"
+#include "../io.h"
+#include "../cmd.h"
+#include "../paint.h"
+#include "../explorer.h"
+#include "../about.h"
+#include "../minesweeper.h"
+#include "../control_panel.h"
+
+// wmbench - drive the window manager through a fixed script of injected mouse
+// events and terminal output, rendering after every step as fast as possible.
+// The frame timer stops painting while it runs, so results don't depend on the
+// 60Hz frame cap.
+
+#define BENCH_MAX_SAMPLES 4096
+
+typedef struct {
+    const char *name;
+    int frames;
+    uint64_t cycles;            // Whole scenario, event handling included
+    uint64_t frame_cycles;      // Rendering only
+    uint64_t p50, p99, max;
+    uint64_t pixels_written;
+    uint64_t pixels_flipped;
+    int stale_pixels;           // Screen pixels that differ from the back buffer at the end
+} BenchResult;
+
+static uint64_t samples[BENCH_MAX_SAMPLES];
+static int sample_count;
+static BenchResult *current;
+
+// Render whatever the last event dirtied and record the frame
+static void bench_frame(void) {
+    uint64_t t0 = clock_cycles();
+    wm_render_frame();
+    uint64_t dt = clock_cycles() - t0;
+    current->frames++;
+    current->frame_cycles += dt;
+    if (sample_count < BENCH_MAX_SAMPLES) samples[sample_count++] = dt;
+}
+
+// Events are injected with interrupts off so a real mouse can't interleave
+static void bench_mouse_to(int x, int y, int buttons) {
+    uint64_t flags = irq_save();
+    int cx, cy;
+    wm_get_mouse_pos(&cx, &cy);
+    wm_handle_mouse(x - cx, y - cy, (uint8_t)buttons);
+    bench_frame();
+    irq_restore(flags);
+}
+
+static void bench_click(int x, int y) {
+    bench_mouse_to(x, y, 0);
+    bench_mouse_to(x, y, 1);
+    bench_mouse_to(x, y, 0);
+}
+
+static void bench_right_click(int x, int y) {
+    bench_mouse_to(x, y, 0);
+    bench_mouse_to(x, y, 2);
+    bench_mouse_to(x, y, 0);
+}
+
+static void bench_begin(BenchResult *r, const char *name) {
+    r->name = name;
+    r->frames = 0;
+    r->frame_cycles = 0;
+    current = r;
+    sample_count = 0;
+    graphics_get_pixel_counts(&r->pixels_written, &r->pixels_flipped);
+    r->cycles = clock_cycles();
+}
+
+static void bench_end(BenchResult *r) {
+    r->cycles = clock_cycles() - r->cycles;
+    uint64_t written, flipped;
+    graphics_get_pixel_counts(&written, &flipped);
+    r->pixels_written = written - r->pixels_written;
+    r->pixels_flipped = flipped - r->pixels_flipped;
+
+    // Everything the scenario drew should have reached the screen - moved
+    // (scrolled, dragged) pixels included. Anything a timer dirtied since
+    // the last frame is rendered first.
+    uint64_t flags = irq_save();
+    wm_render_frame();
+    r->stale_pixels = graphics_count_stale_pixels(0, 0, get_screen_width(), get_screen_height());
+    irq_restore(flags);
+
+    // Insertion sort for the percentiles
+    for (int i = 1; i < sample_count; i++) {
+        uint64_t v = samples[i];
+        int j = i;
+        while (j > 0 && samples[j - 1] > v) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = v;
+    }
+    r->p50 = r->p99 = r->max = 0;
+    if (sample_count > 0) {
+        r->p50 = samples[sample_count / 2];
+        r->p99 = samples[(sample_count * 99) / 100];
+        r->max = samples[sample_count - 1];
+    }
+}
+
+// --- Scenarios ---
+
+// Start menu rows, as laid out by wm_paint (Terminal is skipped - opening it
+// from the menu resets the shell the benchmark runs in)
+static const int open_menu_rows[] = {0, 1, 2, 4, 5, 6, 7, 8};
+
+static void scenario_open_apps(void) {
+    int sh = get_screen_height();
+    int menu_y = sh - 28 - 250;
+    for (unsigned i = 0; i < sizeof(open_menu_rows) / sizeof(open_menu_rows[0]); i++) {
+        bench_click(40, sh - 14);
+        bench_click(40, menu_y + 12 + open_menu_rows[i] * 20);
+    }
+}
+
+static void drag_window(Window *win) {
+    if (!win->visible) return;
+    int x = win->x + 40;
+    int y = win->y + 10;
+    bench_click(x, y);              // Raise it first
+    bench_mouse_to(x, y, 1);
+    for (int i = 1; i <= 30; i++) bench_mouse_to(x + i * 6, y + i * 4, 1);
+    for (int i = 29; i >= 0; i--) bench_mouse_to(x + i * 6, y + i * 4, 1);
+    bench_mouse_to(x, y, 0);
+}
+
+static void scenario_drag(void) {
+    drag_window(&win_explorer);
+    drag_window(&win_notepad);
+    drag_window(&win_calculator);
+    drag_window(&win_minesweeper);
+    drag_window(&win_about);
+}
+
+static void scenario_scroll(void) {
+    if (!win_cmd.visible) return;
+    bench_click(win_cmd.x + 40, win_cmd.y + 10);
+    char line[32];
+    for (int i = 0; i < 1000; i++) {
+        uint64_t flags = irq_save();
+        cli_write("wmbench scroll line ");
+        cli_itoa(i, line);
+        cli_write(line);
+        cli_write("\n");
+        bench_frame();
+        irq_restore(flags);
+    }
+}
+
+static void scenario_menus(void) {
+    int sw = get_screen_width();
+    int sh = get_screen_height();
+    for (int i = 0; i < 20; i++) {
+        bench_click(40, sh - 14);       // Open start menu
+        bench_click(40, sh - 14);       // Close it again
+    }
+    for (int i = 0; i < 20; i++) {
+        bench_right_click(sw - 160, sh - 200);
+        bench_click(sw - 170, sh - 210);   // Outside the menu - closes it
+    }
+}
+
+static void scenario_paint(void) {
+    if (!win_paint.visible) return;
+    bench_click(win_paint.x + 40, win_paint.y + 10);
+    int cx = win_paint.x + 60;
+    int cy = win_paint.y + 30;
+
+    // Zig-zag strokes across the canvas
+    bench_mouse_to(cx + 10, cy + 10, 1);
+    for (int i = 0; i < 200; i++) {
+        int x = cx + 10 + (i * 7) % 280;
+        int y = cy + 10 + ((i / 40) * 36) + ((i & 1) ? 12 : 0);
+        bench_mouse_to(x, y, 1);
+    }
+    bench_mouse_to(cx + 10, cy + 10, 0);
+
+    // Full canvas repaints
+    for (int i = 0; i < 100; i++) {
+        uint64_t flags = irq_save();
+        wm_mark_dirty(win_paint.x, win_paint.y, win_paint.w, win_paint.h);
+        bench_frame();
+        irq_restore(flags);
+    }
+}
+
+// --- Report ---
+
+static void write_time(uint64_t cycles) {
+    cli_write_int((int)clock_cycles_to_us(cycles));
+    cli_write("us");
+}
+
+static void print_result(BenchResult *r) {
+    cli_write(r->name);
+    for (int i = cli_strlen(r->name); i < 11; i++) cli_write(" ");
+    cli_write(" frames "); cli_write_int(r->frames);
+    cli_write(" total "); write_time(r->cycles);
+    cli_write(" p50 "); write_time(r->p50);
+    cli_write(" p99 "); write_time(r->p99);
+    cli_write(" max "); write_time(r->max);
+    cli_write("\n           px written "); cli_write_int((int)r->pixels_written);
+    cli_write(" flipped "); cli_write_int((int)r->pixels_flipped);
+    if (r->stale_pixels) {
+        cli_write("\n           SCREEN DIFFERS: "); cli_write_int(r->stale_pixels);
+        cli_write(" px not flipped");
+    }
+    cli_write("\n");
+}
+
+void cli_cmd_wmbench(char *args) {
+    (void)args;
+
+    // Everything the script changes is put back afterwards
+    Window *wins[] = {&win_explorer, &win_notepad, &win_editor, &win_cmd, &win_calculator,
+                      &win_minesweeper, &win_control_panel, &win_paint, &win_about, &win_markdown};
+    int n = sizeof(wins) / sizeof(wins[0]);
+    int saved_x[10], saved_y[10], saved_z[10];
+    bool saved_visible[10], saved_focused[10];
+    for (int i = 0; i < n; i++) {
+        saved_x[i] = wins[i]->x;
+        saved_y[i] = wins[i]->y;
+        saved_z[i] = wins[i]->z_index;
+        saved_visible[i] = wins[i]->visible;
+        saved_focused[i] = wins[i]->focused;
+    }
+    int mouse_x, mouse_y;
+    wm_get_mouse_pos(&mouse_x, &mouse_y);
+
+    wm_set_render_paused(true);
+    wm_refresh();
+
+    static BenchResult results[5];
+    uint64_t start = clock_cycles();
+    bench_begin(&results[0], "open-apps");  scenario_open_apps(); bench_end(&results[0]);
+    bench_begin(&results[1], "drag");       scenario_drag();      bench_end(&results[1]);
+    bench_begin(&results[2], "scroll");     scenario_scroll();    bench_end(&results[2]);
+    bench_begin(&results[3], "menus");      scenario_menus();     bench_end(&results[3]);
+    bench_begin(&results[4], "paint");      scenario_paint();     bench_end(&results[4]);
+    uint64_t total = clock_cycles() - start;
+
+    // Restore the desktop
+    uint64_t flags = irq_save();
+    int cx, cy;
+    wm_get_mouse_pos(&cx, &cy);
+    wm_handle_mouse(mouse_x - cx, mouse_y - cy, 0);
+    for (int i = 0; i < n; i++) {
+        wins[i]->x = saved_x[i];
+        wins[i]->y = saved_y[i];
+        wins[i]->z_index = saved_z[i];
+        wins[i]->visible = saved_visible[i];
+        wins[i]->focused = saved_focused[i];
+    }
+    wm_set_render_paused(false);
+    wm_refresh();
+    irq_restore(flags);
+
+    cli_write("wmbench results\n");
+    for (int i = 0; i < 5; i++) print_result(&results[i]);
+    cli_write("Total: "); write_time(total); cli_write("\n");
+}
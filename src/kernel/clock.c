@@ -0,0 +1,146 @@
+#include "clock.h"
+#include "acpi.h"
+#include "platform.h"
+#include "io.h"
+#include <stddef.h>
+
+static uint64_t tsc_hz = 0;
+static uint64_t tsc_base = 0;
+static bool tsc_invariant = false;
+static const char *calibration_source = "none";
+
+// Fixed-point factors: ns = cycles * ns_mult >> 32, cycles = ns * cyc_mult >> 24
+static uint64_t ns_mult = 0;
+static uint64_t cyc_mult = 0;
+
+#define PIT_HZ 1193182
+
+// HPET registers
+#define HPET_REG_CAPS    0x000
+#define HPET_REG_CONFIG  0x010
+#define HPET_REG_COUNTER 0x0F0
+#define HPET_CONFIG_ENABLE 0x1
+#define HPET_CAPS_64BIT    (1 << 13)
+
+static void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    asm volatile ("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "a"(leaf), "c"(0));
+}
+
+static bool detect_invariant_tsc(void) {
+    uint32_t a, b, c, d;
+    cpuid(0x80000000, &a, &b, &c, &d);
+    if (a < 0x80000007) return false;
+    cpuid(0x80000007, &a, &b, &c, &d);
+    return (d >> 8) & 1;
+}
+
+// Count TSC cycles over 50ms of HPET time. Returns 0 if there is no HPET.
+static uint64_t calibrate_hpet(void) {
+    const acpi_hpet_t *hpet = (const acpi_hpet_t *)acpi_find_table("HPET");
+    if (!hpet || hpet->base_address.address_space != 0 || !hpet->base_address.address) return 0;
+
+    volatile uint64_t *regs = (volatile uint64_t *)(uintptr_t)p2v(hpet->base_address.address);
+    uint64_t period_fs = regs[HPET_REG_CAPS / 8] >> 32;
+    if (period_fs == 0 || period_fs > 100000000) return 0;    // Spec limit is 100ns
+
+    uint64_t mask = (regs[HPET_REG_CAPS / 8] & HPET_CAPS_64BIT) ? ~0ULL : 0xFFFFFFFFULL;
+    regs[HPET_REG_CONFIG / 8] |= HPET_CONFIG_ENABLE;
+
+    uint64_t wait = 50ULL * 1000000000000ULL / period_fs;     // 50ms in HPET ticks
+    uint64_t h0 = regs[HPET_REG_COUNTER / 8];
+    uint64_t t0 = clock_cycles();
+    uint64_t h1;
+    do {
+        h1 = regs[HPET_REG_COUNTER / 8];
+    } while (((h1 - h0) & mask) < wait);
+    uint64_t t1 = clock_cycles();
+
+    uint64_t elapsed_ns = ((h1 - h0) & mask) * period_fs / 1000000;
+    if (elapsed_ns == 0) return 0;
+    return (t1 - t0) * 1000000000ULL / elapsed_ns;
+}
+
+// Count TSC cycles while PIT channel 2 counts down 10ms (one-shot, polled
+// through port 0x61). Best of three, since a slow poll only ever adds cycles.
+static uint64_t calibrate_pit(void) {
+    const uint32_t count = PIT_HZ / 100;
+    uint64_t best = 0;
+
+    for (int run = 0; run < 3; run++) {
+        // Gate low, speaker off while programming
+        outb(0x61, inb(0x61) & ~0x03);
+        outb(0x43, 0xB0);               // Channel 2, lobyte/hibyte, mode 0
+        outb(0x42, count & 0xFF);
+        outb(0x42, (count >> 8) & 0xFF);
+
+        // Raising the gate starts the count
+        outb(0x61, (inb(0x61) & ~0x02) | 0x01);
+        uint64_t t0 = clock_cycles();
+        while (!(inb(0x61) & 0x20));
+        uint64_t t1 = clock_cycles();
+
+        if (best == 0 || t1 - t0 < best) best = t1 - t0;
+    }
+    outb(0x61, inb(0x61) & ~0x01);
+
+    return best * PIT_HZ / count;
+}
+
+void clock_init(void) {
+    uint64_t flags = irq_save();
+
+    tsc_invariant = detect_invariant_tsc();
+
+    tsc_hz = calibrate_hpet();
+    if (tsc_hz) {
+        calibration_source = "HPET";
+    } else {
+        tsc_hz = calibrate_pit();
+        calibration_source = "PIT";
+    }
+    if (tsc_hz == 0) {
+        tsc_hz = 1000000000ULL;     // Should never happen - assume 1GHz
+        calibration_source = "none";
+    }
+
+    ns_mult = (CLOCK_NS_PER_SEC << 32) / tsc_hz;
+    cyc_mult = (tsc_hz << 24) / CLOCK_NS_PER_SEC;
+    tsc_base = clock_cycles();
+
+    irq_restore(flags);
+}
+
+uint64_t clock_cycles_to_ns(uint64_t cycles) {
+    return (uint64_t)(((unsigned __int128)cycles * ns_mult) >> 32);
+}
+
+uint64_t clock_cycles_to_us(uint64_t cycles) {
+    return clock_cycles_to_ns(cycles) / CLOCK_NS_PER_US;
+}
+
+uint64_t clock_ns_to_cycles(uint64_t ns) {
+    return (uint64_t)(((unsigned __int128)ns * cyc_mult) >> 24);
+}
+
+uint64_t clock_monotonic_ns(void) {
+    return clock_cycles_to_ns(clock_cycles() - tsc_base);
+}
+
+void clock_delay_ns(uint64_t ns) {
+    uint64_t end = clock_cycles() + clock_ns_to_cycles(ns);
+    while (clock_cycles() < end) {
+        asm volatile ("pause");
+    }
+}
+
+uint64_t clock_tsc_hz(void) {
+    return tsc_hz;
+}
+
+bool clock_tsc_invariant(void) {
+    return tsc_invariant;
+}
+
+const char *clock_source_name(void) {
+    return calibration_source;
+}
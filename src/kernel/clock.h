@@ -0,0 +1,37 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Monotonic timekeeping on the TSC, calibrated at boot against the HPET when
+// ACPI reports one, otherwise against PIT channel 2.
+
+#define CLOCK_NS_PER_US 1000ULL
+#define CLOCK_NS_PER_MS 1000000ULL
+#define CLOCK_NS_PER_SEC 1000000000ULL
+
+void clock_init(void);
+
+static inline uint64_t clock_cycles(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+uint64_t clock_monotonic_ns(void);      // Since clock_init()
+
+// Conversions (exact to well under a part per million)
+uint64_t clock_cycles_to_ns(uint64_t cycles);
+uint64_t clock_cycles_to_us(uint64_t cycles);
+uint64_t clock_ns_to_cycles(uint64_t ns);
+
+// Busy-wait without relying on interrupts
+void clock_delay_ns(uint64_t ns);
+
+// Calibration results
+uint64_t clock_tsc_hz(void);
+bool clock_tsc_invariant(void);         // Rate doesn't change with P/C-states
+const char *clock_source_name(void);    // What the TSC was calibrated against
+
+#endif
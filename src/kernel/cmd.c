@@ -16,6 +16,7 @@
 #include "network.h"
 #include "vm.h"
 #include "net_defs.h"
+#include "thread.h"
 
 #define CMD_COLS 116
 #define CMD_ROWS 41
@@ -160,7 +161,30 @@ static void cmd_set_line_content(const char *str) {
 
 // --- Terminal Emulation ---
 
+// The terminal window tracks its own dirty areas (win_cmd.partial_redraw), so
+// typing or printing repaints only the cells that changed.
+#define CMD_TEXT_X() (win_cmd.x + 8)
+#define CMD_TEXT_Y() (win_cmd.y + 32)
+
+static void cmd_mark_window_dirty(void) {
+    if (win_cmd.visible) wm_mark_dirty(win_cmd.x, win_cmd.y, win_cmd.w, win_cmd.h);
+}
+
+static void cmd_mark_row_dirty(int row) {
+    if (!win_cmd.visible || current_mode != MODE_SHELL) return;
+    wm_mark_dirty(CMD_TEXT_X(), CMD_TEXT_Y() + row * LINE_HEIGHT, CMD_COLS * CHAR_WIDTH, LINE_HEIGHT);
+}
+
+static void cmd_mark_cursor_dirty(void) {
+    if (!win_cmd.visible || current_mode != MODE_SHELL) return;
+    wm_mark_dirty(CMD_TEXT_X() + cursor_col * CHAR_WIDTH, CMD_TEXT_Y() + cursor_row * LINE_HEIGHT, CHAR_WIDTH, LINE_HEIGHT);
+}
+
 static void cmd_scroll_up() {
+    // The renderer paints from screen_buffer with interrupts off; shifting
+    // the text and the pixels in one go keeps it from seeing one moved
+    // without the other
+    uint64_t flags = irq_save();
     for (int r = 1; r < CMD_ROWS; r++) {
         for (int c = 0; c < CMD_COLS; c++) {
             screen_buffer[r - 1][c] = screen_buffer[r][c];
@@ -171,6 +195,15 @@ static void cmd_scroll_up() {
         screen_buffer[CMD_ROWS - 1][c].c = ' ';
         screen_buffer[CMD_ROWS - 1][c].color = current_color;
     }
+    
+    // Shift the rendered text up a line instead of repainting every row
+    if (win_cmd.visible && current_mode == MODE_SHELL) {
+        if (!wm_scroll_window_region(&win_cmd, CMD_TEXT_X(), CMD_TEXT_Y(),
+                                     CMD_COLS * CHAR_WIDTH, CMD_ROWS * LINE_HEIGHT, -LINE_HEIGHT)) {
+            cmd_mark_window_dirty();
+        }
+    }
+    irq_restore(flags);
 }
 
 
@@ -190,6 +223,8 @@ void cmd_putchar(char c) {
         return;
     }
     
+    cmd_mark_cursor_dirty();
+    
     if (c == '\n') {
         cursor_col = 0;
         cursor_row++;
@@ -218,6 +253,8 @@ void cmd_putchar(char c) {
         cmd_scroll_up();
         cursor_row = CMD_ROWS - 1;
     }
+    
+    cmd_mark_cursor_dirty();
 }
 
 // Public for CLI apps to use
@@ -260,6 +297,7 @@ void cmd_screen_clear() {
     }
     cursor_row = 0;
     cursor_col = 0;
+    cmd_mark_window_dirty();
 }
 
 // Public for CLI apps to use - exit/close the terminal window
@@ -324,6 +362,7 @@ void pager_wrap_content(const char **lines, int count) {
 // Public for CLI apps to use
 void pager_set_mode(void) {
     current_mode = MODE_PAGER;
+    cmd_mark_window_dirty();
 }
 
 // Internal LS command to avoid stack overflow in external module
@@ -392,6 +431,12 @@ static const CommandEntry commands[] = {
     {"txtedit", cli_cmd_txtedit},
     {"UPTIME", cli_cmd_uptime},
     {"uptime", cli_cmd_uptime},
+    {"CPUS", cli_cmd_cpus},
+    {"cpus", cli_cmd_cpus},
+    {"THREADS", cli_cmd_threads},
+    {"threads", cli_cmd_threads},
+    {"PS", cli_cmd_threads},
+    {"ps", cli_cmd_threads},
     {"BEEP", cli_cmd_beep},
     {"beep", cli_cmd_beep},
     {"COWSAY", cli_cmd_cowsay},
@@ -447,6 +492,10 @@ static const CommandEntry commands[] = {
     {"netinfo", cli_cmd_netinfo},
     {"IPSET", cli_cmd_ipset},
     {"ipset", cli_cmd_ipset},
+    {"NETITR", cli_cmd_netitr},
+    {"netitr", cli_cmd_netitr},
+    {"NETCSUM", cli_cmd_netcsum},
+    {"netcsum", cli_cmd_netcsum},
     {"UDPSEND", cli_cmd_udpsend},
     {"udpsend", cli_cmd_udpsend},
     {"UDPTEST", cli_cmd_udptest},
@@ -457,6 +506,26 @@ static const CommandEntry commands[] = {
     {"dns", cli_cmd_dns},
     {"HTTPGET", cli_cmd_httpget},
     {"httpget", cli_cmd_httpget},
+    {"NETSTAT", cli_cmd_netstat},
+    {"netstat", cli_cmd_netstat},
+    {"TCPCC", cli_cmd_tcpcc},
+    {"tcpcc", cli_cmd_tcpcc},
+    {"TCPBENCH", cli_cmd_tcpbench},
+    {"tcpbench", cli_cmd_tcpbench},
+    {"FPS", cli_cmd_perfhud},
+    {"fps", cli_cmd_perfhud},
+    {"PERFHUD", cli_cmd_perfhud},
+    {"perfhud", cli_cmd_perfhud},
+    {"WMBENCH", cli_cmd_wmbench},
+    {"wmbench", cli_cmd_wmbench},
+    {"CSUMBENCH", cli_cmd_csumbench},
+    {"csumbench", cli_cmd_csumbench},
+    {"PERF", cli_cmd_perf},
+    {"perf", cli_cmd_perf},
+    {"TRACE", cli_cmd_trace},
+    {"trace", cli_cmd_trace},
+    {"IRQSTAT", cli_cmd_irqstat},
+    {"irqstat", cli_cmd_irqstat},
     {"PCILIST", cli_cmd_pcilist},
     {"pcilist", cli_cmd_pcilist},
     {"MSGRC", cli_cmd_msgrc},
@@ -791,6 +860,26 @@ static void cmd_exec(char *cmd) {
     }
 }
 
+// Each command runs on a thread of its own so the desktop stays responsive
+// while it works. The terminal ignores typing until the prompt comes back.
+static volatile bool shell_busy = false;
+static char shell_line[CMD_COLS + 1];
+
+static void cmd_thread(void *arg) {
+    (void)arg;
+    cmd_exec(shell_line);
+    cmd_write(PROMPT);
+    shell_busy = false;
+}
+
+static void cmd_run(const char *line) {
+    cmd_strcpy(shell_line, line);
+    shell_busy = true;
+    if (!thread_create(line[0] ? line : "shell", cmd_thread, NULL, THREAD_PRIORITY_NORMAL)) {
+        // No scheduler or out of memory - run it here instead
+        cmd_thread(NULL);
+    }
+}
 
 // --- Window Functions ---
 
@@ -835,15 +924,32 @@ static void cmd_paint(Window *win) {
 static void cmd_key(Window *target, char c) {
     (void)target;
     if (current_mode == MODE_PAGER) {
+        int old_top = pager_top_line;
         if (c == 'q' || c == 'Q') {
             current_mode = MODE_SHELL;
+            cmd_mark_window_dirty();
         } else if (c == 17) { // UP
             if (pager_top_line > 0) pager_top_line--;
         } else if (c == 18) { // DOWN
             if (pager_top_line < pager_total_lines - CMD_ROWS) pager_top_line++;
         }
+        
+        // Scroll the page by one line and draw just the line that came into view
+        if (pager_top_line != old_top && win_cmd.visible) {
+            int dy = (old_top - pager_top_line) * LINE_HEIGHT;
+            if (!wm_scroll_window_region(&win_cmd, CMD_TEXT_X(), CMD_TEXT_Y(),
+                                         CMD_COLS * CHAR_WIDTH, CMD_ROWS * LINE_HEIGHT, dy)) {
+                cmd_mark_window_dirty();
+            }
+        }
         return;
     }
+    
+    if (shell_busy) return;
+    
+    // Line editing redraws the cursor's old and new rows; output written by
+    // commands marks its own cells as it goes
+    int old_row = cursor_row;
 
     // Shell Mode
     if (c == '\n') { // Enter
@@ -864,9 +970,7 @@ static void cmd_key(Window *target, char c) {
          if (len > 0) cmd_history_add(cmd_buf);
          history_pos = -1;
          
-         cmd_exec(cmd_buf);
-         
-         cmd_write(PROMPT);
+         cmd_run(cmd_buf);
     } else if (c == 17) { // UP
         if (history_len > 0) {
             if (history_pos == -1) {
@@ -919,6 +1023,11 @@ static void cmd_key(Window *target, char c) {
             cmd_putchar(c);
         }
     }
+    
+    if (current_mode == MODE_SHELL) {
+        if (old_row < CMD_ROWS) cmd_mark_row_dirty(old_row);
+        cmd_mark_row_dirty(cursor_row);
+    }
 }
 
 void cmd_reset(void) {
@@ -1161,6 +1270,7 @@ void cmd_init(void) {
     win_cmd.visible = false;
     win_cmd.focused = false;
     win_cmd.z_index = 0;
+    win_cmd.partial_redraw = true;
     win_cmd.paint = cmd_paint;
     win_cmd.handle_key = cmd_key;
     win_cmd.handle_click = NULL;
@@ -0,0 +1,31 @@
+section .text
+global context_switch
+global thread_trampoline
+extern thread_entry
+
+; void context_switch(uint64_t *old_rsp, uint64_t new_rsp)
+; Saves the callee-saved registers on the current stack, stores the stack
+; pointer in *old_rsp and resumes the thread that saved new_rsp.
+context_switch:
+    push rbp
+    push rbx
+    push r12
+    push r13
+    push r14
+    push r15
+    mov [rdi], rsp
+    mov rsp, rsi
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop rbx
+    pop rbp
+    ret
+
+; A new thread's first switch returns here; thread_entry enables interrupts
+thread_trampoline:
+    call thread_entry
+.hang:
+    hlt
+    jmp .hang
@@ -1,9 +1,14 @@
 #include "net_defs.h"
 #include "cmd.h"
 #include "memory_manager.h"
+#include "clock.h"
+#include "wait.h"
+
+#define DNS_QUERY_TIMEOUT_MS 2000   // Per attempt
 
 static ipv4_address_t dns_result_ip;
-static bool dns_resolved = false;
+static volatile bool dns_resolved = false;
+static WaitQueue dns_wait = WAIT_QUEUE_INIT;
 
 void dns_handle_response(void *data, uint16_t len) {
     dns_header_t *dns = (dns_header_t*)data;
@@ -33,6 +38,7 @@ void dns_handle_response(void *data, uint16_t len) {
             dns_result_ip.bytes[2] = p[2];
             dns_result_ip.bytes[3] = p[3];
             dns_resolved = true;
+            wait_queue_wake_all(&dns_wait);
             return;
         }
         p += dlen;
@@ -95,12 +101,7 @@ ipv4_address_t dns_resolve(const char *hostname) {
     for (int i = 0; i < 3 && !dns_resolved; i++) {
         udp_send_packet(&dns_server, 53, 5353, buf, p - buf);
         
-        // Wait loop
-        int timeout = 20000000; 
-        while (!dns_resolved && timeout-- > 0) {
-            extern void network_process_frames(void);
-            network_process_frames();
-        }
+        wait_event_timeout(&dns_wait, dns_resolved, DNS_QUERY_TIMEOUT_MS);
     }
     
     return dns_result_ip;
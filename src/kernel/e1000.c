@@ -4,13 +4,19 @@
 #include "pci.h"
 #include "io.h"
 #include "platform.h"
+#include "memory_manager.h"
+
+#define DMA_ALIGN 128       // Ring bases need 16 bytes, lengths 128; buffers fit cache lines
+#define ETH_HLEN 14         // Offloaded frames are Ethernet II + IPv4
 
 static e1000_device_t e1000_dev;
 static int e1000_initialized = 0;
-static e1000_tx_desc_t tx_descriptors[E1000_TX_RING_SIZE] __attribute__((aligned(16)));
-static e1000_rx_desc_t rx_descriptors[E1000_RX_RING_SIZE] __attribute__((aligned(16)));
-static uint8_t tx_buffers[E1000_TX_RING_SIZE][2048] __attribute__((aligned(16)));
-static uint8_t rx_buffers[E1000_RX_RING_SIZE][2048] __attribute__((aligned(16)));
+
+// Software send queue for when every descriptor is in flight, chained
+// through the netbufs
+static netbuf_t* tx_queue_first = NULL;
+static netbuf_t* tx_queue_last = NULL;
+static int tx_queue_count = 0;
 
 static void* kmemcpy(void* dest, const void* src, size_t n) {
     uint8_t* d = (uint8_t*)dest;
@@ -19,7 +25,50 @@ static void* kmemcpy(void* dest, const void* src, size_t n) {
     return dest;
 }
 
-int e1000_init(pci_device_t* pci_dev) {
+// The heap is part of the kernel image, which is physically contiguous, so
+// v2p() of any heap range is a valid DMA address for the whole range
+static void* dma_alloc(size_t size, void** raw) {
+    *raw = kmalloc(size + DMA_ALIGN - 1);
+    if (!*raw) return NULL;
+    uint8_t* p = (uint8_t*)(((uintptr_t)*raw + DMA_ALIGN - 1) & ~(uintptr_t)(DMA_ALIGN - 1));
+    for (size_t i = 0; i < size; i++) p[i] = 0;
+    return p;
+}
+
+static uint16_t ring_size(uint16_t requested, uint16_t fallback) {
+    uint32_t want = requested ? requested : fallback;
+    if (want > E1000_RING_MAX) want = E1000_RING_MAX;
+    uint32_t n = E1000_RING_MIN;
+    while (n < want) n <<= 1;
+    return (uint16_t)n;
+}
+
+// Descriptor rings and the netbuf slots behind them, allocated in one go so
+// a failure leaves nothing behind. Packet buffers come from the netbuf pool,
+// which grows by enough to keep both rings and the send queue full.
+static int alloc_rings(uint16_t rx_size, uint16_t tx_size) {
+    void* raw[4] = {0};
+    e1000_dev.tx_descriptors = dma_alloc(tx_size * sizeof(e1000_tx_desc_t), &raw[0]);
+    e1000_dev.rx_descriptors = dma_alloc(rx_size * sizeof(e1000_rx_desc_t), &raw[1]);
+    e1000_dev.tx_bufs = kmalloc(tx_size * sizeof(netbuf_t*));
+    e1000_dev.rx_bufs = kmalloc(rx_size * sizeof(netbuf_t*));
+    raw[2] = e1000_dev.tx_bufs;
+    raw[3] = e1000_dev.rx_bufs;
+    for (int i = 0; i < 4; i++) {
+        if (raw[i]) continue;
+        for (int j = 0; j < 4; j++) kfree(raw[j]);
+        return -1;
+    }
+    if (netbuf_pool_add(rx_size + tx_size + E1000_TX_QUEUE_SIZE + E1000_NETBUF_SPARE) != 0) {
+        for (int j = 0; j < 4; j++) kfree(raw[j]);
+        return -1;
+    }
+    e1000_dev.tx_ring_size = tx_size;
+    e1000_dev.rx_ring_size = rx_size;
+    return 0;
+}
+
+int e1000_init(pci_device_t* pci_dev, uint16_t rx_ring_size, uint16_t tx_ring_size) {
     if (e1000_initialized) return 0;
     uint32_t bar0 = pci_read_config(pci_dev->bus, pci_dev->device, pci_dev->function, 0x10);
     if (bar0 == 0 || bar0 == 0xFFFFFFFF) return -1;
@@ -53,12 +102,17 @@ int e1000_init(pci_device_t* pci_dev) {
     e1000_dev.mac_address.bytes[4] = (uint8_t)(rah & 0xFF);
     e1000_dev.mac_address.bytes[5] = (uint8_t)((rah >> 8) & 0xFF);
 
-    e1000_dev.tx_descriptors = tx_descriptors;
+    if (alloc_rings(ring_size(rx_ring_size, E1000_RX_RING_DEFAULT),
+                    ring_size(tx_ring_size, E1000_TX_RING_DEFAULT)) != 0) return -1;
+
     e1000_dev.tx_head = 0;
     e1000_dev.tx_tail = 0;
-    for (int i = 0; i < E1000_TX_RING_SIZE; i++) {
-        e1000_dev.tx_buffers[i] = tx_buffers[i];
-        e1000_dev.tx_descriptors[i].buffer_addr = v2p((uint64_t)(uintptr_t)tx_buffers[i]);
+    e1000_dev.tx_doorbell = 0;
+    e1000_dev.tx_batch = 0;
+    e1000_dev.tx_context = 0;
+    for (int i = 0; i < e1000_dev.tx_ring_size; i++) {
+        e1000_dev.tx_bufs[i] = NULL;
+        e1000_dev.tx_descriptors[i].buffer_addr = 0;
         e1000_dev.tx_descriptors[i].length = 0;
         e1000_dev.tx_descriptors[i].cso = 0;
         e1000_dev.tx_descriptors[i].cmd = 0;
@@ -66,42 +120,55 @@ int e1000_init(pci_device_t* pci_dev) {
         e1000_dev.tx_descriptors[i].css = 0;
         e1000_dev.tx_descriptors[i].special = 0;
     }
-    uint64_t tx_desc_phys = v2p((uint64_t)(uintptr_t)tx_descriptors);
+    uint64_t tx_desc_phys = v2p((uint64_t)(uintptr_t)e1000_dev.tx_descriptors);
     e1000_write_reg(mmio_base, E1000_REG_TDBAL, (uint32_t)(tx_desc_phys & 0xFFFFFFFF));
     e1000_write_reg(mmio_base, E1000_REG_TDBAH, (uint32_t)(tx_desc_phys >> 32));
-    e1000_write_reg(mmio_base, E1000_REG_TDLEN, E1000_TX_RING_SIZE * sizeof(e1000_tx_desc_t));
+    e1000_write_reg(mmio_base, E1000_REG_TDLEN, e1000_dev.tx_ring_size * sizeof(e1000_tx_desc_t));
     e1000_write_reg(mmio_base, E1000_REG_TDH, 0);
     e1000_write_reg(mmio_base, E1000_REG_TDT, 0);
     uint32_t tctl = E1000_TCTL_EN | E1000_TCTL_PSP | (E1000_TCTL_CT & (0x10 << 4)) | (E1000_TCTL_COLD & (0x40 << 12));
     e1000_write_reg(mmio_base, E1000_REG_TCTL, tctl);
     e1000_write_reg(mmio_base, E1000_REG_TIPG, 0x0060200A);
 
-    e1000_dev.rx_descriptors = rx_descriptors;
     e1000_dev.rx_head = 0;
-    e1000_dev.rx_tail = E1000_RX_RING_SIZE - 1;
-    for (int i = 0; i < E1000_RX_RING_SIZE; i++) {
-        e1000_dev.rx_buffers[i] = rx_buffers[i];
-        e1000_dev.rx_descriptors[i].buffer_addr = v2p((uint64_t)(uintptr_t)rx_buffers[i]);
+    e1000_dev.rx_tail = e1000_dev.rx_ring_size - 1;
+    e1000_dev.rx_doorbell = e1000_dev.rx_ring_size - 1;
+    for (int i = 0; i < e1000_dev.rx_ring_size; i++) {
+        // The hardware writes from the start of the buffer, so received
+        // frames have no headroom
+        e1000_dev.rx_bufs[i] = netbuf_alloc();
+        e1000_dev.rx_descriptors[i].buffer_addr = v2p((uint64_t)(uintptr_t)e1000_dev.rx_bufs[i]->head);
         e1000_dev.rx_descriptors[i].length = 0;
         e1000_dev.rx_descriptors[i].checksum = 0;
         e1000_dev.rx_descriptors[i].status = 0;
         e1000_dev.rx_descriptors[i].errors = 0;
         e1000_dev.rx_descriptors[i].special = 0;
     }
-    uint64_t rx_desc_phys = v2p((uint64_t)(uintptr_t)rx_descriptors);
+    uint64_t rx_desc_phys = v2p((uint64_t)(uintptr_t)e1000_dev.rx_descriptors);
     e1000_write_reg(mmio_base, E1000_REG_RDBAL, (uint32_t)(rx_desc_phys & 0xFFFFFFFF));
     e1000_write_reg(mmio_base, E1000_REG_RDBAH, (uint32_t)(rx_desc_phys >> 32));
-    e1000_write_reg(mmio_base, E1000_REG_RDLEN, E1000_RX_RING_SIZE * sizeof(e1000_rx_desc_t));
+    e1000_write_reg(mmio_base, E1000_REG_RDLEN, e1000_dev.rx_ring_size * sizeof(e1000_rx_desc_t));
     e1000_write_reg(mmio_base, E1000_REG_RDH, 0);
-    e1000_write_reg(mmio_base, E1000_REG_RDT, E1000_RX_RING_SIZE - 1);
+    e1000_write_reg(mmio_base, E1000_REG_RDT, e1000_dev.rx_ring_size - 1);
     uint32_t rctl = E1000_RCTL_EN | E1000_RCTL_SBP | E1000_RCTL_UPE | E1000_RCTL_MPE |
                     E1000_RCTL_LPE | E1000_RCTL_LBM_NONE | E1000_RCTL_RDMTS_HALF |
                     E1000_RCTL_MO_36 | E1000_RCTL_BAM | E1000_RCTL_BSIZE_2048 | E1000_RCTL_SECRC;
     e1000_write_reg(mmio_base, E1000_REG_RCTL, rctl);
     ctrl = e1000_read_reg(mmio_base, E1000_REG_CTRL);
     e1000_write_reg(mmio_base, E1000_REG_CTRL, ctrl | E1000_CTRL_SLU);
+
+    // Interrupts stay masked until the stack has a handler on the line.
+    // Receive interrupts fire per frame (no RDTR delay); ITR bounds the rate.
+    uint32_t intr = pci_read_config(pci_dev->bus, pci_dev->device, pci_dev->function, 0x3C);
+    e1000_dev.irq_line = (uint8_t)(intr & 0xFF);
+    e1000_dev.irq_count = 0;
+    e1000_write_reg(mmio_base, E1000_REG_IMC, 0xFFFFFFFF);
+    e1000_read_reg(mmio_base, E1000_REG_ICR);
+    e1000_write_reg(mmio_base, E1000_REG_RDTR, 0);
     e1000_dev.initialized = 1;
     e1000_initialized = 1;
+    e1000_set_itr(E1000_ITR_DEFAULT);
+    e1000_set_csum_offload(1);
     return 0;
 }
 
@@ -110,36 +177,264 @@ e1000_device_t* e1000_get_device(void) {
     return &e1000_dev;
 }
 
+// --- Transmit (interrupts off) ---
+
+// Every descriptor asks for a status write-back (RS), so the hardware sets DD
+// once it is done with the buffer
+static void tx_reclaim(void) {
+    while (e1000_dev.tx_head != e1000_dev.tx_tail) {
+        volatile e1000_tx_desc_t* desc = &e1000_dev.tx_descriptors[e1000_dev.tx_head];
+        if (!(desc->status & E1000_TXD_STAT_DD)) break;
+        desc->status = 0;
+        netbuf_free(e1000_dev.tx_bufs[e1000_dev.tx_head]);
+        e1000_dev.tx_bufs[e1000_dev.tx_head] = NULL;
+        e1000_dev.tx_head = (e1000_dev.tx_head + 1) & (e1000_dev.tx_ring_size - 1);
+    }
+}
+
+static uint16_t tx_ring_space(void) {
+    return (e1000_dev.tx_head - e1000_dev.tx_tail - 1) & (e1000_dev.tx_ring_size - 1);
+}
+
+// Checksum offload context a frame needs, 0 for none: the IPv4 header
+// length and which checksums to insert
+static uint32_t tx_context_for(const netbuf_t* nb) {
+    uint8_t want = nb->csum & (NETBUF_CSUM_IP | NETBUF_CSUM_TCP | NETBUF_CSUM_UDP);
+    if (!want || nb->len < ETH_HLEN + 20) return 0;
+    uint8_t ihl = (nb->data[ETH_HLEN] & 0x0F) * 4;
+    return 0x10000 | ((uint32_t)ihl << 8) | want;
+}
+
+// The hardware keeps the last context, so a new one is only loaded when the
+// kind of frame changes (say from TCP to UDP)
+static uint16_t tx_slots(const netbuf_t* nb) {
+    uint32_t ctx = tx_context_for(nb);
+    return (ctx && ctx != e1000_dev.tx_context) ? 2 : 1;
+}
+
+static void tx_load_context(uint32_t ctx) {
+    uint16_t tail = e1000_dev.tx_tail;
+    uint8_t ihl = (uint8_t)(ctx >> 8);
+    int tcp = (ctx & NETBUF_CSUM_TCP) != 0;
+    volatile e1000_tx_context_desc_t* desc = (volatile e1000_tx_context_desc_t*)&e1000_dev.tx_descriptors[tail];
+    desc->ipcss = ETH_HLEN;
+    desc->ipcso = ETH_HLEN + 10;
+    desc->ipcse = ETH_HLEN + ihl - 1;
+    desc->tucss = ETH_HLEN + ihl;
+    desc->tucso = ETH_HLEN + ihl + (tcp ? 16 : 6);
+    desc->tucse = 0;
+    desc->cmd_and_length = (uint32_t)(E1000_TXD_CMD_DEXT | E1000_TXD_CMD_RS | E1000_TXD_TUCMD_IP |
+                                      (tcp ? E1000_TXD_TUCMD_TCP : 0)) << E1000_TXD_CMD_SHIFT;
+    desc->status = 0;
+    desc->hdr_len = 0;
+    desc->mss = 0;
+    e1000_dev.tx_bufs[tail] = NULL;
+    e1000_dev.tx_tail = (tail + 1) & (e1000_dev.tx_ring_size - 1);
+    e1000_dev.tx_context = ctx;
+    e1000_dev.tx_contexts++;
+}
+
+// Needs tx_slots(nb) free descriptors
+static void tx_ring_put(netbuf_t* nb) {
+    uint32_t ctx = tx_context_for(nb);
+    if (ctx && ctx != e1000_dev.tx_context) tx_load_context(ctx);
+    uint16_t tail = e1000_dev.tx_tail;
+    e1000_dev.tx_bufs[tail] = nb;
+    if (ctx) {
+        volatile e1000_tx_data_desc_t* desc = (volatile e1000_tx_data_desc_t*)&e1000_dev.tx_descriptors[tail];
+        desc->buffer_addr = netbuf_dma(nb);
+        desc->cmd_and_length = nb->len | E1000_TXD_DTYP_D |
+            (uint32_t)(E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS | E1000_TXD_CMD_DEXT) << E1000_TXD_CMD_SHIFT;
+        desc->status = 0;
+        desc->popts = ((nb->csum & NETBUF_CSUM_IP) ? E1000_TXD_POPTS_IXSM : 0) |
+                      ((nb->csum & (NETBUF_CSUM_TCP | NETBUF_CSUM_UDP)) ? E1000_TXD_POPTS_TXSM : 0);
+        desc->special = 0;
+        e1000_dev.tx_offloaded++;
+    } else {
+        volatile e1000_tx_desc_t* desc = &e1000_dev.tx_descriptors[tail];
+        desc->buffer_addr = netbuf_dma(nb);
+        desc->length = nb->len;
+        desc->cso = 0;
+        desc->cmd = E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS;
+        desc->status = 0;
+        desc->css = 0;
+        desc->special = 0;
+    }
+    e1000_dev.tx_tail = (tail + 1) & (e1000_dev.tx_ring_size - 1);
+    e1000_dev.tx_sent++;
+}
+
+static void tx_queue_drain(void) {
+    while (tx_queue_count > 0) {
+        uint16_t need = tx_slots(tx_queue_first);
+        if (tx_ring_space() < need) tx_reclaim();
+        if (tx_ring_space() < need) break;
+        netbuf_t* nb = tx_queue_first;
+        tx_queue_first = nb->next;
+        if (!tx_queue_first) tx_queue_last = NULL;
+        tx_queue_count--;
+        nb->next = NULL;
+        tx_ring_put(nb);
+    }
+}
+
+// One MMIO write hands the hardware everything filled in since the last one
+static void tx_kick(void) {
+    if (e1000_dev.tx_batch > 0 || e1000_dev.tx_tail == e1000_dev.tx_doorbell) return;
+    asm volatile ("" ::: "memory");     // Descriptors before the doorbell
+    e1000_write_reg(e1000_dev.mmio_base, E1000_REG_TDT, e1000_dev.tx_tail);
+    e1000_dev.tx_doorbell = e1000_dev.tx_tail;
+    e1000_dev.tx_doorbells++;
+}
+
+int e1000_send_netbuf(netbuf_t* nb) {
+    if (!e1000_initialized || !e1000_dev.initialized) {
+        netbuf_free(nb);
+        return -1;
+    }
+    int result = 0;
+    uint64_t flags = irq_save();
+
+    // Queued frames go first so nothing is reordered
+    tx_queue_drain();
+    uint16_t need = tx_slots(nb);
+    if (tx_queue_count == 0 && tx_ring_space() < need) tx_reclaim();
+    if (tx_queue_count == 0 && tx_ring_space() >= need) {
+        tx_ring_put(nb);
+    } else if (tx_queue_count < E1000_TX_QUEUE_SIZE) {
+        nb->next = NULL;
+        if (tx_queue_last) tx_queue_last->next = nb;
+        else tx_queue_first = nb;
+        tx_queue_last = nb;
+        tx_queue_count++;
+        e1000_dev.tx_queued++;
+    } else {
+        e1000_dev.tx_dropped++;
+        netbuf_free(nb);
+        result = -1;
+    }
+    tx_kick();
+
+    irq_restore(flags);
+    return result;
+}
+
 int e1000_send_packet(const void* data, size_t length) {
     if (!e1000_initialized || !e1000_dev.initialized) return -1;
-    if (length > 2048) return -1;
-    volatile uint32_t* mmio = e1000_dev.mmio_base;
-    uint16_t next_tail = (e1000_dev.tx_tail + 1) % E1000_TX_RING_SIZE;
-    if (next_tail == e1000_dev.tx_head) return -1;
-    kmemcpy(e1000_dev.tx_buffers[e1000_dev.tx_tail], data, length);
-    e1000_dev.tx_descriptors[e1000_dev.tx_tail].length = (uint16_t)length;
-    e1000_dev.tx_descriptors[e1000_dev.tx_tail].cmd = 0x0B;
-    e1000_dev.tx_descriptors[e1000_dev.tx_tail].status = 0;
-    e1000_dev.tx_tail = next_tail;
-    e1000_write_reg(mmio, E1000_REG_TDT, e1000_dev.tx_tail);
-    return 0;
+    netbuf_t* nb = netbuf_alloc();
+    if (!nb) {
+        e1000_dev.tx_dropped++;
+        return -1;
+    }
+    uint8_t* p = netbuf_put(nb, length);
+    if (!p) {
+        netbuf_free(nb);
+        return -1;
+    }
+    kmemcpy(p, data, length);
+    return e1000_send_netbuf(nb);
+}
+
+void e1000_tx_batch_begin(void) {
+    uint64_t flags = irq_save();
+    e1000_dev.tx_batch++;
+    irq_restore(flags);
+}
+
+void e1000_tx_batch_end(void) {
+    uint64_t flags = irq_save();
+    if (e1000_dev.tx_batch > 0) e1000_dev.tx_batch--;
+    if (e1000_initialized) tx_kick();
+    irq_restore(flags);
+}
+
+void e1000_tx_poll(void) {
+    if (!e1000_initialized) return;
+    uint64_t flags = irq_save();
+    tx_reclaim();
+    tx_queue_drain();
+    tx_kick();
+    irq_restore(flags);
+}
+
+// The DD bit alone says whether the hardware is done with a descriptor, so
+// no register has to be read per frame. The filled buffer itself goes up the
+// stack and a fresh one takes its place on the ring.
+netbuf_t* e1000_receive_netbuf(void) {
+    if (!e1000_initialized || !e1000_dev.initialized) return NULL;
+    for (;;) {
+        uint16_t next_idx = (e1000_dev.rx_tail + 1) & (e1000_dev.rx_ring_size - 1);
+        volatile e1000_rx_desc_t* desc = &e1000_dev.rx_descriptors[next_idx];
+        if (!(desc->status & E1000_RXD_STAT_DD)) return NULL;
+        netbuf_t* nb = e1000_dev.rx_bufs[next_idx];
+        netbuf_t* fresh = netbuf_alloc();
+        if (fresh) {
+            // SECRC: the length no longer includes the CRC
+            nb->data = nb->head;
+            nb->len = desc->length;
+            nb->csum = 0;
+            if (!(desc->status & E1000_RXD_STAT_IXSM)) {
+                if ((desc->status & E1000_RXD_STAT_IPCS) && !(desc->errors & E1000_RXD_ERR_IPE)) nb->csum |= NETBUF_CSUM_IP_OK;
+                if ((desc->status & E1000_RXD_STAT_TCPCS) && !(desc->errors & E1000_RXD_ERR_TCPE)) nb->csum |= NETBUF_CSUM_L4_OK;
+            }
+            e1000_dev.rx_bufs[next_idx] = fresh;
+            desc->buffer_addr = v2p((uint64_t)(uintptr_t)fresh->head);
+        } else {
+            e1000_dev.rx_pool_empty++;
+            nb = NULL;
+        }
+        desc->status = 0;
+        desc->length = 0;
+        e1000_dev.rx_tail = next_idx;
+        uint16_t returned = (e1000_dev.rx_tail - e1000_dev.rx_doorbell) & (e1000_dev.rx_ring_size - 1);
+        if (returned >= E1000_RX_REFILL_BATCH || returned >= e1000_dev.rx_ring_size / 4) e1000_rx_flush();
+        if (nb) return nb;
+    }
+}
+
+void e1000_rx_flush(void) {
+    if (!e1000_initialized || e1000_dev.rx_tail == e1000_dev.rx_doorbell) return;
+    asm volatile ("" ::: "memory");
+    e1000_write_reg(e1000_dev.mmio_base, E1000_REG_RDT, e1000_dev.rx_tail);
+    e1000_dev.rx_doorbell = e1000_dev.rx_tail;
+}
+
+// --- Interrupts ---
+
+uint32_t e1000_irq_ack(void) {
+    if (!e1000_initialized) return 0;
+    // Reading ICR clears it and deasserts the (level-triggered) line
+    uint32_t icr = e1000_read_reg(e1000_dev.mmio_base, E1000_REG_ICR);
+    if (icr) {
+        e1000_write_reg(e1000_dev.mmio_base, E1000_REG_IMC, 0xFFFFFFFF);
+        e1000_dev.irq_count++;
+        if (icr & E1000_ICR_RXO) e1000_dev.rx_overruns++;
+    }
+    return icr;
+}
+
+void e1000_irq_enable(void) {
+    if (!e1000_initialized) return;
+    e1000_write_reg(e1000_dev.mmio_base, E1000_REG_IMS, E1000_IMS_DEFAULT);
+}
+
+// ITR counts in 256 ns units between interrupts
+void e1000_set_itr(uint32_t interrupts_per_sec) {
+    if (!e1000_initialized) return;
+    uint64_t interval = interrupts_per_sec ? 1000000000ULL / ((uint64_t)interrupts_per_sec * 256) : 0;
+    if (interval > 0xFFFF) interval = 0xFFFF;
+    e1000_write_reg(e1000_dev.mmio_base, E1000_REG_ITR, (uint32_t)interval);
+    e1000_dev.itr_rate = interrupts_per_sec;
+}
+
+void e1000_set_csum_offload(int on) {
+    if (!e1000_initialized) return;
+    e1000_write_reg(e1000_dev.mmio_base, E1000_REG_RXCSUM, on ? (E1000_RXCSUM_IPOFL | E1000_RXCSUM_TUOFL) : 0);
+    e1000_dev.csum_offload = on;
 }
 
-int e1000_receive_packet(void* buffer, size_t buffer_size) {
-    if (!e1000_initialized || !e1000_dev.initialized) return 0;
-    volatile uint32_t* mmio = e1000_dev.mmio_base;
-    uint16_t hw_head = e1000_read_reg(mmio, E1000_REG_RDH);
-    uint16_t tail = e1000_read_reg(mmio, E1000_REG_RDT);
-    uint16_t next_idx = (tail + 1) % E1000_RX_RING_SIZE;
-    if (hw_head == next_idx) return 0;
-    if (!(e1000_dev.rx_descriptors[next_idx].status & 1)) return 0;
-    uint16_t length = e1000_dev.rx_descriptors[next_idx].length - 4;
-    if (length > buffer_size) length = (uint16_t)buffer_size;
-    kmemcpy(buffer, e1000_dev.rx_buffers[next_idx], length);
-    e1000_dev.rx_descriptors[next_idx].status = 0;
-    e1000_dev.rx_descriptors[next_idx].length = 0;
-    tail = next_idx;
-    e1000_write_reg(mmio, E1000_REG_RDT, tail);
-    e1000_dev.rx_tail = tail;
-    return (int)length;
+void e1000_update_stats(void) {
+    if (!e1000_initialized) return;
+    e1000_dev.rx_missed += e1000_read_reg(e1000_dev.mmio_base, E1000_REG_MPC);
+    e1000_dev.rx_no_buffer += e1000_read_reg(e1000_dev.mmio_base, E1000_REG_RNBC);
 }
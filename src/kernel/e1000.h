@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "pci.h"
+#include "netbuf.h"
 
 #define E1000_VENDOR_ID 0x8086
 #define E1000_DEVICE_ID_82540EM 0x100E
@@ -12,7 +13,9 @@
 #define E1000_REG_STATUS   0x0008
 #define E1000_REG_EERD     0x0014
 #define E1000_REG_ICR      0x00C0
+#define E1000_REG_ITR      0x00C4
 #define E1000_REG_IMS      0x00D0
+#define E1000_REG_IMC      0x00D8
 #define E1000_REG_RCTL     0x0100
 #define E1000_REG_TCTL     0x0400
 #define E1000_REG_TIPG     0x0410
@@ -21,11 +24,15 @@
 #define E1000_REG_RDLEN    0x2808
 #define E1000_REG_RDH      0x2810
 #define E1000_REG_RDT      0x2818
+#define E1000_REG_RDTR     0x2820
 #define E1000_REG_TDBAL    0x3800
 #define E1000_REG_TDBAH    0x3804
 #define E1000_REG_TDLEN    0x3808
 #define E1000_REG_TDH      0x3810
 #define E1000_REG_TDT      0x3818
+#define E1000_REG_MPC      0x4010
+#define E1000_REG_RNBC     0x40A0
+#define E1000_REG_RXCSUM   0x5000
 #define E1000_REG_RAL      0x5400
 #define E1000_REG_RAH      0x5404
 
@@ -50,10 +57,46 @@
 #define E1000_TCTL_COLD    (0x3F << 12)
 
 #define E1000_ICR_TXDW     (1 << 0)
+#define E1000_ICR_LSC      (1 << 2)
+#define E1000_ICR_RXDMT0   (1 << 4)
+#define E1000_ICR_RXO      (1 << 6)
 #define E1000_ICR_RXT0     (1 << 7)
+#define E1000_IMS_DEFAULT  (E1000_ICR_RXT0 | E1000_ICR_RXDMT0 | E1000_ICR_RXO | E1000_ICR_TXDW | E1000_ICR_LSC)
 
-#define E1000_TX_RING_SIZE 32
-#define E1000_RX_RING_SIZE 32
+#define E1000_RXD_STAT_DD  0x01
+#define E1000_RXD_STAT_IXSM 0x04    // Checksums not looked at
+#define E1000_RXD_STAT_TCPCS 0x20   // TCP/UDP checksum was checked
+#define E1000_RXD_STAT_IPCS 0x40    // IPv4 header checksum was checked
+#define E1000_RXD_ERR_TCPE 0x20
+#define E1000_RXD_ERR_IPE  0x40
+
+#define E1000_RXCSUM_IPOFL (1 << 8)
+#define E1000_RXCSUM_TUOFL (1 << 9)
+
+// Interrupt throttling: at most this many interrupts a second (0 = no limit)
+#define E1000_ITR_DEFAULT  8000
+
+#define E1000_TXD_CMD_EOP  0x01
+#define E1000_TXD_CMD_IFCS 0x02
+#define E1000_TXD_CMD_RS   0x08
+#define E1000_TXD_CMD_DEXT 0x20     // Extended (context/data) descriptor
+#define E1000_TXD_STAT_DD  0x01
+#define E1000_TXD_DTYP_D   (1 << 20)    // Data descriptor; context is 0
+#define E1000_TXD_CMD_SHIFT 24
+#define E1000_TXD_TUCMD_TCP 0x01    // Context: TCP rather than UDP
+#define E1000_TXD_TUCMD_IP 0x02     // Context: IPv4
+#define E1000_TXD_POPTS_IXSM 0x01   // Insert the IPv4 header checksum
+#define E1000_TXD_POPTS_TXSM 0x02   // Insert the TCP/UDP checksum
+
+// Ring sizes are picked at init: a power of two between these (the hardware
+// wants a multiple of 8 descriptors and takes up to 4096 here)
+#define E1000_RING_MIN 8
+#define E1000_RING_MAX 4096
+#define E1000_TX_RING_DEFAULT 256
+#define E1000_RX_RING_DEFAULT 256
+#define E1000_TX_QUEUE_SIZE 64      // Frames held back while the ring is full
+#define E1000_NETBUF_SPARE 64       // Pool buffers beyond the rings, for frames in the stack
+#define E1000_RX_REFILL_BATCH 8     // Descriptors handed back per RDT write
 
 typedef struct {
     uint64_t buffer_addr;
@@ -65,6 +108,29 @@ typedef struct {
     uint16_t special;
 } __attribute__((packed)) e1000_tx_desc_t;
 
+// Offload context: where the checksums start, end and go. The hardware keeps
+// it for the data descriptors that follow.
+typedef struct {
+    uint8_t ipcss;
+    uint8_t ipcso;
+    uint16_t ipcse;
+    uint8_t tucss;
+    uint8_t tucso;
+    uint16_t tucse;                 // 0 = to the end of the frame
+    uint32_t cmd_and_length;
+    uint8_t status;
+    uint8_t hdr_len;
+    uint16_t mss;
+} __attribute__((packed)) e1000_tx_context_desc_t;
+
+typedef struct {
+    uint64_t buffer_addr;
+    uint32_t cmd_and_length;
+    uint8_t status;
+    uint8_t popts;
+    uint16_t special;
+} __attribute__((packed)) e1000_tx_data_desc_t;
+
 typedef struct {
     uint64_t buffer_addr;
     uint16_t length;
@@ -80,20 +146,71 @@ typedef struct {
     int initialized;
     struct { uint8_t bytes[6]; } mac_address;
     e1000_tx_desc_t* tx_descriptors;
-    void* tx_buffers[E1000_TX_RING_SIZE];
-    uint16_t tx_head;
-    uint16_t tx_tail;
+    netbuf_t** tx_bufs;             // Frame behind each in-flight descriptor
+    uint16_t tx_ring_size;
+    uint16_t tx_head;               // Oldest descriptor not yet reclaimed
+    uint16_t tx_tail;               // Next free descriptor
+    uint16_t tx_doorbell;           // Last value written to TDT
+    int tx_batch;                   // Nesting depth of e1000_tx_batch_begin()
+    uint32_t tx_sent;
+    uint32_t tx_queued;             // Had to wait in the send queue
+    uint32_t tx_dropped;            // Send queue full too
+    uint32_t tx_doorbells;
+    uint32_t tx_context;            // Offload context last loaded, 0 if none
+    uint32_t tx_contexts;           // Context descriptors written
+    uint32_t tx_offloaded;          // Frames sent with checksum insertion
+    int csum_offload;               // Stack asks for TX offload; RXCSUM on
     e1000_rx_desc_t* rx_descriptors;
-    void* rx_buffers[E1000_RX_RING_SIZE];
+    netbuf_t** rx_bufs;             // Buffer posted to each descriptor
+    uint16_t rx_ring_size;
     uint16_t rx_head;
-    uint16_t rx_tail;
+    uint16_t rx_tail;               // Last descriptor given to the hardware
+    uint16_t rx_doorbell;           // Last value written to RDT
+    uint8_t irq_line;               // PCI Interrupt Line, 0xFF if none
+    uint32_t irq_count;
+    uint32_t itr_rate;              // Interrupts a second, 0 = unthrottled
+    uint32_t rx_missed;             // MPC: dropped for lack of FIFO space
+    uint32_t rx_no_buffer;          // RNBC: no free descriptor when a frame came in
+    uint32_t rx_overruns;           // RXO interrupts
+    uint32_t rx_pool_empty;         // Dropped: no netbuf to replace the filled one
 } e1000_device_t;
 
-int e1000_init(pci_device_t* pci_dev);
+// Ring sizes of 0 pick the defaults; others are rounded up to a power of two
+// and clamped to E1000_RING_MIN..E1000_RING_MAX
+int e1000_init(pci_device_t* pci_dev, uint16_t rx_ring_size, uint16_t tx_ring_size);
 static inline uint32_t e1000_read_reg(volatile uint32_t* mmio_base, uint16_t offset) { return mmio_base[offset / 4]; }
 static inline void e1000_write_reg(volatile uint32_t* mmio_base, uint16_t offset, uint32_t value) { mmio_base[offset / 4] = value; }
 e1000_device_t* e1000_get_device(void);
+// Takes ownership of nb (freed once the hardware has sent it, or on error);
+// the frame goes out of the netbuf without a copy
+int e1000_send_netbuf(netbuf_t* nb);
+// Copies the frame into a netbuf first
 int e1000_send_packet(const void* data, size_t length);
-int e1000_receive_packet(void* buffer, size_t buffer_size);
+// Between begin and end, sends only fill descriptors; end rings the doorbell
+// once for all of them. Batches nest.
+void e1000_tx_batch_begin(void);
+void e1000_tx_batch_end(void);
+// Reclaim finished descriptors and move queued frames onto the ring
+void e1000_tx_poll(void);
+// The next received frame in the buffer the hardware wrote it to, or NULL.
+// The caller owns it and frees it; the descriptor gets a fresh one from the
+// pool (or, with the pool empty, the frame is dropped and its buffer reposted).
+netbuf_t* e1000_receive_netbuf(void);
+// Hand received descriptors back to the hardware now rather than in batches
+void e1000_rx_flush(void);
+
+// Interrupts start masked. The handler calls e1000_irq_ack(), which masks
+// them again if the device was the one interrupting (the line may be
+// shared) and returns the causes; the deferred poll re-enables them once
+// the rings are drained.
+uint32_t e1000_irq_ack(void);
+void e1000_irq_enable(void);
+void e1000_set_itr(uint32_t interrupts_per_sec);
+// Receive checksum validation; also tells the stack whether to ask for
+// transmit checksum insertion (on by default)
+void e1000_set_csum_offload(int on);
+
+// Fold the hardware's clear-on-read drop counters into the device struct
+void e1000_update_stats(void);
 
 #endif
@@ -243,6 +243,63 @@ static void editor_ensure_cursor_visible(void) {
     }
 }
 
+// === Layout ===
+
+// Characters per wrapped row and number of text rows that fit in the window
+static void editor_text_layout(int *max_chars, int *max_rows) {
+    int content_width = win_editor.w - 8;
+    int content_height = win_editor.h - 28;
+    *max_chars = (content_width - 40) / EDITOR_CHAR_WIDTH;
+    if (*max_chars < 1) *max_chars = 1;
+    *max_rows = (content_height - 55) / EDITOR_LINE_HEIGHT;
+}
+
+// Find the next wrapped segment of a line starting at char_idx. Breaks at the
+// last space that fits when the rest of the line is too long. Returns the index
+// the following segment starts at.
+static int editor_wrap_segment(const char *text, int text_len, int char_idx, int max_chars, int *segment_len) {
+    int segment_start = char_idx;
+    int len = text_len - char_idx;
+    if (len > max_chars) len = max_chars;
+    char_idx += len;
+    
+    // Word-based wrapping: find last space if we didn't reach end
+    if (char_idx < text_len && len > 0) {
+        int last_space = -1;
+        for (int i = len - 1; i >= 0; i--) {
+            if (text[segment_start + i] == ' ') {
+                last_space = i;
+                break;
+            }
+        }
+        
+        if (last_space > 0) {
+            len = last_space;
+            char_idx = segment_start + last_space + 1;
+            // Skip additional spaces
+            while (char_idx < text_len && text[char_idx] == ' ') {
+                char_idx++;
+            }
+        }
+    }
+    
+    *segment_len = len;
+    return char_idx;
+}
+
+// Number of display rows a line wraps to
+static int editor_line_rows(int line_idx, int max_chars) {
+    int text_len = lines[line_idx].length;
+    int char_idx = 0;
+    int rows = 0;
+    do {
+        int segment_len;
+        char_idx = editor_wrap_segment(lines[line_idx].content, text_len, char_idx, max_chars, &segment_len);
+        rows++;
+    } while (char_idx < text_len);
+    return rows;
+}
+
 // === Paint Function ===
 
 static void editor_paint(Window *win) {
@@ -323,32 +380,12 @@ static void editor_paint(Window *win) {
             int segment_len = 0;
             int segment_start = char_idx;
             
-            while (char_idx < text_len && segment_len < max_chars_per_line) {
-                segment[segment_len++] = text[char_idx++];
+            char_idx = editor_wrap_segment(text, text_len, char_idx, max_chars_per_line, &segment_len);
+            for (int i = 0; i < segment_len; i++) {
+                segment[i] = text[segment_start + i];
             }
             segment[segment_len] = 0;
             
-            // Word-based wrapping: find last space if we didn't reach end
-            if (char_idx < text_len && segment_len > 0) {
-                int last_space = -1;
-                for (int i = segment_len - 1; i >= 0; i--) {
-                    if (segment[i] == ' ') {
-                        last_space = i;
-                        break;
-                    }
-                }
-                
-                if (last_space > 0) {
-                    segment_len = last_space;
-                    segment[segment_len] = 0;
-                    char_idx = segment_start + last_space + 1;
-                    // Skip additional spaces
-                    while (char_idx < text_len && text[char_idx] == ' ') {
-                        char_idx++;
-                    }
-                }
-            }
-            
             // Draw the text segment
             if (segment_len > 0) {
                 draw_string(text_start_x, current_display_y, segment, COLOR_BLACK);
@@ -418,7 +455,58 @@ static void editor_paint(Window *win) {
 
 // === Key Handler ===
 
-static void editor_handle_key(Window *win, char c) {
+// Mark the rows a line occupies on screen (nothing if it is scrolled out of view)
+static void editor_mark_line_dirty(int line_idx) {
+    int max_chars, max_rows;
+    editor_text_layout(&max_chars, &max_rows);
+    if (line_idx < scroll_top || line_idx >= line_count) return;
+    
+    int row = 0;
+    for (int i = scroll_top; i < line_idx && row < max_rows; i++) {
+        row += editor_line_rows(i, max_chars);
+    }
+    if (row >= max_rows) return;
+    int rows = editor_line_rows(line_idx, max_chars);
+    if (row + rows > max_rows) rows = max_rows - row;
+    
+    wm_mark_dirty(win_editor.x + 4, win_editor.y + 24 + 35 + row * EDITOR_LINE_HEIGHT,
+                  win_editor.w - 8, rows * EDITOR_LINE_HEIGHT);
+}
+
+// Cursor movement only changes the cursor's old and new lines, the status bar,
+// and - when the view scrolls by one line - what the blit uncovers. Everything
+// else repaints the whole window.
+static void editor_mark_changes(char c, int old_scroll, int old_line) {
+    if (!win_editor.visible) return;
+    
+    bool cursor_move = (c == 17 || c == 18 || c == 19 || c == 20);
+    int scrolled = scroll_top - old_scroll;
+    if (!cursor_move || scrolled > 1 || scrolled < -1) {
+        wm_mark_dirty(win_editor.x, win_editor.y, win_editor.w, win_editor.h);
+        return;
+    }
+    
+    if (scrolled != 0) {
+        int max_chars, max_rows;
+        editor_text_layout(&max_chars, &max_rows);
+        int top_line = scrolled > 0 ? old_scroll : scroll_top;
+        int dy = editor_line_rows(top_line, max_chars) * EDITOR_LINE_HEIGHT;
+        if (scrolled > 0) dy = -dy;
+        if (!wm_scroll_window_region(&win_editor, win_editor.x + 4, win_editor.y + 24 + 35,
+                                     win_editor.w - 8, max_rows * EDITOR_LINE_HEIGHT, dy)) {
+            wm_mark_dirty(win_editor.x, win_editor.y, win_editor.w, win_editor.h);
+            return;
+        }
+    }
+    
+    editor_mark_line_dirty(old_line);
+    editor_mark_line_dirty(cursor_line);
+    
+    // Status bar
+    wm_mark_dirty(win_editor.x + 4, win_editor.y + win_editor.h - 24, win_editor.w - 8, 20);
+}
+
+static void editor_process_key(Window *win, char c) {
     if (c == 'q' || c == 'Q') {
         if (file_modified) {
         }
@@ -481,6 +569,13 @@ static void editor_handle_key(Window *win, char c) {
     editor_insert_char(c);
 }
 
+static void editor_handle_key(Window *win, char c) {
+    int old_scroll = scroll_top;
+    int old_line = cursor_line;
+    editor_process_key(win, c);
+    editor_mark_changes(c, old_scroll, old_line);
+}
+
 // === Click Handler ===
 
 static void editor_handle_click(Window *win, int x, int y) {
@@ -510,6 +605,7 @@ void editor_init(void) {
     win_editor.visible = false;
     win_editor.focused = false;
     win_editor.z_index = 0;
+    win_editor.partial_redraw = true;
     win_editor.paint = editor_paint;
     win_editor.handle_key = editor_handle_key;
     win_editor.handle_click = editor_handle_click;
@@ -1,4 +1,6 @@
 #include "fat32.h"
+#include "trace.h"
+#include "wait.h"
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -31,6 +33,13 @@ static FAT32_FileHandle open_handles[MAX_OPEN_HANDLES];
 static char current_dir[FAT32_MAX_PATH] = "/";
 static int desktop_file_limit = -1;
 
+// Shell commands, the UI and the desktop refresh run on different threads, so
+// every public entry point holds fs_lock. Functions here call the unlocked
+// versions of each other.
+static Mutex fs_lock = MUTEX_INIT;
+
+static int list_directory(const char *path, FAT32_FileInfo *entries, int max_entries);
+
 // === Helper Functions ===
 
 static size_t fs_strlen(const char *str) {
@@ -115,7 +124,7 @@ static void extract_parent_path(const char *path, char *parent) {
 }
 
 // Normalize path (remove .., ., etc)
-void fat32_normalize_path(const char *path, char *normalized) {
+static void normalize_path(const char *path, char *normalized) {
     char temp[FAT32_MAX_PATH];
     int temp_len = 0;
 
@@ -178,7 +187,7 @@ void fat32_normalize_path(const char *path, char *normalized) {
 // Find file entry by path
 static FileEntry* find_file(const char *path) {
     char normalized[FAT32_MAX_PATH];
-    fat32_normalize_path(path, normalized);
+    normalize_path(path, normalized);
     
     for (int i = 0; i < MAX_FILES; i++) {
         if (files[i].used && fs_strcmp(files[i].full_path, normalized) == 0) {
@@ -238,7 +247,7 @@ static bool check_desktop_limit(const char *normalized_path) {
         
         // Count files in /Desktop
         FAT32_FileInfo info[256]; // Temp buffer
-        int count = fat32_list_directory("/Desktop", info, 256);
+        int count = list_directory("/Desktop", info, 256);
         if (count >= desktop_file_limit) return false;
     }
     return true;
@@ -275,9 +284,9 @@ void fat32_set_desktop_limit(int limit) {
     desktop_file_limit = limit;
 }
 
-FAT32_FileHandle* fat32_open(const char *path, const char *mode) {
+static FAT32_FileHandle* open_file(const char *path, const char *mode) {
     char normalized[FAT32_MAX_PATH];
-    fat32_normalize_path(path, normalized);
+    normalize_path(path, normalized);
     
     FileEntry *entry = find_file(normalized);
     
@@ -344,13 +353,13 @@ FAT32_FileHandle* fat32_open(const char *path, const char *mode) {
     return handle;
 }
 
-void fat32_close(FAT32_FileHandle *handle) {
+static void close_file(FAT32_FileHandle *handle) {
     if (handle) {
         handle->valid = false;
     }
 }
 
-int fat32_read(FAT32_FileHandle *handle, void *buffer, int size) {
+static int read_file(FAT32_FileHandle *handle, void *buffer, int size) {
     if (!handle || !handle->valid || handle->mode != 0) {
         return -1;
     }
@@ -391,7 +400,7 @@ int fat32_read(FAT32_FileHandle *handle, void *buffer, int size) {
     return bytes_read;
 }
 
-int fat32_write(FAT32_FileHandle *handle, const void *buffer, int size) {
+static int write_file(FAT32_FileHandle *handle, const void *buffer, int size) {
     if (!handle || !handle->valid || (handle->mode != 1 && handle->mode != 2)) {
         return -1;
     }
@@ -454,7 +463,36 @@ int fat32_write(FAT32_FileHandle *handle, const void *buffer, int size) {
     return bytes_written;
 }
 
-int fat32_seek(FAT32_FileHandle *handle, int offset, int whence) {
+// Traced entry points
+
+FAT32_FileHandle* fat32_open(const char *path, const char *mode) {
+    TRACE_BEGIN(TRACE_CAT_FS, "fat32_open", 0);
+    mutex_lock(&fs_lock);
+    FAT32_FileHandle *handle = open_file(path, mode);
+    mutex_unlock(&fs_lock);
+    TRACE_END(TRACE_CAT_FS, "fat32_open", handle != NULL);
+    return handle;
+}
+
+int fat32_read(FAT32_FileHandle *handle, void *buffer, int size) {
+    TRACE_BEGIN(TRACE_CAT_FS, "fat32_read", size);
+    mutex_lock(&fs_lock);
+    int n = read_file(handle, buffer, size);
+    mutex_unlock(&fs_lock);
+    TRACE_END(TRACE_CAT_FS, "fat32_read", n);
+    return n;
+}
+
+int fat32_write(FAT32_FileHandle *handle, const void *buffer, int size) {
+    TRACE_BEGIN(TRACE_CAT_FS, "fat32_write", size);
+    mutex_lock(&fs_lock);
+    int n = write_file(handle, buffer, size);
+    mutex_unlock(&fs_lock);
+    TRACE_END(TRACE_CAT_FS, "fat32_write", n);
+    return n;
+}
+
+static int seek_file(FAT32_FileHandle *handle, int offset, int whence) {
     if (!handle || !handle->valid) {
         return -1;
     }
@@ -477,9 +515,9 @@ int fat32_seek(FAT32_FileHandle *handle, int offset, int whence) {
     return new_position;
 }
 
-bool fat32_mkdir(const char *path) {
+static bool make_dir(const char *path) {
     char normalized[FAT32_MAX_PATH];
-    fat32_normalize_path(path, normalized);
+    normalize_path(path, normalized);
     
     if (find_file(normalized)) {
         return false;  // Already exists
@@ -503,9 +541,9 @@ bool fat32_mkdir(const char *path) {
     return true;
 }
 
-bool fat32_rmdir(const char *path) {
+static bool remove_dir(const char *path) {
     char normalized[FAT32_MAX_PATH];
-    fat32_normalize_path(path, normalized);
+    normalize_path(path, normalized);
     
     FileEntry *entry = find_file(normalized);
     if (!entry || !(entry->attributes & ATTR_DIRECTORY)) {
@@ -516,9 +554,9 @@ bool fat32_rmdir(const char *path) {
     return true;
 }
 
-bool fat32_delete(const char *path) {
+static bool delete_file(const char *path) {
     char normalized[FAT32_MAX_PATH];
-    fat32_normalize_path(path, normalized);
+    normalize_path(path, normalized);
     
     FileEntry *entry = find_file(normalized);
     if (!entry || (entry->attributes & ATTR_DIRECTORY)) {
@@ -529,11 +567,11 @@ bool fat32_delete(const char *path) {
     return true;
 }
 
-bool fat32_exists(const char *path) {
+static bool file_exists(const char *path) {
     return find_file(path) != NULL;
 }
 
-bool fat32_rename(const char *old_path, const char *new_path) {
+static bool rename_file(const char *old_path, const char *new_path) {
     FileEntry *entry = find_file(old_path);
     if (!entry) return false;
     if (find_file(new_path)) return false; // Destination exists
@@ -575,14 +613,14 @@ bool fat32_rename(const char *old_path, const char *new_path) {
     return true;
 }
 
-bool fat32_is_directory(const char *path) {
+static bool is_directory(const char *path) {
     FileEntry *entry = find_file(path);
     return entry && (entry->attributes & ATTR_DIRECTORY);
 }
 
-int fat32_list_directory(const char *path, FAT32_FileInfo *entries, int max_entries) {
+static int list_directory(const char *path, FAT32_FileInfo *entries, int max_entries) {
     char normalized[FAT32_MAX_PATH];
-    fat32_normalize_path(path, normalized);
+    normalize_path(path, normalized);
     
     FileEntry *dir = find_file(normalized);
     if (!dir || !(dir->attributes & ATTR_DIRECTORY)) {
@@ -603,9 +641,9 @@ int fat32_list_directory(const char *path, FAT32_FileInfo *entries, int max_entr
     return count;
 }
 
-bool fat32_chdir(const char *path) {
+static bool change_dir(const char *path) {
     char normalized[FAT32_MAX_PATH];
-    fat32_normalize_path(path, normalized);
+    normalize_path(path, normalized);
     
     FileEntry *entry = find_file(normalized);
     if (!entry || !(entry->attributes & ATTR_DIRECTORY)) {
@@ -616,7 +654,7 @@ bool fat32_chdir(const char *path) {
     return true;
 }
 
-void fat32_get_current_dir(char *buffer, int size) {
+static void get_current_dir(char *buffer, int size) {
     int len = fs_strlen(current_dir);
     if (len >= size) len = size - 1;
     
@@ -625,3 +663,86 @@ void fat32_get_current_dir(char *buffer, int size) {
     }
     buffer[len] = 0;
 }
+
+// Locked entry points
+
+void fat32_normalize_path(const char *path, char *normalized) {
+    mutex_lock(&fs_lock);
+    normalize_path(path, normalized);
+    mutex_unlock(&fs_lock);
+}
+
+void fat32_close(FAT32_FileHandle *handle) {
+    mutex_lock(&fs_lock);
+    close_file(handle);
+    mutex_unlock(&fs_lock);
+}
+
+int fat32_seek(FAT32_FileHandle *handle, int offset, int whence) {
+    mutex_lock(&fs_lock);
+    int position = seek_file(handle, offset, whence);
+    mutex_unlock(&fs_lock);
+    return position;
+}
+
+bool fat32_mkdir(const char *path) {
+    mutex_lock(&fs_lock);
+    bool ok = make_dir(path);
+    mutex_unlock(&fs_lock);
+    return ok;
+}
+
+bool fat32_rmdir(const char *path) {
+    mutex_lock(&fs_lock);
+    bool ok = remove_dir(path);
+    mutex_unlock(&fs_lock);
+    return ok;
+}
+
+bool fat32_delete(const char *path) {
+    mutex_lock(&fs_lock);
+    bool ok = delete_file(path);
+    mutex_unlock(&fs_lock);
+    return ok;
+}
+
+bool fat32_exists(const char *path) {
+    mutex_lock(&fs_lock);
+    bool ok = file_exists(path);
+    mutex_unlock(&fs_lock);
+    return ok;
+}
+
+bool fat32_rename(const char *old_path, const char *new_path) {
+    mutex_lock(&fs_lock);
+    bool ok = rename_file(old_path, new_path);
+    mutex_unlock(&fs_lock);
+    return ok;
+}
+
+bool fat32_is_directory(const char *path) {
+    mutex_lock(&fs_lock);
+    bool ok = is_directory(path);
+    mutex_unlock(&fs_lock);
+    return ok;
+}
+
+int fat32_list_directory(const char *path, FAT32_FileInfo *entries, int max_entries) {
+    mutex_lock(&fs_lock);
+    int count = list_directory(path, entries, max_entries);
+    mutex_unlock(&fs_lock);
+    return count;
+}
+
+bool fat32_chdir(const char *path) {
+    mutex_lock(&fs_lock);
+    bool ok = change_dir(path);
+    mutex_unlock(&fs_lock);
+    return ok;
+}
+
+void fat32_get_current_dir(char *buffer, int size) {
+    mutex_lock(&fs_lock);
+    get_current_dir(buffer, size);
+    mutex_unlock(&fs_lock);
+}
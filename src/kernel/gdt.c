@@ -0,0 +1,49 @@
+#include "gdt.h"
+
+struct gdt_ptr {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed));
+
+void gdt_init_cpu(Gdt *gdt, Tss *tss, uint64_t stack_top) {
+    uint8_t *t = (uint8_t *)tss;
+    for (unsigned i = 0; i < sizeof(Tss); i++) t[i] = 0;
+    tss->rsp[0] = stack_top;
+    tss->iomap_base = sizeof(Tss);      // No I/O permission bitmap
+
+    uint64_t base = (uint64_t)tss;
+    uint64_t limit = sizeof(Tss) - 1;
+
+    gdt->entries[0] = 0;
+    gdt->entries[1] = 0x00AF9A000000FFFFULL;   // 64-bit code, DPL 0
+    gdt->entries[2] = 0x00CF92000000FFFFULL;   // Data, DPL 0
+    gdt->entries[3] = (limit & 0xFFFF) |
+                      ((base & 0xFFFFFF) << 16) |
+                      (0x89ULL << 40) |        // Present, 64-bit available TSS
+                      (((limit >> 16) & 0xF) << 48) |
+                      (((base >> 24) & 0xFF) << 56);
+    gdt->entries[4] = base >> 32;
+
+    struct gdt_ptr ptr;
+    ptr.limit = sizeof(Gdt) - 1;
+    ptr.base = (uint64_t)gdt;
+    asm volatile ("lgdt %0" : : "m"(ptr));
+
+    // Far return to reload CS, then the data segments
+    asm volatile (
+        "pushq %0\n\t"
+        "leaq 1f(%%rip), %%rax\n\t"
+        "pushq %%rax\n\t"
+        "lretq\n"
+        "1:\n\t"
+        "movw %1, %%ax\n\t"
+        "movw %%ax, %%ds\n\t"
+        "movw %%ax, %%es\n\t"
+        "movw %%ax, %%ss\n\t"
+        "xorl %%eax, %%eax\n\t"
+        "movw %%ax, %%fs\n\t"
+        "movw %%ax, %%gs\n\t"
+        : : "i"((uint64_t)GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA) : "rax", "memory");
+
+    asm volatile ("ltr %w0" : : "r"((uint16_t)GDT_TSS));
+}
@@ -0,0 +1,32 @@
+#ifndef GDT_H
+#define GDT_H
+
+#include <stdint.h>
+
+// Each CPU gets its own GDT and TSS (the TSS can't be shared: loading it
+// marks its descriptor busy).
+
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_TSS         0x18
+#define GDT_ENTRIES     5       // Null, code, data, TSS (two slots)
+
+typedef struct {
+    uint32_t reserved0;
+    uint64_t rsp[3];
+    uint64_t reserved1;
+    uint64_t ist[7];
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;
+} __attribute__((packed)) Tss;
+
+typedef struct {
+    uint64_t entries[GDT_ENTRIES];
+} __attribute__((aligned(8))) Gdt;
+
+// Fill in and load gdt/tss on the calling CPU and reload the segment
+// registers. Loading GS clears the GS base, so set it up afterwards.
+void gdt_init_cpu(Gdt *gdt, Tss *tss, uint64_t stack_top);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stddef.h>
 #include "graphics.h"
 #include "font.h"
+#include "io.h"
 
 static struct limine_framebuffer *g_fb = NULL;
 static uint32_t g_bg_color = 0xFF696969;  // Dark gray background
@@ -10,8 +11,19 @@ static uint32_t g_bg_color = 0xFF696969;  // Dark gray background
 static uint32_t g_bg_pattern[PATTERN_SIZE * PATTERN_SIZE];
 static bool g_use_pattern = false;
 
-// Dirty rectangle tracking
-static DirtyRect g_dirty = {0, 0, 0, 0, false};
+// Dirty rectangle tracking - a short list of disjoint regions, so a change in
+// one corner and another in the opposite corner don't repaint everything between
+static DirtyRect g_dirty[GRAPHICS_MAX_DIRTY_RECTS];
+static int g_dirty_count = 0;
+// Back buffer regions that are up to date but not on screen yet (moved there
+// by graphics_copy_rect): flipped without being repainted
+static DirtyRect g_flip[GRAPHICS_MAX_DIRTY_RECTS];
+static int g_flip_count = 0;
+static void (*g_dirty_callback)(void) = NULL;
+
+// Pixel counters for the performance HUD (monotonic, never reset)
+static uint64_t g_pixels_written = 0;
+static uint64_t g_pixels_flipped = 0;
 
 // Double buffering - allocate a back buffer
 // Max screen size: 2048x2048 @ 32bpp = 16MB, but allocate for common sizes
@@ -20,13 +32,28 @@ static DirtyRect g_dirty = {0, 0, 0, 0, false};
 #define MAX_FB_HEIGHT 2048
 static uint32_t g_back_buffer[MAX_FB_WIDTH * MAX_FB_HEIGHT] __attribute__((aligned(4096)));
 
-// Clipping state
+// Clipping state. The effective clip is the intersection of the frame clip
+// (set by the window manager while repainting one dirty region) and the clip
+// an app sets for its own content.
 static int g_clip_x = 0, g_clip_y = 0, g_clip_w = 0, g_clip_h = 0;
 static bool g_clip_enabled = false;
+static int g_app_clip_x = 0, g_app_clip_y = 0, g_app_clip_w = 0, g_app_clip_h = 0;
+static bool g_app_clip_enabled = false;
+static int g_frame_clip_x = 0, g_frame_clip_y = 0, g_frame_clip_w = 0, g_frame_clip_h = 0;
+static bool g_frame_clip_enabled = false;
+
+// Render target - the back buffer, or an offscreen bitmap while one is bound
+static uint32_t *g_target = g_back_buffer;
+static int g_target_w = 0, g_target_h = 0;
+static bool g_offscreen = false;
+static bool g_saved_clip_enabled = false;
 
 void graphics_init(struct limine_framebuffer *fb) {
     g_fb = fb;
-    g_dirty.active = false;
+    g_target = g_back_buffer;
+    g_target_w = fb->width;
+    g_target_h = fb->height;
+    g_dirty_count = 0;
     // Initialize back buffer to black
     for (int i = 0; i < MAX_FB_WIDTH * MAX_FB_HEIGHT; i++) {
         g_back_buffer[i] = 0;
@@ -41,74 +68,168 @@ int get_screen_height(void) {
     return g_fb ? g_fb->height : 0;
 }
 
-// Merge new dirty rect with existing one
-static void merge_dirty_rect(int x, int y, int w, int h) {
-    if (!g_dirty.active) {
-        g_dirty.x = x;
-        g_dirty.y = y;
-        g_dirty.w = w;
-        g_dirty.h = h;
-        g_dirty.active = true;
-    } else {
-        // Calculate union of two rectangles
-        int x1 = g_dirty.x;
-        int y1 = g_dirty.y;
-        int x2 = g_dirty.x + g_dirty.w;
-        int y2 = g_dirty.y + g_dirty.h;
-        
-        int new_x1 = x;
-        int new_y1 = y;
-        int new_x2 = x + w;
-        int new_y2 = y + h;
-        
-        g_dirty.x = new_x1 < x1 ? new_x1 : x1;
-        g_dirty.y = new_y1 < y1 ? new_y1 : y1;
-        g_dirty.w = (new_x2 > x2 ? new_x2 : x2) - g_dirty.x;
-        g_dirty.h = (new_y2 > y2 ? new_y2 : y2) - g_dirty.y;
-    }
+// Merge new dirty rect into the list. Rects that touch or overlap an existing
+// entry are folded into it; when the list is full the new rect is folded into
+// whichever entry grows the least, so the list never loses coverage.
+static bool rects_touch(const DirtyRect *a, int x, int y, int w, int h) {
+    return x <= a->x + a->w && a->x <= x + w &&
+           y <= a->y + a->h && a->y <= y + h;
 }
 
-void graphics_mark_dirty(int x, int y, int w, int h) {
-    // Clamp to screen bounds
-    if (x < 0) {
-        w += x;
-        x = 0;
-    }
-    if (y < 0) {
-        h += y;
-        y = 0;
+static void union_into(DirtyRect *a, int x, int y, int w, int h) {
+    int x2 = a->x + a->w > x + w ? a->x + a->w : x + w;
+    int y2 = a->y + a->h > y + h ? a->y + a->h : y + h;
+    if (x < a->x) a->x = x;
+    if (y < a->y) a->y = y;
+    a->w = x2 - a->x;
+    a->h = y2 - a->y;
+}
+
+static void merge_rect(DirtyRect *list, int *count, int x, int y, int w, int h) {
+    for (int i = 0; i < *count; i++) {
+        if (!rects_touch(&list[i], x, y, w, h)) continue;
+        union_into(&list[i], x, y, w, h);
+        
+        // The grown rect may now touch others - fold them in too
+        bool folded = true;
+        while (folded) {
+            folded = false;
+            for (int j = 0; j < *count; j++) {
+                DirtyRect o = list[j];
+                if (j == i || !rects_touch(&list[i], o.x, o.y, o.w, o.h)) continue;
+                union_into(&list[i], o.x, o.y, o.w, o.h);
+                list[j] = list[--(*count)];
+                if (i == *count) i = j;  // our rect was the one moved
+                folded = true;
+                break;
+            }
+        }
+        return;
     }
-    if (x + w > get_screen_width()) {
-        w = get_screen_width() - x;
+    
+    if (*count < GRAPHICS_MAX_DIRTY_RECTS) {
+        list[*count].x = x;
+        list[*count].y = y;
+        list[*count].w = w;
+        list[*count].h = h;
+        list[*count].active = true;
+        (*count)++;
+        return;
     }
-    if (y + h > get_screen_height()) {
-        h = get_screen_height() - y;
+    
+    int best = 0;
+    long best_growth = -1;
+    for (int i = 0; i < *count; i++) {
+        DirtyRect u = list[i];
+        union_into(&u, x, y, w, h);
+        long growth = (long)u.w * u.h - (long)list[i].w * list[i].h;
+        if (best_growth < 0 || growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
     }
+    union_into(&list[best], x, y, w, h);
+}
+
+static bool clamp_to_screen(int *x, int *y, int *w, int *h) {
+    if (*x < 0) { *w += *x; *x = 0; }
+    if (*y < 0) { *h += *y; *y = 0; }
+    if (*x + *w > get_screen_width()) *w = get_screen_width() - *x;
+    if (*y + *h > get_screen_height()) *h = get_screen_height() - *y;
+    return *w > 0 && *h > 0;
+}
+
+void graphics_mark_dirty(int x, int y, int w, int h) {
+    if (!clamp_to_screen(&x, &y, &w, &h)) return;
     
-    if (w <= 0 || h <= 0) return;
+    // The list is shared with the timer interrupt that repaints it
+    uint64_t flags = irq_save();
+    merge_rect(g_dirty, &g_dirty_count, x, y, w, h);
+    irq_restore(flags);
+    
+    if (g_dirty_callback) g_dirty_callback();
+}
+
+void graphics_mark_flip(int x, int y, int w, int h) {
+    if (!clamp_to_screen(&x, &y, &w, &h)) return;
+    uint64_t flags = irq_save();
+    merge_rect(g_flip, &g_flip_count, x, y, w, h);
+    irq_restore(flags);
     
-    merge_dirty_rect(x, y, w, h);
+    if (g_dirty_callback) g_dirty_callback();
 }
 
 void graphics_mark_screen_dirty(void) {
-    g_dirty.x = 0;
-    g_dirty.y = 0;
-    g_dirty.w = get_screen_width();
-    g_dirty.h = get_screen_height();
-    g_dirty.active = true;
+    g_dirty[0].x = 0;
+    g_dirty[0].y = 0;
+    g_dirty[0].w = get_screen_width();
+    g_dirty[0].h = get_screen_height();
+    g_dirty[0].active = true;
+    g_dirty_count = 1;
+    
+    if (g_dirty_callback) g_dirty_callback();
+}
+
+void graphics_set_dirty_callback(void (*callback)(void)) {
+    g_dirty_callback = callback;
 }
 
+// Bounding box of everything that is dirty
 DirtyRect graphics_get_dirty_rect(void) {
-    return g_dirty;
+    DirtyRect r = {0, 0, 0, 0, false};
+    for (int i = 0; i < g_dirty_count; i++) {
+        if (!r.active) {
+            r = g_dirty[i];
+        } else {
+            union_into(&r, g_dirty[i].x, g_dirty[i].y, g_dirty[i].w, g_dirty[i].h);
+        }
+    }
+    return r;
+}
+
+int graphics_get_dirty_rects(DirtyRect *out, int max) {
+    int n = g_dirty_count < max ? g_dirty_count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = g_dirty[i];
+    }
+    return n;
 }
 
 void graphics_clear_dirty(void) {
-    g_dirty.active = false;
+    g_dirty_count = 0;
+}
+
+int graphics_get_flip_rects(DirtyRect *out, int max) {
+    int n = g_flip_count < max ? g_flip_count : max;
+    for (int i = 0; i < n; i++) {
+        out[i] = g_flip[i];
+    }
+    return n;
+}
+
+void graphics_clear_flip(void) {
+    g_flip_count = 0;
+}
+
+// Clip a box (x1,y1)-(x2,y2) against the render target and the clipping
+// rectangle. Returns false if nothing is left.
+static bool clip_box(int *x1, int *y1, int *x2, int *y2) {
+    if (*x1 < 0) *x1 = 0;
+    if (*y1 < 0) *y1 = 0;
+    if (*x2 > g_target_w) *x2 = g_target_w;
+    if (*y2 > g_target_h) *y2 = g_target_h;
+    if (g_clip_enabled) {
+        if (*x1 < g_clip_x) *x1 = g_clip_x;
+        if (*y1 < g_clip_y) *y1 = g_clip_y;
+        if (*x2 > g_clip_x + g_clip_w) *x2 = g_clip_x + g_clip_w;
+        if (*y2 > g_clip_y + g_clip_h) *y2 = g_clip_y + g_clip_h;
+    }
+    return *x1 < *x2 && *y1 < *y2;
 }
 
 void put_pixel(int x, int y, uint32_t color) {
     if (!g_fb) return;
-    if (x < 0 || x >= (int)g_fb->width || y < 0 || y >= (int)g_fb->height) return;
+    if (x < 0 || x >= g_target_w || y < 0 || y >= g_target_h) return;
     
     if (g_clip_enabled) {
         if (x < g_clip_x || x >= g_clip_x + g_clip_w ||
@@ -117,15 +238,22 @@ void put_pixel(int x, int y, uint32_t color) {
         }
     }
     
-    // Draw to back buffer
-    uint32_t pixel_offset = y * g_fb->width + x;
-    g_back_buffer[pixel_offset] = color;
+    // Draw to back buffer (or the bound offscreen bitmap)
+    g_pixels_written++;
+    uint32_t pixel_offset = y * g_target_w + x;
+    g_target[pixel_offset] = color;
 }
 
 void draw_rect(int x, int y, int w, int h, uint32_t color) {
-    for (int i = 0; i < h; i++) {
-        for (int j = 0; j < w; j++) {
-            put_pixel(x + j, y + i, color);
+    if (!g_fb) return;
+    int x1 = x, y1 = y, x2 = x + w, y2 = y + h;
+    if (!clip_box(&x1, &y1, &x2, &y2)) return;
+    g_pixels_written += (uint64_t)(x2 - x1) * (y2 - y1);
+    
+    for (int row = y1; row < y2; row++) {
+        uint32_t *dst = g_target + row * g_target_w + x1;
+        for (int col = x1; col < x2; col++) {
+            *dst++ = color;
         }
     }
 }
@@ -134,6 +262,14 @@ void draw_char(int x, int y, char c, uint32_t color) {
     unsigned char uc = (unsigned char)c;
     if (uc > 127) return;
     const uint8_t *glyph = font8x8_basic[uc];
+    
+    // Most text lies outside the region being repainted - skip it cheaply
+    if (g_clip_enabled) {
+        if (x + 8 <= g_clip_x || x >= g_clip_x + g_clip_w ||
+            y + 8 <= g_clip_y || y >= g_clip_y + g_clip_h) {
+            return;
+        }
+    }
 
     for (int row = 0; row < 8; row++) {
         for (int col = 0; col < 8; col++) {
@@ -163,13 +299,15 @@ void draw_desktop_background(void) {
     if (!g_fb) return;
     
     if (g_use_pattern) {
-        // Draw tiled pattern
-        for (int y = 0; y < (int)g_fb->height; y++) {
-            for (int x = 0; x < (int)g_fb->width; x++) {
-                int px = x % PATTERN_SIZE;
-                int py = y % PATTERN_SIZE;
-                uint32_t color = g_bg_pattern[py * PATTERN_SIZE + px];
-                put_pixel(x, y, color);
+        // Draw tiled pattern (only the part inside the clip)
+        int x1 = 0, y1 = 0, x2 = g_fb->width, y2 = g_fb->height;
+        if (!clip_box(&x1, &y1, &x2, &y2)) return;
+        g_pixels_written += (uint64_t)(x2 - x1) * (y2 - y1);
+        for (int y = y1; y < y2; y++) {
+            const uint32_t *pattern_row = g_bg_pattern + (y % PATTERN_SIZE) * PATTERN_SIZE;
+            uint32_t *dst = g_target + y * g_target_w + x1;
+            for (int x = x1; x < x2; x++) {
+                *dst++ = pattern_row[x % PATTERN_SIZE];
             }
         }
     } else {
@@ -206,6 +344,7 @@ void graphics_flip_buffer(void) {
     if (!g_fb) return;
     
     // Copy back buffer to framebuffer
+    g_pixels_flipped += (uint64_t)g_fb->width * g_fb->height;
     uint32_t *src = g_back_buffer;
     uint8_t *dst = (uint8_t *)g_fb->address;
     
@@ -220,14 +359,205 @@ void graphics_flip_buffer(void) {
     }
 }
 
+// Copy just one rectangle of the back buffer to the framebuffer
+void graphics_flip_rect(int x, int y, int w, int h) {
+    if (!g_fb) return;
+    int x1 = x < 0 ? 0 : x;
+    int y1 = y < 0 ? 0 : y;
+    int x2 = x + w > (int)g_fb->width ? (int)g_fb->width : x + w;
+    int y2 = y + h > (int)g_fb->height ? (int)g_fb->height : y + h;
+    if (x1 >= x2 || y1 >= y2) return;
+    g_pixels_flipped += (uint64_t)(x2 - x1) * (y2 - y1);
+    
+    for (int row = y1; row < y2; row++) {
+        uint32_t *src = g_back_buffer + row * g_fb->width;
+        uint32_t *dst_row = (uint32_t *)((uint8_t *)g_fb->address + row * g_fb->pitch);
+        for (int col = x1; col < x2; col++) {
+            dst_row[col] = src[col];
+        }
+    }
+}
+
+// Move a rectangle of pixels within the back buffer. Source and destination
+// may overlap (rows and columns are walked in whichever direction keeps the
+// source intact). Anything already dirty inside the source moves with it, so
+// the destination still gets repainted where the copied pixels were stale;
+// the rest of the destination is queued to be flipped as it is.
+void graphics_copy_rect(int src_x, int src_y, int w, int h, int dst_x, int dst_y) {
+    if (!g_fb) return;
+    int sw = g_fb->width;
+    int sh = g_fb->height;
+    
+    // Trim the rectangle until both source and destination are on-screen
+    int lo_x = src_x < dst_x ? src_x : dst_x;
+    int lo_y = src_y < dst_y ? src_y : dst_y;
+    if (lo_x < 0) { src_x -= lo_x; dst_x -= lo_x; w += lo_x; }
+    if (lo_y < 0) { src_y -= lo_y; dst_y -= lo_y; h += lo_y; }
+    int hi_x = src_x > dst_x ? src_x : dst_x;
+    int hi_y = src_y > dst_y ? src_y : dst_y;
+    if (hi_x + w > sw) w = sw - hi_x;
+    if (hi_y + h > sh) h = sh - hi_y;
+    if (w <= 0 || h <= 0) return;
+    if (src_x == dst_x && src_y == dst_y) return;
+    g_pixels_written += (uint64_t)w * h;
+    
+    bool bottom_up = dst_y > src_y;
+    bool right_to_left = dst_y == src_y && dst_x > src_x;
+    for (int i = 0; i < h; i++) {
+        int row = bottom_up ? h - 1 - i : i;
+        uint32_t *src = g_back_buffer + (src_y + row) * sw + src_x;
+        uint32_t *dst = g_back_buffer + (dst_y + row) * sw + dst_x;
+        if (right_to_left) {
+            for (int col = w - 1; col >= 0; col--) dst[col] = src[col];
+        } else {
+            for (int col = 0; col < w; col++) dst[col] = src[col];
+        }
+    }
+    
+    int dx = dst_x - src_x;
+    int dy = dst_y - src_y;
+    int n = g_dirty_count;
+    DirtyRect moved[GRAPHICS_MAX_DIRTY_RECTS];
+    int moved_count = 0;
+    for (int i = 0; i < n; i++) {
+        int x1 = g_dirty[i].x > src_x ? g_dirty[i].x : src_x;
+        int y1 = g_dirty[i].y > src_y ? g_dirty[i].y : src_y;
+        int x2 = g_dirty[i].x + g_dirty[i].w < src_x + w ? g_dirty[i].x + g_dirty[i].w : src_x + w;
+        int y2 = g_dirty[i].y + g_dirty[i].h < src_y + h ? g_dirty[i].y + g_dirty[i].h : src_y + h;
+        if (x1 >= x2 || y1 >= y2) continue;
+        moved[moved_count].x = x1 + dx;
+        moved[moved_count].y = y1 + dy;
+        moved[moved_count].w = x2 - x1;
+        moved[moved_count].h = y2 - y1;
+        moved_count++;
+    }
+    for (int i = 0; i < moved_count; i++) {
+        graphics_mark_dirty(moved[i].x, moved[i].y, moved[i].w, moved[i].h);
+    }
+    // The moved pixels are current in the back buffer; they only need to
+    // reach the screen
+    graphics_mark_flip(dst_x, dst_y, w, h);
+}
+
+int graphics_count_stale_pixels(int x, int y, int w, int h) {
+    if (!g_fb || !clamp_to_screen(&x, &y, &w, &h)) return 0;
+    int stale = 0;
+    for (int row = y; row < y + h; row++) {
+        uint32_t *src = g_back_buffer + row * g_fb->width;
+        uint32_t *dst_row = (uint32_t *)((uint8_t *)g_fb->address + row * g_fb->pitch);
+        for (int col = x; col < x + w; col++) {
+            if (dst_row[col] != src[col]) stale++;
+        }
+    }
+    return stale;
+}
+
+// Offscreen rendering - redirect all drawing into a w*h bitmap.
+// The bitmap is cleared to fully transparent (alpha 0) first, so anything
+// drawn with an opaque color becomes part of the mask used by the blit below.
+void graphics_begin_offscreen(uint32_t *pixels, int w, int h) {
+    if (!g_fb || !pixels || g_offscreen) return;
+    for (int i = 0; i < w * h; i++) {
+        pixels[i] = 0;
+    }
+    g_target = pixels;
+    g_target_w = w;
+    g_target_h = h;
+    g_saved_clip_enabled = g_clip_enabled;
+    g_clip_enabled = false;
+    g_offscreen = true;
+}
+
+void graphics_end_offscreen(void) {
+    if (!g_offscreen) return;
+    g_target = g_back_buffer;
+    g_target_w = g_fb->width;
+    g_target_h = g_fb->height;
+    g_clip_enabled = g_saved_clip_enabled;
+    g_offscreen = false;
+}
+
+// Copy a cached bitmap to the back buffer, skipping pixels whose alpha is 0
+void graphics_blit_masked(int x, int y, int w, int h, const uint32_t *pixels) {
+    if (!g_fb || !pixels) return;
+    
+    // Clip the destination against the target and the clipping rectangle once,
+    // instead of per pixel
+    int x1 = x, y1 = y, x2 = x + w, y2 = y + h;
+    if (!clip_box(&x1, &y1, &x2, &y2)) return;
+    g_pixels_written += (uint64_t)(x2 - x1) * (y2 - y1);
+    
+    for (int row = y1; row < y2; row++) {
+        const uint32_t *src = pixels + (row - y) * w + (x1 - x);
+        uint32_t *dst = g_target + row * g_target_w + x1;
+        for (int col = x1; col < x2; col++) {
+            uint32_t p = *src++;
+            if (p >> 24) *dst = p;
+            dst++;
+        }
+    }
+}
+
+// Recompute the effective clip from the frame clip and the app clip
+static void update_clip(void) {
+    if (g_frame_clip_enabled && g_app_clip_enabled) {
+        int x1 = g_app_clip_x > g_frame_clip_x ? g_app_clip_x : g_frame_clip_x;
+        int y1 = g_app_clip_y > g_frame_clip_y ? g_app_clip_y : g_frame_clip_y;
+        int x2 = g_app_clip_x + g_app_clip_w < g_frame_clip_x + g_frame_clip_w ?
+                 g_app_clip_x + g_app_clip_w : g_frame_clip_x + g_frame_clip_w;
+        int y2 = g_app_clip_y + g_app_clip_h < g_frame_clip_y + g_frame_clip_h ?
+                 g_app_clip_y + g_app_clip_h : g_frame_clip_y + g_frame_clip_h;
+        g_clip_x = x1;
+        g_clip_y = y1;
+        g_clip_w = x2 > x1 ? x2 - x1 : 0;
+        g_clip_h = y2 > y1 ? y2 - y1 : 0;
+        g_clip_enabled = true;
+    } else if (g_frame_clip_enabled) {
+        g_clip_x = g_frame_clip_x;
+        g_clip_y = g_frame_clip_y;
+        g_clip_w = g_frame_clip_w;
+        g_clip_h = g_frame_clip_h;
+        g_clip_enabled = true;
+    } else if (g_app_clip_enabled) {
+        g_clip_x = g_app_clip_x;
+        g_clip_y = g_app_clip_y;
+        g_clip_w = g_app_clip_w;
+        g_clip_h = g_app_clip_h;
+        g_clip_enabled = true;
+    } else {
+        g_clip_enabled = false;
+    }
+}
+
+void graphics_get_pixel_counts(uint64_t *written, uint64_t *flipped) {
+    *written = g_pixels_written;
+    *flipped = g_pixels_flipped;
+}
+
 void graphics_set_clipping(int x, int y, int w, int h) {
-    g_clip_x = x;
-    g_clip_y = y;
-    g_clip_w = w;
-    g_clip_h = h;
-    g_clip_enabled = true;
+    g_app_clip_x = x;
+    g_app_clip_y = y;
+    g_app_clip_w = w;
+    g_app_clip_h = h;
+    g_app_clip_enabled = true;
+    update_clip();
 }
 
 void graphics_clear_clipping(void) {
-    g_clip_enabled = false;
+    g_app_clip_enabled = false;
+    update_clip();
+}
+
+void graphics_set_frame_clip(int x, int y, int w, int h) {
+    g_frame_clip_x = x;
+    g_frame_clip_y = y;
+    g_frame_clip_w = w;
+    g_frame_clip_h = h;
+    g_frame_clip_enabled = true;
+    update_clip();
+}
+
+void graphics_clear_frame_clip(void) {
+    g_frame_clip_enabled = false;
+    update_clip();
 }
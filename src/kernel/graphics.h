@@ -11,6 +11,8 @@ typedef struct {
     bool active;
 } DirtyRect;
 
+#define GRAPHICS_MAX_DIRTY_RECTS 16
+
 void graphics_init(struct limine_framebuffer *fb);
 void put_pixel(int x, int y, uint32_t color);
 void draw_rect(int x, int y, int w, int h, uint32_t color);
@@ -27,15 +29,35 @@ int get_screen_height(void);
 // Dirty rectangle management
 void graphics_mark_dirty(int x, int y, int w, int h);
 void graphics_mark_screen_dirty(void);
-DirtyRect graphics_get_dirty_rect(void);
+DirtyRect graphics_get_dirty_rect(void);          // Bounding box of all dirty regions
+int graphics_get_dirty_rects(DirtyRect *out, int max);
 void graphics_clear_dirty(void);
+void graphics_set_dirty_callback(void (*callback)(void));  // Called whenever something is marked dirty
+// Regions to copy to the screen without repainting (see graphics_copy_rect)
+void graphics_mark_flip(int x, int y, int w, int h);
+int graphics_get_flip_rects(DirtyRect *out, int max);
+void graphics_clear_flip(void);
 
 // Double buffering
 void graphics_flip_buffer(void);
 void graphics_clear_back_buffer(uint32_t color);
+void graphics_flip_rect(int x, int y, int w, int h);
+void graphics_copy_rect(int src_x, int src_y, int w, int h, int dst_x, int dst_y);  // Overlap-safe
+// Pixels in a region where the screen differs from the back buffer (wmbench)
+int graphics_count_stale_pixels(int x, int y, int w, int h);
+
+// Running totals of pixels drawn to the back buffer and copied to the screen
+void graphics_get_pixel_counts(uint64_t *written, uint64_t *flipped);
+
+// Offscreen bitmaps (alpha 0 = transparent)
+void graphics_begin_offscreen(uint32_t *pixels, int w, int h);
+void graphics_end_offscreen(void);
+void graphics_blit_masked(int x, int y, int w, int h, const uint32_t *pixels);
 
 // Clipping
 void graphics_set_clipping(int x, int y, int w, int h);
 void graphics_clear_clipping(void);
+void graphics_set_frame_clip(int x, int y, int w, int h);  // Window manager: region being repainted
+void graphics_clear_frame_clip(void);
 
 #endif
@@ -1,6 +1,8 @@
 #include "net_defs.h"
 #include "cmd.h"
 
+#define HTTP_RESPONSE_WAIT_MS 3000      // Without any data arriving
+
 void cli_cmd_httpget(char *args) {
     if (!args || !*args) {
         cmd_write("Usage: httpget <hostname>\n");
@@ -35,19 +37,26 @@ void cli_cmd_httpget(char *args) {
     tcp_send(sock, "\r\nConnection: close\r\n\r\n", 0);
     
     cmd_write("Waiting for response...\n");
-    // Wait for data (simple delay loop for demo)
-    for(volatile int i=0; i<200000000; i++) {
-        extern void network_process_frames(void);
-        network_process_frames();
+    // We asked for Connection: close, so the server's FIN ends the response.
+    // Everything is read as it arrives; the first part is shown.
+    char buf[1024];
+    int shown = 0;
+    uint32_t total = 0;
+    for (;;) {
+        char chunk[512];
+        int len = tcp_recv(sock, chunk, sizeof(chunk), HTTP_RESPONSE_WAIT_MS);
+        if (len <= 0) break;
+        for (int i = 0; i < len && shown < (int)sizeof(buf) - 1; i++) buf[shown++] = chunk[i];
+        total += (uint32_t)len;
     }
     
-    char buf[1024];
-    int len = tcp_read(sock, buf, 1023);
-    if (len > 0) {
-        buf[len] = 0;
+    if (total > 0) {
+        buf[shown] = 0;
         cmd_write("\n--- Response ---\n");
         cmd_write(buf);
         cmd_write("\n----------------\n");
+        cmd_write_int((int)total);
+        cmd_write(" bytes received\n");
     } else {
         cmd_write("No data received.\n");
     }
@@ -1,32 +1,76 @@
 #include "net_defs.h"
 #include "cmd.h"
 #include "memory_manager.h"
-#include "wm.h"
+#include "clock.h"
+#include "thread.h"
+#include "wait.h"
+
+#define PING_TIMEOUT_MS 3000
+#define PING_INTERVAL_MS 1000
 
 static volatile bool ping_reply_received = false;
 static uint16_t ping_id_counter = 0;
 static uint16_t current_ping_id = 0;
 static bool is_pinging = false;
+static uint64_t ping_sent_ns = 0;
+static WaitQueue ping_wait = WAIT_QUEUE_INIT;
+// Filled in by the reply handler
+static ipv4_address_t ping_reply_src;
+static int ping_reply_len = 0;
+static int ping_reply_seq = 0;
+static uint64_t ping_rtt_us = 0;
 
 void icmp_handle_packet(ipv4_address_t src, void *data, uint16_t len) {
+    if (len < sizeof(icmp_header_t)) return;
     icmp_header_t *icmp = (icmp_header_t *)data;
     
+    if (icmp->type == 8) { // Echo Request
+        // The reply is the request with its type changed, so the checksum is
+        // patched (RFC 1624) instead of summed again over the payload
+        netbuf_t *nb = network_netbuf_from(data, len);
+        if (!nb) return;
+        icmp_header_t *reply = (icmp_header_t *)nb->data;
+        uint16_t old_word = (uint16_t)(reply->type | (reply->code << 8));
+        reply->type = 0;
+        uint16_t check = reply->checksum;
+        csum_replace2(&check, old_word, (uint16_t)(reply->code << 8));
+        reply->checksum = check;
+        ip_send_netbuf(src, IP_PROTO_ICMP, nb);
+        return;
+    }
+    
+    // Runs in the NET_RX softirq, where cmd_write (which may end up in fat32)
+    // can't be used: record the reply and let cli_cmd_ping print it
     if (icmp->type == 0 && is_pinging && ntohs(icmp->id) == current_ping_id) { // Echo Reply
+        ping_rtt_us = (clock_monotonic_ns() - ping_sent_ns) / CLOCK_NS_PER_US;
+        ping_reply_src = src;
+        ping_reply_len = len - sizeof(icmp_header_t);
+        ping_reply_seq = ntohs(icmp->sequence);
         ping_reply_received = true;
-        // Simple output
-        cmd_write("Reply from ");
-        cmd_write_int(src.bytes[0]); cmd_write(".");
-        cmd_write_int(src.bytes[1]); cmd_write(".");
-        cmd_write_int(src.bytes[2]); cmd_write(".");
-        cmd_write_int(src.bytes[3]); 
-        cmd_write(": bytes=");
-        cmd_write_int(len - sizeof(icmp_header_t));
-        cmd_write(" seq=");
-        cmd_write_int(ntohs(icmp->sequence));
-        cmd_write("\n");
+        wait_queue_wake_all(&ping_wait);
     }
 }
 
+static void print_reply(void) {
+    cmd_write("Reply from ");
+    cmd_write_int(ping_reply_src.bytes[0]); cmd_write(".");
+    cmd_write_int(ping_reply_src.bytes[1]); cmd_write(".");
+    cmd_write_int(ping_reply_src.bytes[2]); cmd_write(".");
+    cmd_write_int(ping_reply_src.bytes[3]); 
+    cmd_write(": bytes=");
+    cmd_write_int(ping_reply_len);
+    cmd_write(" seq=");
+    cmd_write_int(ping_reply_seq);
+    cmd_write(" time=");
+    cmd_write_int((int)(ping_rtt_us / 1000));
+    cmd_write(".");
+    int frac = (int)(ping_rtt_us % 1000);
+    if (frac < 100) cmd_write("0");
+    if (frac < 10) cmd_write("0");
+    cmd_write_int(frac);
+    cmd_write("ms\n");
+}
+
 void cli_cmd_ping(char *args) {
     if (!args || !*args) {
         cmd_write("Usage: ping <ip>\n");
@@ -70,22 +114,19 @@ void cli_cmd_ping(char *args) {
         icmp->checksum = net_checksum(packet, sizeof(packet));
 
         ping_reply_received = false;
+        ping_sent_ns = clock_monotonic_ns();
         ip_send_packet(dest, IP_PROTO_ICMP, packet, sizeof(packet));
 
-
-        uint32_t start_ticks = wm_get_ticks();
-        while (!ping_reply_received && (wm_get_ticks() - start_ticks) < 180) { // 3 seconds timeout
-            network_process_frames();
-        }
-        
-        if (!ping_reply_received) {
+        if (!wait_event_timeout(&ping_wait, ping_reply_received, PING_TIMEOUT_MS)) {
             cmd_write("Request timed out. (Did you run 'netinit'?)\n");
-        } else if (i < 3) {
+            continue;
+        }
+        print_reply();
+        if (i < 3) {
             // Wait a bit before next ping
-            uint32_t wait_start = wm_get_ticks();
-            while ((wm_get_ticks() - wait_start) < 60) {
-                 network_process_frames();
-            }
+            uint64_t next = ping_sent_ns + PING_INTERVAL_MS * CLOCK_NS_PER_MS;
+            uint64_t now = clock_monotonic_ns();
+            if (now < next) thread_sleep(next - now);
         }
     }
     is_pinging = false;
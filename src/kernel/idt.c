@@ -1,5 +1,7 @@
 #include "idt.h"
 #include "io.h"
+#include "apic.h"
+#include "smp.h"
 
 #define IDT_ENTRIES 256
 
@@ -34,10 +36,6 @@ void idt_set_gate(uint8_t vector, void *isr, uint16_t cs, uint8_t flags) {
 
 // Remap PIC
 static void pic_remap(void) {
-    uint8_t a1, a2;
-    a1 = inb(0x21);
-    a2 = inb(0xA1);
-
     outb(0x20, 0x11); io_wait();
     outb(0xA0, 0x11); io_wait();
     outb(0x21, 0x20); io_wait(); // Master offset 0x20 (32)
@@ -47,15 +45,14 @@ static void pic_remap(void) {
     outb(0x21, 0x01); io_wait();
     outb(0xA1, 0x01); io_wait();
 
-    // 0xEF = 1110 1111 (IRQ 12 (4 on slave) unmasked)
-    
-    outb(0x21, 0xF9); // Unmask Keyboard (IRQ1) and Cascade (IRQ2)
-    outb(0xA1, 0xEF); // Unmask Mouse (IRQ12)
+    // Everything masked until irq_unmask()
+    outb(0x21, 0xFF);
+    outb(0xA1, 0xFF);
 }
 
 // Set up PIT (Programmable Interval Timer) for ~60Hz (16.67ms intervals)
 static void pit_setup(void) {
-    uint16_t divisor = 1193182 / 60;  // ~60Hz
+    uint16_t divisor = 1193182 / TIMER_HZ;
     
     // Send command byte
     outb(0x43, 0x36); // Channel 0, lobyte/hibyte, mode 3 (square wave), binary
@@ -65,6 +62,16 @@ static void pit_setup(void) {
     outb(0x40, (divisor >> 8) & 0xFF);
 }
 
+static bool using_apic = false;
+
+typedef struct {
+    IrqHandler handler;
+    void *arg;
+    const char *name;
+} IrqLine;
+
+static IrqLine lines[IRQ_LINES];
+
 void idt_init(void) {
     uint16_t cs;
     asm volatile ("mov %%cs, %0" : "=r"(cs));
@@ -73,13 +80,89 @@ void idt_init(void) {
         idt[i] = (struct idt_entry){0};
     }
 
+    // The PIC is remapped even when the APIC takes over, so that its
+    // spurious IRQs land on vectors 39/47 rather than on CPU exceptions
     pic_remap();
-    
-    // Unmask IRQ 0 (Timer) in addition to IRQ 1 and 12
-    outb(0x21, 0xF8); // Unmask Timer (IRQ0), Keyboard (IRQ1) and Cascade (IRQ2)
-    outb(0xA1, 0xEF); // Unmask Mouse (IRQ12)
-    
-    pit_setup();
+
+    // With the APIC the local timer is only armed for pending deadlines
+    // (see timer.c); the PIT fallback ticks at TIMER_HZ
+    if (apic_init()) {
+        using_apic = true;
+    } else {
+        irq_unmask(0, false);
+        pit_setup();
+    }
+    irq_unmask(1, false);   // Keyboard
+    irq_unmask(12, false);  // Mouse
+}
+
+bool irq_using_apic(void) {
+    return using_apic;
+}
+
+void irq_unmask(uint8_t irq, bool pci) {
+    if (using_apic) {
+        ioapic_route_irq(irq, IRQ_VECTOR(irq), pci);
+    } else if (irq < 8) {
+        outb(0x21, inb(0x21) & ~(1 << irq));
+    } else if (irq < 16) {
+        outb(0xA1, inb(0xA1) & ~(1 << (irq - 8)));
+        outb(0x21, inb(0x21) & ~(1 << 2));      // Cascade
+    }
+}
+
+void irq_mask(uint8_t irq) {
+    if (using_apic) {
+        ioapic_mask_irq(irq);
+    } else if (irq < 8) {
+        outb(0x21, inb(0x21) | (1 << irq));
+    } else if (irq < 16) {
+        outb(0xA1, inb(0xA1) | (1 << (irq - 8)));
+    }
+}
+
+void irq_eoi(uint8_t irq) {
+    if (using_apic) {
+        apic_eoi();
+        return;
+    }
+    if (irq >= 8) outb(0xA0, 0x20);
+    outb(0x20, 0x20);
+}
+
+const char *irq_vector_name(uint8_t vector) {
+    switch (vector) {
+        case IRQ_VECTOR(0):   return "irq_timer";
+        case IRQ_VECTOR(1):   return "irq_keyboard";
+        case IRQ_VECTOR(12):  return "irq_mouse";
+        case IPI_CALL_VECTOR: return "ipi_call";
+    }
+    if (vector >= IRQ_VECTOR(0) && vector < IRQ_VECTOR(IRQ_LINES) && lines[vector - IRQ_VECTOR(0)].name) {
+        return lines[vector - IRQ_VECTOR(0)].name;
+    }
+    return "irq";
+}
+
+bool irq_register(uint8_t irq, const char *name, IrqHandler handler, void *arg, bool pci) {
+    // 0, 1 and 12 have wrappers of their own; 2 is the PIC cascade
+    if (irq >= IRQ_LINES || irq == 0 || irq == 1 || irq == 2 || irq == 12) return false;
+    if (lines[irq].handler) return false;
+
+    uint16_t cs;
+    asm volatile ("mov %%cs, %0" : "=r"(cs));
+    lines[irq].handler = handler;
+    lines[irq].arg = arg;
+    lines[irq].name = name;
+    idt_set_gate(IRQ_VECTOR(irq), irq_line_wrappers[irq], cs, 0x8E);
+    irq_unmask(irq, pci);
+    return true;
+}
+
+void irq_dispatch(IrqFrame *frame, uint8_t vector) {
+    (void)frame;
+    uint8_t irq = (uint8_t)(vector - IRQ_VECTOR(0));
+    if (lines[irq].handler) lines[irq].handler(lines[irq].arg);
+    irq_eoi(irq);
 }
 
 void idt_register_interrupts(void) {
@@ -89,6 +172,12 @@ void idt_register_interrupts(void) {
     idt_set_gate(32, isr0_wrapper, cs, 0x8E);  // Timer (IRQ 0)
     idt_set_gate(33, isr1_wrapper, cs, 0x8E);  // Keyboard (IRQ 1)
     idt_set_gate(44, isr12_wrapper, cs, 0x8E); // Mouse (IRQ 12)
+
+    // Spurious interrupts from the PIC (IRQ 7/15) and the local APIC
+    idt_set_gate(39, isr_spurious_wrapper, cs, 0x8E);
+    idt_set_gate(47, isr_spurious_slave_wrapper, cs, 0x8E);
+    idt_set_gate(APIC_SPURIOUS_VECTOR, isr_spurious_wrapper, cs, 0x8E);
+    idt_set_gate(IPI_CALL_VECTOR, isr_ipi_call_wrapper, cs, 0x8E);
 }
 
 void idt_load(void) {
@@ -97,3 +186,8 @@ void idt_load(void) {
     asm volatile ("lidt %0" : : "m"(idtr));
     asm volatile ("sti"); 
 }
+
+// Application processors share the BSP's table
+void idt_load_ap(void) {
+    asm volatile ("lidt %0" : : "m"(idtr));
+}
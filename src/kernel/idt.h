@@ -2,15 +2,52 @@
 #define IDT_H
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#define TIMER_HZ 60
+#define IRQ_VECTOR(irq) (32 + (irq))
 
 void idt_init(void);
 void idt_set_gate(uint8_t vector, void *isr, uint16_t cs, uint8_t flags);
 void idt_register_interrupts(void);
 void idt_load(void);
+void idt_load_ap(void);
+
+// Legacy IRQ lines, delivered through the I/O APIC when the MADT describes
+// one and through the 8259 PIC otherwise. IRQ 0 is the timer interrupt (local
+// APIC one-shot timer or the PIT).
+bool irq_using_apic(void);
+void irq_unmask(uint8_t irq, bool pci);
+void irq_mask(uint8_t irq);
+void irq_eoi(uint8_t irq);
+
+// Short name of what an interrupt vector is used for, for traces
+const char *irq_vector_name(uint8_t vector);
+
+// Run-time handlers for legacy lines, e.g. a PCI device's INTx line from its
+// Interrupt Line register. The handler runs with interrupts off and must
+// silence its device; the EOI is sent after it returns. Returns false if the
+// line is out of range or already taken.
+#define IRQ_LINES 16
+typedef void (*IrqHandler)(void *arg);
+bool irq_register(uint8_t irq, const char *name, IrqHandler handler, void *arg, bool pci);
+
+// Registers saved by the ISR wrappers, lowest address first. Handlers get a
+// pointer to it as their first argument and the vector as their second (most
+// ignore both).
+typedef struct {
+    uint64_t r15, r14, r13, r12, r11, r10, rbp, rbx, rax, r9, r8, rcx, rdx, rsi, rdi;
+    uint64_t rip, cs, rflags, rsp, ss;      // Pushed by the CPU
+} IrqFrame;
 
 // ISR wrappers defined in assembly
 extern void isr0_wrapper(void);  // Timer
 extern void isr1_wrapper(void);  // Keyboard
 extern void isr12_wrapper(void); // Mouse
+extern void isr_spurious_wrapper(void);
+extern void isr_spurious_slave_wrapper(void);  // Vector 47
+extern void isr_ipi_call_wrapper(void);
+extern void *const irq_line_wrappers[IRQ_LINES];     // For irq_register()
+void irq_dispatch(IrqFrame *frame, uint8_t vector);  // Called by those
 
 #endif
@@ -2,9 +2,17 @@ section .text
 global isr0_wrapper
 global isr1_wrapper
 global isr12_wrapper
+global isr_spurious_wrapper
+global isr_spurious_slave_wrapper
+global isr_ipi_call_wrapper
+global irq_line_wrappers
 extern timer_handler
 extern keyboard_handler
 extern mouse_handler
+extern smp_call_handler
+extern irq_dispatch
+extern irq_enter
+extern irq_exit
 
 ; Helper to send EOI (End of Interrupt) to PIC
 send_eoi:
@@ -18,7 +26,7 @@ send_eoi:
     pop rax
     ret
 
-%macro ISR_NOERRCODE 1
+%macro ISR_NOERRCODE 2
     push rdi
     push rsi
     push rdx
@@ -35,7 +43,13 @@ send_eoi:
     push r14
     push r15
     
+    mov edi, %2
+    call irq_enter
+    mov rdi, rsp            ; IrqFrame * for the handler
+    mov esi, %2             ; and the vector
     call %1
+    mov edi, %2
+    call irq_exit           ; Softirqs, then maybe switch threads; we come back here when resumed
     
     pop r15
     pop r14
@@ -56,10 +70,96 @@ send_eoi:
 %endmacro
 
 isr0_wrapper:
-    ISR_NOERRCODE timer_handler
+    ISR_NOERRCODE timer_handler, 32
 
 isr1_wrapper:
-    ISR_NOERRCODE keyboard_handler
+    ISR_NOERRCODE keyboard_handler, 33
 
 isr12_wrapper:
-    ISR_NOERRCODE mouse_handler
+    ISR_NOERRCODE mouse_handler, 44
+
+isr_ipi_call_wrapper:
+    ISR_NOERRCODE smp_call_handler, 0xF0
+
+; Spurious interrupts must not be acknowledged
+isr_spurious_wrapper:
+    iretq
+
+; A spurious IRQ 15 is still an IRQ 2 on the master, which needs its EOI
+isr_spurious_slave_wrapper:
+    push rax
+    mov al, 0x20
+    out 0x20, al
+    pop rax
+    iretq
+
+; Lines that drivers claim at run time with irq_register()
+isr_line0_wrapper:
+    ISR_NOERRCODE irq_dispatch, 32
+
+isr_line1_wrapper:
+    ISR_NOERRCODE irq_dispatch, 33
+
+isr_line2_wrapper:
+    ISR_NOERRCODE irq_dispatch, 34
+
+isr_line3_wrapper:
+    ISR_NOERRCODE irq_dispatch, 35
+
+isr_line4_wrapper:
+    ISR_NOERRCODE irq_dispatch, 36
+
+isr_line5_wrapper:
+    ISR_NOERRCODE irq_dispatch, 37
+
+isr_line6_wrapper:
+    ISR_NOERRCODE irq_dispatch, 38
+
+isr_line7_wrapper:
+    ISR_NOERRCODE irq_dispatch, 39
+
+isr_line8_wrapper:
+    ISR_NOERRCODE irq_dispatch, 40
+
+isr_line9_wrapper:
+    ISR_NOERRCODE irq_dispatch, 41
+
+isr_line10_wrapper:
+    ISR_NOERRCODE irq_dispatch, 42
+
+isr_line11_wrapper:
+    ISR_NOERRCODE irq_dispatch, 43
+
+isr_line12_wrapper:
+    ISR_NOERRCODE irq_dispatch, 44
+
+isr_line13_wrapper:
+    ISR_NOERRCODE irq_dispatch, 45
+
+isr_line14_wrapper:
+    ISR_NOERRCODE irq_dispatch, 46
+
+isr_line15_wrapper:
+    ISR_NOERRCODE irq_dispatch, 47
+
+; Absolute addresses need load-time relocations, which the PIE kernel can't
+; apply to a read-only segment, so the table lives in .data
+section .data
+irq_line_wrappers:
+    dq isr_line0_wrapper
+    dq isr_line1_wrapper
+    dq isr_line2_wrapper
+    dq isr_line3_wrapper
+    dq isr_line4_wrapper
+    dq isr_line5_wrapper
+    dq isr_line6_wrapper
+    dq isr_line7_wrapper
+    dq isr_line8_wrapper
+    dq isr_line9_wrapper
+    dq isr_line10_wrapper
+    dq isr_line11_wrapper
+    dq isr_line12_wrapper
+    dq isr_line13_wrapper
+    dq isr_line14_wrapper
+    dq isr_line15_wrapper
+
@@ -31,4 +31,33 @@ static inline void io_wait(void) {
     outb(0x80, 0);
 }
 
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t val) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)val), "d"((uint32_t)(val >> 32)));
+}
+
+// Interrupts-off accounting (irqstat.c)
+void irqoff_begin(void);
+void irqoff_end(void);
+
+#define RFLAGS_IF 0x200
+
+// Disable interrupts, returning the previous RFLAGS for irq_restore()
+static inline uint64_t irq_save(void) {
+    uint64_t flags;
+    asm volatile ("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    if (flags & RFLAGS_IF) irqoff_begin();
+    return flags;
+}
+
+static inline void irq_restore(uint64_t flags) {
+    if (flags & RFLAGS_IF) irqoff_end();
+    asm volatile ("push %0; popfq" : : "r"(flags) : "memory", "cc");
+}
+
 #endif
@@ -0,0 +1,127 @@
+#include "irqstat.h"
+#include "clock.h"
+#include "smp.h"
+#include "io.h"
+#include <stddef.h>
+
+#define VECTOR_COUNT 256
+
+static IrqVectorStat vectors[VECTOR_COUNT];
+static IrqOffStat irqoff[SMP_MAX_CPUS];
+static IrqLatencyStat latency;
+
+// Per CPU: when the running handler started, and the open interrupts-off
+// section (start 0 when there is none)
+static uint64_t handler_start[SMP_MAX_CPUS];
+static uint64_t irqoff_start[SMP_MAX_CPUS];
+static uint64_t irqoff_site[SMP_MAX_CPUS];
+
+static uint64_t peak_handler = 0;
+static uint64_t peak_irqoff = 0;
+static uint64_t peak_latency = 0;
+
+// irq_save() runs long before this_cpu() works
+static volatile bool ready = false;
+
+static void update_max(uint64_t *max, uint64_t value) {
+    uint64_t old = __atomic_load_n(max, __ATOMIC_RELAXED);
+    while (value > old &&
+           !__atomic_compare_exchange_n(max, &old, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+void irqstat_init(void) {
+    ready = true;
+}
+
+// Only ever called on the CPU the stats belong to, with interrupts off
+static void irqoff_account(int cpu, uint64_t cycles, uint64_t site, uint8_t vector) {
+    IrqOffStat *s = &irqoff[cpu];
+    s->sections++;
+    s->total_cycles += cycles;
+    if (cycles > s->max_cycles) {
+        s->max_cycles = cycles;
+        s->max_site = site;
+        s->max_vector = vector;
+    }
+    update_max(&peak_irqoff, cycles);
+}
+
+void irqoff_begin(void) {
+    if (!ready) return;
+    int cpu = this_cpu()->id;
+    irqoff_site[cpu] = (uint64_t)__builtin_return_address(0);
+    irqoff_start[cpu] = clock_cycles();
+}
+
+void irqoff_end(void) {
+    if (!ready) return;
+    int cpu = this_cpu()->id;
+    uint64_t start = irqoff_start[cpu];
+    if (!start) return;
+    irqoff_start[cpu] = 0;
+    irqoff_account(cpu, clock_cycles() - start, irqoff_site[cpu], 0);
+}
+
+void irqstat_handler_enter(uint8_t vector) {
+    (void)vector;
+    if (!ready) return;
+    handler_start[this_cpu()->id] = clock_cycles();
+}
+
+void irqstat_handler_exit(uint8_t vector) {
+    if (!ready) return;
+    int cpu = this_cpu()->id;
+    uint64_t cycles = clock_cycles() - handler_start[cpu];
+
+    IrqVectorStat *v = &vectors[vector];
+    __atomic_add_fetch(&v->count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&v->total_cycles, cycles, __ATOMIC_RELAXED);
+    update_max(&v->max_cycles, cycles);
+    update_max(&peak_handler, cycles);
+
+    irqoff_account(cpu, cycles, 0, vector);
+}
+
+void irqstat_timer_latency(uint64_t ns) {
+    latency.samples++;
+    latency.total_ns += ns;
+    if (ns > latency.max_ns) latency.max_ns = ns;
+    update_max(&peak_latency, ns);
+}
+
+// --- Results ---
+
+void irqstat_vector(uint8_t vector, IrqVectorStat *out) {
+    *out = vectors[vector];
+}
+
+void irqstat_irqoff(int cpu, IrqOffStat *out) {
+    if (cpu < 0 || cpu >= SMP_MAX_CPUS) {
+        *out = (IrqOffStat){0};
+        return;
+    }
+    *out = irqoff[cpu];
+}
+
+void irqstat_latency(IrqLatencyStat *out) {
+    *out = latency;
+}
+
+uint64_t irqstat_total(void) {
+    uint64_t total = 0;
+    for (int i = 0; i < VECTOR_COUNT; i++) total += vectors[i].count;
+    return total;
+}
+
+void irqstat_take_peaks(uint64_t *handler_cycles, uint64_t *irqoff_cycles, uint64_t *latency_ns) {
+    *handler_cycles = __atomic_exchange_n(&peak_handler, 0, __ATOMIC_RELAXED);
+    *irqoff_cycles = __atomic_exchange_n(&peak_irqoff, 0, __ATOMIC_RELAXED);
+    *latency_ns = __atomic_exchange_n(&peak_latency, 0, __ATOMIC_RELAXED);
+}
+
+void irqstat_reset(void) {
+    for (int i = 0; i < VECTOR_COUNT; i++) vectors[i] = (IrqVectorStat){0};
+    for (int i = 0; i < SMP_MAX_CPUS; i++) irqoff[i] = (IrqOffStat){0};
+    latency = (IrqLatencyStat){0};
+    peak_handler = peak_irqoff = peak_latency = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef IRQSTAT_H
+#define IRQSTAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Interrupt statistics:
+//  - per vector: how often it fired and how long its handler ran (entry to
+//    EOI and return, softirqs not included), in TSC cycles
+//  - per CPU: sections run with interrupts disabled, i.e. every outermost
+//    irq_save()/irq_restore() pair and every interrupt handler
+//  - timer latency: how late the timer interrupt arrives after the deadline
+//    it was programmed for (local APIC one-shot mode only). Anything that
+//    keeps interrupts off shows up here as input latency would.
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+} IrqVectorStat;
+
+typedef struct {
+    uint64_t sections;
+    uint64_t total_cycles;
+    uint64_t max_cycles;
+    uint64_t max_site;          // Where the longest one began; 0 for a handler
+    uint8_t max_vector;         // The handler, when max_site is 0
+} IrqOffStat;
+
+typedef struct {
+    uint64_t samples;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} IrqLatencyStat;
+
+// Start accounting interrupts-off sections (needs the per-CPU area)
+void irqstat_init(void);
+
+// Called by irq_enter()/irq_exit()
+void irqstat_handler_enter(uint8_t vector);
+void irqstat_handler_exit(uint8_t vector);
+
+// irqoff_begin()/irqoff_end() are declared in io.h: irq_save()/irq_restore()
+// call them when interrupts were enabled, and code that enables interrupts
+// without irq_restore() (sti;hlt, new threads, the ISR return) calls them
+// directly.
+
+void irqstat_timer_latency(uint64_t ns);
+
+// Results
+void irqstat_vector(uint8_t vector, IrqVectorStat *out);
+void irqstat_irqoff(int cpu, IrqOffStat *out);
+void irqstat_latency(IrqLatencyStat *out);
+uint64_t irqstat_total(void);           // Interrupts on all vectors
+
+// Worst handler, interrupts-off section and timer latency since the last
+// call, for the performance HUD
+void irqstat_take_peaks(uint64_t *handler_cycles, uint64_t *irqoff_cycles, uint64_t *latency_ns);
+
+void irqstat_reset(void);
+
+#endif
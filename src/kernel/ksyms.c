@@ -0,0 +1,44 @@
+#include "ksyms.h"
+#include <stddef.h>
+
+// Generated table, or the empty placeholders in ksyms_empty.c
+extern const KernelSymbol ksyms_table[];
+extern const uint32_t ksyms_table_size;
+extern const char ksyms_names[];
+extern const uint64_t ksyms_anchor;
+
+// The kernel is position independent and may be loaded anywhere; the table
+// also records where ksyms_find was at link time, which gives the slide
+static uint64_t slide(void) {
+    return ksyms_anchor ? (uint64_t)ksyms_find - ksyms_anchor : 0;
+}
+
+int ksyms_find(uint64_t addr) {
+    uint32_t n = ksyms_table_size;
+    if (n == 0) return -1;
+    addr -= slide();
+    if (addr < ksyms_table[0].addr) return -1;
+
+    // Last symbol at or below addr
+    uint32_t lo = 0, hi = n;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (ksyms_table[mid].addr <= addr) lo = mid;
+        else hi = mid;
+    }
+    return (int)lo;
+}
+
+int ksyms_count(void) {
+    return (int)ksyms_table_size;
+}
+
+const char *ksyms_name(int index) {
+    if (index < 0 || index >= (int)ksyms_table_size) return "?";
+    return &ksyms_names[ksyms_table[index].name];
+}
+
+uint64_t ksyms_addr(int index) {
+    if (index < 0 || index >= (int)ksyms_table_size) return 0;
+    return ksyms_table[index].addr + slide();
+}
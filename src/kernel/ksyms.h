@@ -0,0 +1,22 @@
+#ifndef KSYMS_H
+#define KSYMS_H
+
+#include <stdint.h>
+
+// Kernel symbol table for turning code addresses into names. The build links
+// the kernel once, lists its functions with nm and links again with the
+// generated table (build/ksyms_table.c); a kernel linked without it just has
+// an empty table.
+
+typedef struct {
+    uint64_t addr;              // Link-time address
+    uint32_t name;              // Offset into ksyms_names
+} KernelSymbol;
+
+// Index of the function containing addr (a run-time address), or -1
+int ksyms_find(uint64_t addr);
+int ksyms_count(void);
+const char *ksyms_name(int index);
+uint64_t ksyms_addr(int index);     // Run-time address
+
+#endif
@@ -0,0 +1,9 @@
+#include "ksyms.h"
+
+// Empty symbol table for the first link. These are weak so the generated
+// table wins the second link; they live apart from ksyms.c so the compiler
+// can't fold the empty values into the lookups.
+__attribute__((weak)) const KernelSymbol ksyms_table[1] = {{0, 0}};
+__attribute__((weak)) const uint32_t ksyms_table_size = 0;
+__attribute__((weak)) const char ksyms_names[1] = "";
+__attribute__((weak)) const uint64_t ksyms_anchor = 0;
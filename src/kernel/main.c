@@ -9,6 +9,13 @@
 #include "io.h"
 #include "memory_manager.h"
 #include "platform.h"
+#include "acpi.h"
+#include "clock.h"
+#include "timer.h"
+#include "smp.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "irqstat.h"
 
 // --- Limine Requests ---
 __attribute__((used, section(".requests")))
@@ -48,6 +55,11 @@ static void hcf(void) {
 // Kernel Entry Point
 void kmain(void) {
     platform_init();
+    acpi_init();
+    
+    // Calibrate the TSC before anything wants to measure time
+    clock_init();
+    timer_init();
     // 1. Graphics Init
 
     if (framebuffer_request.response == NULL || framebuffer_request.response->framebuffer_count < 1) {
@@ -57,6 +69,10 @@ void kmain(void) {
     struct limine_framebuffer *fb = framebuffer_request.response->framebuffers[0];
     graphics_init(fb);
 
+    // Per-CPU GDT and data for the BSP, before any IDT gate captures CS
+    smp_init_bsp();
+    irqstat_init();
+
     // 2. Interrupts Init
     idt_init();
     
@@ -89,18 +105,26 @@ void kmain(void) {
     
     memory_manager_init_with_size(pool_size);
 
+    // 2.6 Start the other CPUs (they idle until given work)
+    smp_start_aps();
+
+    // 2.7 kmain becomes the UI thread; shell commands get threads of their own
+    sched_init("ui", THREAD_PRIORITY_HIGH);
+    // Bottom halves that may take a while (repaints, mouse packets) run here
+    workqueue_init();
+
     // 3. PS/2 Init (Mouse/Keyboard)
-    asm("cli");
+    uint64_t flags = irq_save();
     ps2_init();
-    asm("sti");
+    irq_restore(flags);
 
     // 4. Window Manager Init (Draws initial desktop)
     wm_init();
 
-    // 5. Main loop - just wait for interrupts
-    // Timer interrupt will drive the redraw system
+    // 5. Main loop - handle keys, sleep until the next one
+    // Frames are painted by the worker thread when the frame timer fires
     while (1) {
         wm_process_input();
-        asm("hlt");
+        wm_wait_for_input();
     }
 }
@@ -1,5 +1,7 @@
 #include "memory_manager.h"
 #include "io.h"
+#include "spinlock.h"
+#include "trace.h"
 #include <stdint.h>
 
 // --- Internal State ---
@@ -13,6 +15,7 @@ static size_t total_allocated = 0;
 static size_t peak_allocated = 0;
 static uint32_t allocation_counter = 0;
 static bool initialized = false;
+static Spinlock heap_lock = SPINLOCK_INIT;  // Threads and interrupt handlers both allocate
 
 // --- Helper Functions ---
 
@@ -143,11 +146,7 @@ void memory_manager_init(void) {
     memory_manager_init_with_size(DEFAULT_POOL_SIZE);
 }
 
-void* kmalloc(size_t size) {
-    if (!initialized) {
-        memory_manager_init();
-    }
-    
+static void* kmalloc_locked(size_t size) {
     if (size == 0 || size > memory_pool_size) {
         return NULL;
     }
@@ -188,11 +187,21 @@ void* kmalloc(size_t size) {
     return ptr;
 }
 
-void kfree(void *ptr) {
-    if (ptr == NULL || !initialized) {
-        return;
+void* kmalloc(size_t size) {
+    if (!initialized) {
+        memory_manager_init();
     }
     
+    TRACE_BEGIN(TRACE_CAT_MEM, "kmalloc", size);
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    void *ptr = kmalloc_locked(size);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    TRACE_END(TRACE_CAT_MEM, "kmalloc", (uint64_t)ptr);
+    return ptr;
+}
+
+static void kfree_locked(void *ptr) {
+    
     // Find and free the block
     for (int i = 0; i < block_count; i++) {
         if (block_list[i].allocated && block_list[i].address == ptr) {
@@ -209,6 +218,18 @@ void kfree(void *ptr) {
     }
 }
 
+void kfree(void *ptr) {
+    if (ptr == NULL || !initialized) {
+        return;
+    }
+    
+    TRACE_BEGIN(TRACE_CAT_MEM, "kfree", (uint64_t)ptr);
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
+    kfree_locked(ptr);
+    spin_unlock_irqrestore(&heap_lock, flags);
+    TRACE_END(TRACE_CAT_MEM, "kfree", 0);
+}
+
 void* krealloc(void *ptr, size_t new_size) {
     if (!initialized) {
         memory_manager_init();
@@ -224,30 +245,37 @@ void* krealloc(void *ptr, size_t new_size) {
     }
     
     // Find the block
+    size_t old_size = 0;
+    uint64_t flags = spin_lock_irqsave(&heap_lock);
     for (int i = 0; i < block_count; i++) {
         if (block_list[i].allocated && block_list[i].address == ptr) {
-            if (block_list[i].size >= new_size) {
-                // Allocation is large enough
-                return ptr;
-            }
-            
-            // Need to allocate new space
-            void *new_ptr = kmalloc(new_size);
-            if (new_ptr == NULL) {
-                return NULL;
-            }
-            
-            // Copy data
-            mem_memmove(new_ptr, ptr, block_list[i].size);
-            
-            // Free old pointer
-            kfree(ptr);
-            
-            return new_ptr;
+            old_size = block_list[i].size;
+            break;
         }
     }
+    spin_unlock_irqrestore(&heap_lock, flags);
     
-    return NULL;
+    if (old_size == 0) {
+        return NULL;
+    }
+    if (old_size >= new_size) {
+        // Allocation is large enough
+        return ptr;
+    }
+    
+    // Need to allocate new space
+    void *new_ptr = kmalloc(new_size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+    
+    // Copy data
+    mem_memmove(new_ptr, ptr, old_size);
+    
+    // Free old pointer
+    kfree(ptr);
+    
+    return new_ptr;
 }
 
 MemStats memory_get_stats(void) {
@@ -6,6 +6,7 @@
 #include <stdbool.h>
 
 #include "network.h" 
+#include "checksum.h"
 
 // Protocol Numbers
 #define IP_PROTO_ICMP 1
@@ -27,19 +28,7 @@ static inline uint32_t ntohl(uint32_t v) {
 }
 
 static inline uint16_t net_checksum(void *data, int len) {
-    uint32_t sum = 0;
-    uint16_t *p = (uint16_t *)data;
-    while (len > 1) {
-        sum += *p++;
-        len -= 2;
-    }
-    if (len) {
-        sum += *(uint8_t *)p;
-    }
-    while (sum >> 16) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
-    }
-    return (uint16_t)~sum;
+    return csum_fold(csum_partial(data, (size_t)len, 0));
 }
 
 // --- Headers ---
@@ -87,7 +76,39 @@ tcp_socket_t* tcp_connect(ipv4_address_t ip, uint16_t port);
 void tcp_send(tcp_socket_t *sock, const char *data, int len);
 void tcp_close(tcp_socket_t *sock);
 bool tcp_is_connected(tcp_socket_t *sock);
+// Take up to max_len bytes of received data without blocking; reading
+// reopens the receive window
 int tcp_read(tcp_socket_t *sock, char *buffer, int max_len);
+// Wait up to timeout_ms for data and read it. 0 once the peer has closed and
+// everything is read, -1 on timeout.
+int tcp_recv(tcp_socket_t *sock, char *buffer, int max_len, uint32_t timeout_ms);
+// Block until the peer closes the connection; false on timeout
+bool tcp_wait_closed(tcp_socket_t *sock, uint32_t timeout_ms);
+
+// Congestion control algorithm for this connection ("newreno", "cubic");
+// false if there is none by that name
+bool tcp_set_congestion(tcp_socket_t *sock, const char *name);
+
+// A snapshot of a connection, for netstat and benchmarks
+typedef struct {
+    ipv4_address_t local_ip;
+    ipv4_address_t remote_ip;
+    uint16_t local_port;
+    uint16_t remote_port;
+    const char *state;
+    const char *cong;
+    uint32_t cwnd;          // Bytes
+    uint32_t ssthresh;
+    uint32_t snd_wnd;       // Peer's receive window
+    uint32_t srtt_us;
+    uint32_t rto_us;
+    uint32_t retransmits;
+    uint32_t fast_retransmits;
+    uint32_t timeouts;
+    uint32_t probes;        // Zero-window probes, not counted as retransmits
+} tcp_info_t;
+
+void tcp_get_info(tcp_socket_t *sock, tcp_info_t *info);
 
 // --- DNS API ---
 ipv4_address_t dns_resolve(const char *hostname);
@@ -95,16 +116,21 @@ ipv4_address_t dns_resolve(const char *hostname);
 // External dependencies from your existing IP layer
 // You must ensure these are implemented in network.c
 extern int ip_send_packet(ipv4_address_t dst, uint8_t protocol, const void *data, uint16_t len);
+// Takes ownership of nb; the IP and Ethernet headers go into its headroom
+extern int ip_send_netbuf(ipv4_address_t dst, uint8_t protocol, netbuf_t *nb);
 extern ipv4_address_t get_local_ip(void);
 extern ipv4_address_t get_dns_server_ip(void);
 
 // New functions exposed by modules
 void icmp_handle_packet(ipv4_address_t src, void *data, uint16_t len);
-void tcp_handle_packet(ipv4_address_t src, void *data, uint16_t len);
+void tcp_handle_packet(ipv4_address_t src, ipv4_address_t dst, void *data, uint16_t len);
 
 // CLI Commands
 void cli_cmd_ping(char *args);
 void cli_cmd_dns(char *args);
+void cli_cmd_netstat(char *args);
+void cli_cmd_tcpcc(char *args);
+void cli_cmd_tcpbench(char *args);
 void cli_cmd_httpget(char *args);
 
 #endif
@@ -0,0 +1,100 @@
+#include "netbuf.h"
+#include "memory_manager.h"
+#include "platform.h"
+#include "io.h"
+
+#define NETBUF_ALIGN 128
+
+static netbuf_t* free_list = NULL;
+static netbuf_stats_t stats;
+
+// Buffers come from the kernel heap, which is part of the physically
+// contiguous kernel image, so v2p() of a buffer is its DMA address
+int netbuf_pool_add(int count) {
+    if (count <= 0) return 0;
+    netbuf_t* headers = (netbuf_t*)kmalloc((size_t)count * sizeof(netbuf_t));
+    uint8_t* raw = (uint8_t*)kmalloc((size_t)count * NETBUF_SIZE + NETBUF_ALIGN - 1);
+    if (!headers || !raw) {
+        kfree(headers);
+        kfree(raw);
+        return -1;
+    }
+    uint8_t* buffers = (uint8_t*)(((uintptr_t)raw + NETBUF_ALIGN - 1) & ~(uintptr_t)(NETBUF_ALIGN - 1));
+
+    uint64_t flags = irq_save();
+    for (int i = 0; i < count; i++) {
+        netbuf_t* nb = &headers[i];
+        nb->head = buffers + (size_t)i * NETBUF_SIZE;
+        nb->next = free_list;
+        free_list = nb;
+    }
+    stats.total += count;
+    stats.free += count;
+    if (stats.low_water == 0 || stats.free < stats.low_water) stats.low_water = stats.free;
+    irq_restore(flags);
+    return 0;
+}
+
+netbuf_t* netbuf_alloc(void) {
+    uint64_t flags = irq_save();
+    netbuf_t* nb = free_list;
+    if (nb) {
+        free_list = nb->next;
+        stats.free--;
+        if (stats.free < stats.low_water) stats.low_water = stats.free;
+    } else {
+        stats.alloc_failures++;
+    }
+    irq_restore(flags);
+    if (!nb) return NULL;
+
+    nb->next = NULL;
+    nb->data = nb->head + NETBUF_HEADROOM;
+    nb->len = 0;
+    nb->csum = 0;
+    return nb;
+}
+
+void netbuf_free(netbuf_t* nb) {
+    if (!nb) return;
+    uint64_t flags = irq_save();
+    nb->next = free_list;
+    free_list = nb;
+    stats.free++;
+    irq_restore(flags);
+}
+
+uint8_t* netbuf_push(netbuf_t* nb, size_t n) {
+    if ((size_t)(nb->data - nb->head) < n) return NULL;
+    nb->data -= n;
+    nb->len += (uint16_t)n;
+    return nb->data;
+}
+
+uint8_t* netbuf_pull(netbuf_t* nb, size_t n) {
+    if (nb->len < n) return NULL;
+    nb->data += n;
+    nb->len -= (uint16_t)n;
+    return nb->data;
+}
+
+uint8_t* netbuf_put(netbuf_t* nb, size_t n) {
+    if (netbuf_tailroom(nb) < n) return NULL;
+    uint8_t* tail = nb->data + nb->len;
+    nb->len += (uint16_t)n;
+    return tail;
+}
+
+size_t netbuf_tailroom(const netbuf_t* nb) {
+    return (size_t)(nb->head + NETBUF_SIZE - (nb->data + nb->len));
+}
+
+uint64_t netbuf_dma(const netbuf_t* nb) {
+    return v2p((uint64_t)(uintptr_t)nb->data);
+}
+
+void netbuf_get_stats(netbuf_stats_t* out) {
+    uint64_t flags = irq_save();
+    *out = stats;
+    irq_restore(flags);
+}
@@ -0,0 +1,67 @@
+#ifndef NETBUF_H
+#define NETBUF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Packet buffers. Each netbuf owns one fixed-size, DMA-capable buffer from a
+// preallocated pool. The packet occupies [data, data + len) inside it; on the
+// way down the stack each layer prepends its header in place with
+// netbuf_push(), so the payload is copied once, into the buffer, and the NIC
+// sends straight out of it. Received frames arrive in a netbuf that was
+// posted to the receive ring and are handed up the stack as they are.
+//
+// Like the rest of the network stack, the pool is protected by disabling
+// interrupts and is only used on the bootstrap processor.
+
+#define NETBUF_SIZE 2048            // Whole buffer; also the NIC's receive buffer size
+#define NETBUF_HEADROOM 64          // Ethernet + IPv4 + TCP headers, rounded up
+
+typedef struct netbuf_t {
+    struct netbuf_t* next;          // Free list and driver queues
+    uint8_t* head;                  // Start of the buffer
+    uint8_t* data;                  // First byte of the packet
+    uint16_t len;
+    uint8_t csum;                   // NETBUF_CSUM_* flags
+    uint16_t sum_len;               // NETBUF_CSUM_PARTIAL: sum covers the
+    uint32_t sum;                   // last sum_len bytes of the packet
+} netbuf_t;
+
+// Checksum offload. On transmit: checksums the NIC is to fill in (the frame
+// is Ethernet + IPv4, and the TCP/UDP checksum field holds the pseudo-header
+// sum). On receive: checksums the NIC has already verified.
+#define NETBUF_CSUM_IP      0x01
+#define NETBUF_CSUM_TCP     0x02
+#define NETBUF_CSUM_UDP     0x04
+#define NETBUF_CSUM_PARTIAL 0x08    // Payload already summed while copying it in
+#define NETBUF_CSUM_IP_OK   0x10
+#define NETBUF_CSUM_L4_OK   0x20
+
+// Grow the pool by count buffers; returns 0, or -1 if out of memory
+int netbuf_pool_add(int count);
+
+// A buffer with NETBUF_HEADROOM in front of an empty packet, or NULL when the
+// pool is exhausted
+netbuf_t* netbuf_alloc(void);
+void netbuf_free(netbuf_t* nb);
+
+// Make room for a header in front of the packet / take it off again
+uint8_t* netbuf_push(netbuf_t* nb, size_t n);
+uint8_t* netbuf_pull(netbuf_t* nb, size_t n);
+// Extend the packet at the end; returns where the new bytes go
+uint8_t* netbuf_put(netbuf_t* nb, size_t n);
+size_t netbuf_tailroom(const netbuf_t* nb);
+
+// Physical address of the packet for DMA
+uint64_t netbuf_dma(const netbuf_t* nb);
+
+typedef struct {
+    uint32_t total;
+    uint32_t free;
+    uint32_t low_water;             // Fewest free buffers seen
+    uint32_t alloc_failures;
+} netbuf_stats_t;
+
+void netbuf_get_stats(netbuf_stats_t* out);
+
+#endif
@@ -5,6 +5,13 @@
 #include "pci.h"
 #undef IP_PROTO_UDP // Avoid redefinition warning from net_defs.h
 #include "net_defs.h"
+#include "clock.h"
+#include "timer.h"
+#include "wait.h"
+#include "softirq.h"
+#include "trace.h"
+#include "idt.h"
+#include "checksum.h"
 
 static int network_initialized = 0;
 static mac_address_t our_mac;
@@ -29,31 +36,59 @@ static int udp_callbacks_called_count = 0;
 static int e1000_receive_calls = 0;
 static int e1000_receive_empty = 0;
 static int network_process_calls = 0;
+static int csum_errors = 0;
 
 static void* kmemcpy(void* d, const void* s, size_t n){uint8_t*D=d;const uint8_t*S=s;for(size_t i=0;i<n;i++)D[i]=S[i];return d;}
 static void* kmemset(void* d,int v,size_t n){uint8_t*D=d;for(size_t i=0;i<n;i++)D[i]=(uint8_t)v;return d;}
 static int kmemcmp(const void* a,const void* b,size_t n){const uint8_t*A=a;const uint8_t*B=b;for(size_t i=0;i<n;i++){if(A[i]!=B[i])return (int)A[i]-(int)B[i];}return 0;}
 
-static uint16_t ipv4_checksum(const ipv4_header_t* h){
-    uint32_t sum=0;const uint16_t* w=(const uint16_t*)h;
-    for(int i=0;i<10;i++) sum+=w[i];
-    while(sum>>16) sum=(sum&0xFFFF)+(sum>>16);
-    return (uint16_t)(~sum);
+static uint16_t ipv4_checksum(const ipv4_header_t* h){ return csum_fold(csum_partial(h,(h->version_ihl&0x0F)*4,0)); }
+
+// The NIC inserts IPv4/TCP/UDP checksums and verifies them on receive
+static int csum_offload(void){ e1000_device_t* dev=e1000_get_device(); return dev && dev->csum_offload; }
+
+// TCP/UDP checksum over the pseudo-header and segment; 0 when it verifies
+static uint16_t l4_checksum(const ipv4_header_t* ip,const void* l4,uint16_t len){
+    return csum_fold(csum_partial(l4,len,csum_pseudo(ip->src_ip,ip->dest_ip,ip->protocol,len)));
 }
 
 static void arp_cache_init(void){ if(arp_cache_initialized) return; kmemset(arp_cache,0,sizeof(arp_cache)); arp_cache_initialized=1; }
 static arp_cache_entry_t* arp_cache_find(const ipv4_address_t* ip){ for(int i=0;i<ARP_CACHE_SIZE;i++){ if(arp_cache[i].valid && kmemcmp(&arp_cache[i].ip, ip, sizeof(ipv4_address_t))==0) return &arp_cache[i]; } return NULL; }
 static void arp_cache_add(const ipv4_address_t* ip,const mac_address_t* mac){ arp_cache_entry_t* e=arp_cache_find(ip); if(e){ kmemcpy(&e->mac,mac,sizeof(mac_address_t)); e->timestamp=0; return;} for(int i=0;i<ARP_CACHE_SIZE;i++){ if(!arp_cache[i].valid){ kmemcpy(&arp_cache[i].ip,ip,sizeof(ipv4_address_t)); kmemcpy(&arp_cache[i].mac,mac,sizeof(mac_address_t)); arp_cache[i].timestamp=0; arp_cache[i].valid=1; return; } } kmemcpy(&arp_cache[0].ip,ip,sizeof(ipv4_address_t)); kmemcpy(&arp_cache[0].mac,mac,sizeof(mac_address_t)); arp_cache[0].timestamp=0; arp_cache[0].valid=1; }
 
-int network_init(void){
+// Frames handled per softirq run. A full budget polls again instead of
+// re-enabling the NIC's interrupts, so a flood is drained without an
+// interrupt per frame (and handed to the worker thread past the softirq
+// restart limit).
+#define NET_RX_BUDGET 64
+
+// The NIC interrupt only masks the device and raises the RX softirq
+static bool rx_irq=false;
+static void network_irq(void* arg){ (void)arg; if(e1000_irq_ack()) softirq_raise(SOFTIRQ_NET_RX); }
+
+// Without a usable interrupt line the timer raises the RX softirq at the frame rate instead
+static Timer poll_timer;
+static void network_poll(void* arg){ (void)arg; softirq_raise(SOFTIRQ_NET_RX); timer_start(&poll_timer,clock_monotonic_ns()+CLOCK_NS_PER_SEC/TIMER_HZ,network_poll,NULL); }
+
+int network_init(void){ return network_init_with_rings(0,0); }
+
+int network_init_with_rings(uint16_t rx_ring_size,uint16_t tx_ring_size){
     if(network_initialized) return 0;
     pci_device_t device;
     if(!pci_find_device(E1000_VENDOR_ID,E1000_DEVICE_ID_82540EM,&device)) return -1;
-    if(e1000_init(&device)!=0) return -1;
+    if(e1000_init(&device,rx_ring_size,tx_ring_size)!=0) return -1;
     if(network_get_mac_address(&our_mac)!=0) return -1;
     arp_cache_init();
     kmemset(udp_callbacks,0,sizeof(udp_callbacks));
     network_initialized=1;
+    softirq_register(SOFTIRQ_NET_RX,network_process_frames);
+    e1000_device_t* dev=e1000_get_device();
+    if(dev->irq_line<IRQ_LINES && irq_register(dev->irq_line,"irq_e1000",network_irq,NULL,true)){
+        rx_irq=true;
+        e1000_irq_enable();
+    } else {
+        timer_start(&poll_timer,clock_monotonic_ns(),network_poll,NULL);
+    }
     return 0;
 }
 
@@ -81,67 +116,113 @@ int ip_send_packet(ipv4_address_t dst, uint8_t protocol, const void *data, uint1
     return ipv4_send_packet(&dst, protocol, data, len);
 }
 
-int network_send_frame(const void* data,size_t length){ if(!network_initialized) return -1; if(length>ETH_FRAME_MAX_SIZE) return -1; return e1000_send_packet(data,length); }
+int ip_send_netbuf(ipv4_address_t dst, uint8_t protocol, netbuf_t *nb) {
+    return ipv4_send_netbuf(&dst, protocol, nb);
+}
+
+int network_send_frame(const void* data,size_t length){ if(!network_initialized) return -1; if(length>ETH_FRAME_MAX_SIZE) return -1; TRACE_INSTANT(TRACE_CAT_NET,"tx",length); return e1000_send_packet(data,length); }
+
+int network_send_netbuf(netbuf_t* nb){
+    if(!network_initialized || nb->len>ETH_FRAME_MAX_SIZE){ netbuf_free(nb); return -1; }
+    TRACE_INSTANT(TRACE_CAT_NET,"tx",nb->len);
+    return e1000_send_netbuf(nb);
+}
+
+// This is the one copy on the way out. Without checksum offload the
+// payload is summed in the same pass, so the TCP/UDP checksum later only
+// has to add the header.
+netbuf_t* network_netbuf_from(const void* data,size_t length){
+    netbuf_t* nb=netbuf_alloc(); if(!nb) return NULL;
+    uint8_t* p=netbuf_put(nb,length);
+    if(!p){ netbuf_free(nb); return NULL; }
+    if(!length) return nb;
+    if(csum_offload()){ kmemcpy(p,data,length); return nb; }
+    nb->sum=csum_partial_copy(p,data,length,0);
+    nb->sum_len=(uint16_t)length;
+    nb->csum|=NETBUF_CSUM_PARTIAL;
+    return nb;
+}
+
+static void eth_push(netbuf_t* nb,const uint8_t* dest_mac,uint16_t ethertype){
+    eth_header_t* eth=(eth_header_t*)netbuf_push(nb,sizeof(eth_header_t));
+    kmemcpy(eth->dest_mac,dest_mac,6);
+    kmemcpy(eth->src_mac,our_mac.bytes,6);
+    eth->ethertype=htons(ethertype);
+}
 
-int network_receive_frame(void* buffer,size_t buffer_size){
-    if(!network_initialized) return 0;
+// Frames sent until the matching end go to the NIC with one doorbell write
+void network_tx_batch_begin(void){ e1000_tx_batch_begin(); }
+void network_tx_batch_end(void){ e1000_tx_batch_end(); }
+
+netbuf_t* network_receive_netbuf(void){
+    if(!network_initialized) return NULL;
     e1000_receive_calls++;
-    int result=e1000_receive_packet(buffer,buffer_size);
-    if(result==0) e1000_receive_empty++;
-    return result;
+    netbuf_t* nb=e1000_receive_netbuf();
+    if(!nb) e1000_receive_empty++;
+    return nb;
+}
+
+// Protocol handlers work on the receive buffer in place
+static void network_handle_frame(uint8_t* frame,size_t frame_length,uint8_t csum){
+    if(frame_length<sizeof(eth_header_t)) return;
+    eth_header_t* eth=(eth_header_t*)frame;
+    uint16_t ethertype=ntohs(eth->ethertype);
+    int is_broadcast=1; int is_for_us=1;
+    for(int i=0;i<6;i++){ if(eth->dest_mac[i]!=0xFF) is_broadcast=0; if(eth->dest_mac[i]!=our_mac.bytes[i]) is_for_us=0; }
+    if(!is_broadcast && !is_for_us) return;
+    void* payload=frame+sizeof(eth_header_t);
+    size_t payload_length=frame_length-sizeof(eth_header_t);
+    if(ethertype==ETH_ETHERTYPE_ARP){
+        if(payload_length>=sizeof(arp_header_t)) arp_process_packet((arp_header_t*)payload,payload_length);
+    } else if(ethertype==ETH_ETHERTYPE_IPV4){
+        if(payload_length>=sizeof(ipv4_header_t)){
+            ipv4_header_t* ip=(ipv4_header_t*)payload;
+            size_t ihl=(ip->version_ihl&0x0F)*4;
+            // Summed with its checksum field, a valid header comes to zero
+            if((csum&NETBUF_CSUM_IP_OK) || (ihl>=sizeof(ipv4_header_t) && ihl<=payload_length && ipv4_checksum(ip)==0)){
+                int for_our_ip=1;
+                for(int i=0;i<4;i++){ if(ip->dest_ip[i]!=ip_address.bytes[i]) { for_our_ip=0; break; } }
+                if(for_our_ip || ip->dest_ip[0]==255){
+                    mac_address_t src_mac;
+                    kmemcpy(src_mac.bytes,eth->src_mac,6);
+                    
+                    ipv4_address_t src_ip_struct;
+                    kmemcpy(src_ip_struct.bytes, ip->src_ip, 4);
+                    arp_cache_add(&src_ip_struct, &src_mac);
+                    
+                    ipv4_process_packet(ip,&src_mac,payload_length,csum);
+                }
+            } else csum_errors++;
+        }
+    }
 }
 
 void network_process_frames(void){
     network_process_calls++;
     if(!network_initialized) return;
-    uint8_t frame_buffer[ETH_FRAME_MAX_SIZE];
-    int frame_length;
-    while((frame_length=network_receive_frame(frame_buffer,sizeof(frame_buffer)))>0){
-        frames_received_count++;
-        if(frame_length<(int)sizeof(eth_header_t)) continue;
-        eth_header_t* eth=(eth_header_t*)frame_buffer;
-        uint16_t ethertype=ntohs(eth->ethertype);
-        int is_broadcast=1; int is_for_us=1;
-        for(int i=0;i<6;i++){ if(eth->dest_mac[i]!=0xFF) is_broadcast=0; if(eth->dest_mac[i]!=our_mac.bytes[i]) is_for_us=0; }
-        if(!is_broadcast && !is_for_us) continue;
-        void* payload=frame_buffer+sizeof(eth_header_t);
-        size_t payload_length=frame_length-sizeof(eth_header_t);
-        if(ethertype==ETH_ETHERTYPE_ARP){
-            if(payload_length>=sizeof(arp_header_t)) arp_process_packet((arp_header_t*)payload,payload_length);
-        } else if(ethertype==ETH_ETHERTYPE_IPV4){
-            if(payload_length>=sizeof(ipv4_header_t)){
-                ipv4_header_t* ip=(ipv4_header_t*)payload;
-                uint16_t checksum=ip->checksum;
-                ip->checksum=0;
-                uint16_t calc=ipv4_checksum(ip);
-                ip->checksum=checksum;
-                if(checksum==calc){
-                    int for_our_ip=1;
-                    for(int i=0;i<4;i++){ if(ip->dest_ip[i]!=ip_address.bytes[i]) { for_our_ip=0; break; } }
-                    if(for_our_ip || ip->dest_ip[0]==255){
-                        mac_address_t src_mac;
-                        kmemcpy(src_mac.bytes,eth->src_mac,6);
-                        
-                        ipv4_address_t src_ip_struct;
-                        kmemcpy(src_ip_struct.bytes, ip->src_ip, 4);
-                        arp_cache_add(&src_ip_struct, &src_mac);
-                        
-                        ipv4_process_packet(ip,&src_mac,payload_length);
-                    }
-                }
-            }
-        }
+    netbuf_t* nb;
+    TRACE_BEGIN(TRACE_CAT_NET,"net_rx",0);
+    // Replies generated while handling the batch (ACKs, ARP, pings) go out together
+    network_tx_batch_begin();
+    int batch=0;
+    while(batch<NET_RX_BUDGET && (nb=network_receive_netbuf())){
+        frames_received_count++; batch++;
+        TRACE_INSTANT(TRACE_CAT_NET,"rx",nb->len);
+        network_handle_frame(nb->data,nb->len,nb->csum);
+        netbuf_free(nb);
     }
+    e1000_rx_flush();
+    e1000_tx_poll();
+    network_tx_batch_end();
+    if(batch>=NET_RX_BUDGET) softirq_raise(SOFTIRQ_NET_RX);
+    else if(rx_irq) e1000_irq_enable();
+    TRACE_END(TRACE_CAT_NET,"net_rx",batch);
 }
 
 int arp_send_request(const ipv4_address_t* target_ip){
     if(!network_initialized) return -1;
-    uint8_t frame[ETH_FRAME_MAX_SIZE];
-    eth_header_t* eth=(eth_header_t*)frame;
-    arp_header_t* arp=(arp_header_t*)(frame+sizeof(eth_header_t));
-    for(int i=0;i<6;i++) eth->dest_mac[i]=0xFF;
-    kmemcpy(eth->src_mac,our_mac.bytes,6);
-    eth->ethertype=htons(ETH_ETHERTYPE_ARP);
+    netbuf_t* nb=netbuf_alloc(); if(!nb) return -1;
+    arp_header_t* arp=(arp_header_t*)netbuf_put(nb,sizeof(arp_header_t));
     arp->hw_type=htons(1);
     arp->proto_type=htons(ETH_ETHERTYPE_IPV4);
     arp->hw_len=6;
@@ -151,8 +232,9 @@ int arp_send_request(const ipv4_address_t* target_ip){
     kmemcpy(arp->sender_ip,ip_address.bytes,4);
     for(int i=0;i<6;i++) arp->target_mac[i]=0;
     kmemcpy(arp->target_ip,target_ip->bytes,4);
-    size_t frame_length=sizeof(eth_header_t)+sizeof(arp_header_t);
-    return network_send_frame(frame,frame_length);
+    static const uint8_t broadcast[6]={0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
+    eth_push(nb,broadcast,ETH_ETHERTYPE_ARP);
+    return network_send_netbuf(nb);
 }
 
 int arp_lookup(const ipv4_address_t* ip,mac_address_t* mac){
@@ -175,12 +257,8 @@ void arp_process_packet(const arp_header_t* arp,size_t length){
         int is_for_us=1;
         for(int i=0;i<4;i++){ if(arp->target_ip[i]!=ip_address.bytes[i]) { is_for_us=0; break; } }
         if(is_for_us){
-            uint8_t frame[ETH_FRAME_MAX_SIZE];
-            eth_header_t* eth=(eth_header_t*)frame;
-            arp_header_t* r=(arp_header_t*)(frame+sizeof(eth_header_t));
-            kmemcpy(eth->dest_mac,arp->sender_mac,6);
-            kmemcpy(eth->src_mac,our_mac.bytes,6);
-            eth->ethertype=htons(ETH_ETHERTYPE_ARP);
+            netbuf_t* nb=netbuf_alloc(); if(!nb) return;
+            arp_header_t* r=(arp_header_t*)netbuf_put(nb,sizeof(arp_header_t));
             r->hw_type=htons(1);
             r->proto_type=htons(ETH_ETHERTYPE_IPV4);
             r->hw_len=6;
@@ -190,14 +268,19 @@ void arp_process_packet(const arp_header_t* arp,size_t length){
             kmemcpy(r->sender_ip,ip_address.bytes,4);
             kmemcpy(r->target_mac,arp->sender_mac,6);
             kmemcpy(r->target_ip,arp->sender_ip,4);
-            size_t frame_length=sizeof(eth_header_t)+sizeof(arp_header_t);
-            network_send_frame(frame,frame_length);
+            eth_push(nb,arp->sender_mac,ETH_ETHERTYPE_ARP);
+            network_send_netbuf(nb);
         }
     }
 }
 
-int ipv4_send_packet(const ipv4_address_t* dest_ip,uint8_t protocol,const void* data,size_t data_length){
-    if(!network_initialized) return -1;
+static int ipv4_output(const ipv4_address_t* dest_ip,const mac_address_t* dest_mac,uint8_t protocol,netbuf_t* nb);
+
+// Shell threads send with interrupts on; the ARP cache, the routing settings
+// and ipv4_id_counter are shared with the NET_RX softirq
+int ipv4_send_netbuf(const ipv4_address_t* dest_ip,uint8_t protocol,netbuf_t* nb){
+    if(!network_initialized){ netbuf_free(nb); return -1; }
+    uint64_t flags=irq_save();
     mac_address_t dest_mac;
     int is_bcast=(dest_ip->bytes[0]==255 && dest_ip->bytes[1]==255 && dest_ip->bytes[2]==255 && dest_ip->bytes[3]==255);
     
@@ -225,17 +308,25 @@ int ipv4_send_packet(const ipv4_address_t* dest_ip,uint8_t protocol,const void*
             for(int i=0;i<6;i++) dest_mac.bytes[i]=0xFF; 
         } 
     }
-    
-    uint8_t frame[ETH_FRAME_MAX_SIZE];
-    eth_header_t* eth=(eth_header_t*)frame;
-    ipv4_header_t* ip=(ipv4_header_t*)(frame+sizeof(eth_header_t));
-    void* ip_payload=frame+sizeof(eth_header_t)+sizeof(ipv4_header_t);
-    kmemcpy(eth->dest_mac,dest_mac.bytes,6);
-    kmemcpy(eth->src_mac,our_mac.bytes,6);
-    eth->ethertype=htons(ETH_ETHERTYPE_IPV4);
+    int r=ipv4_output(dest_ip,&dest_mac,protocol,nb);
+    irq_restore(flags);
+    return r;
+}
+
+int ipv4_send_netbuf_to_mac(const ipv4_address_t* dest_ip,const mac_address_t* dest_mac,uint8_t protocol,netbuf_t* nb){
+    if(!network_initialized){ netbuf_free(nb); return -1; }
+    uint64_t flags=irq_save();
+    int r=ipv4_output(dest_ip,dest_mac,protocol,nb);
+    irq_restore(flags);
+    return r;
+}
+
+// Pushes the IPv4 and Ethernet headers in front of the payload already in nb
+static int ipv4_output(const ipv4_address_t* dest_ip,const mac_address_t* dest_mac,uint8_t protocol,netbuf_t* nb){
+    ipv4_header_t* ip=(ipv4_header_t*)netbuf_push(nb,sizeof(ipv4_header_t));
     ip->version_ihl=(4<<4)|5;
     ip->tos=0;
-    ip->total_length=htons(sizeof(ipv4_header_t)+data_length);
+    ip->total_length=htons(nb->len);
     ip->id=htons(ipv4_id_counter++);
     ip->flags_frag=0;
     ip->ttl=64;
@@ -243,45 +334,57 @@ int ipv4_send_packet(const ipv4_address_t* dest_ip,uint8_t protocol,const void*
     ip->checksum=0;
     kmemcpy(ip->src_ip,ip_address.bytes,4);
     kmemcpy(ip->dest_ip,dest_ip->bytes,4);
-    ip->checksum=ipv4_checksum(ip);
-    kmemcpy(ip_payload,data,data_length);
-    size_t frame_length=sizeof(eth_header_t)+sizeof(ipv4_header_t)+data_length;
-    return network_send_frame(frame,frame_length);
+    // With offload the TCP/UDP checksum field carries the pseudo-header sum
+    // and the NIC adds the rest; otherwise everything is summed here
+    int offload=csum_offload();
+    if(nb->csum&(NETBUF_CSUM_TCP|NETBUF_CSUM_UDP)){
+        uint8_t* l4=(uint8_t*)ip+sizeof(ipv4_header_t);
+        uint16_t l4_len=(uint16_t)(nb->len-sizeof(ipv4_header_t));
+        uint16_t* field=(uint16_t*)(l4+((nb->csum&NETBUF_CSUM_TCP)?16:6));
+        if(offload){
+            *field=csum_reduce(csum_pseudo(ip->src_ip,ip->dest_ip,protocol,l4_len));
+        } else {
+            *field=0;
+            uint32_t sum=csum_pseudo(ip->src_ip,ip->dest_ip,protocol,l4_len);
+            if((nb->csum&NETBUF_CSUM_PARTIAL) && nb->sum_len<=l4_len) sum=csum_add(csum_partial(l4,l4_len-nb->sum_len,sum),nb->sum);
+            else sum=csum_partial(l4,l4_len,sum);
+            uint16_t c=csum_fold(sum);
+            if(c==0 && (nb->csum&NETBUF_CSUM_UDP)) c=0xFFFF;   // 0 means "no checksum" for UDP
+            *field=c;
+            nb->csum&=(uint8_t)~(NETBUF_CSUM_TCP|NETBUF_CSUM_UDP);
+        }
+    }
+    if(offload) nb->csum|=NETBUF_CSUM_IP;
+    else ip->checksum=ipv4_checksum(ip);
+    eth_push(nb,dest_mac->bytes,ETH_ETHERTYPE_IPV4);
+    return network_send_netbuf(nb);
+}
+
+int ipv4_send_packet(const ipv4_address_t* dest_ip,uint8_t protocol,const void* data,size_t data_length){
+    if(!network_initialized) return -1;
+    netbuf_t* nb=network_netbuf_from(data,data_length); if(!nb) return -1;
+    return ipv4_send_netbuf(dest_ip,protocol,nb);
 }
 
 int ipv4_send_packet_to_mac(const ipv4_address_t* dest_ip,const mac_address_t* dest_mac,uint8_t protocol,const void* data,size_t data_length){
     if(!network_initialized) return -1;
-    uint8_t frame[ETH_FRAME_MAX_SIZE];
-    eth_header_t* eth=(eth_header_t*)frame;
-    ipv4_header_t* ip=(ipv4_header_t*)(frame+sizeof(eth_header_t));
-    void* ip_payload=frame+sizeof(eth_header_t)+sizeof(ipv4_header_t);
-    kmemcpy(eth->dest_mac,dest_mac->bytes,6);
-    kmemcpy(eth->src_mac,our_mac.bytes,6);
-    eth->ethertype=htons(ETH_ETHERTYPE_IPV4);
-    ip->version_ihl=(4<<4)|5;
-    ip->tos=0;
-    ip->total_length=htons(sizeof(ipv4_header_t)+data_length);
-    ip->id=htons(ipv4_id_counter++);
-    ip->flags_frag=0;
-    ip->ttl=64;
-    ip->protocol=protocol;
-    ip->checksum=0;
-    kmemcpy(ip->src_ip,ip_address.bytes,4);
-    kmemcpy(ip->dest_ip,dest_ip->bytes,4);
-    ip->checksum=ipv4_checksum(ip);
-    kmemcpy(ip_payload,data,data_length);
-    size_t frame_length=sizeof(eth_header_t)+sizeof(ipv4_header_t)+data_length;
-    return network_send_frame(frame,frame_length);
+    netbuf_t* nb=network_netbuf_from(data,data_length); if(!nb) return -1;
+    return ipv4_send_netbuf_to_mac(dest_ip,dest_mac,protocol,nb);
 }
 
-void ipv4_process_packet(const ipv4_header_t* ip,const mac_address_t* src_mac,size_t length){
+void ipv4_process_packet(const ipv4_header_t* ip,const mac_address_t* src_mac,size_t length,uint8_t csum){
     if(length<sizeof(ipv4_header_t)) return;
     uint8_t ihl=(ip->version_ihl & 0x0F)*4;
     if(ihl<20 || length<ihl) return;
     uint16_t total_length=ntohs(ip->total_length);
-    if(total_length>length) return;
+    if(total_length>length || total_length<ihl) return;
     void* payload=(void*)ip+ihl;
     size_t payload_length=total_length-ihl;
+    if(!(csum&NETBUF_CSUM_L4_OK)){
+        int check=(ip->protocol==IP_PROTO_TCP && payload_length>=sizeof(tcp_header_t)) ||
+                  (ip->protocol==IP_PROTO_UDP && payload_length>=sizeof(udp_header_t) && ((udp_header_t*)payload)->checksum!=0);
+        if(check && l4_checksum(ip,payload,(uint16_t)payload_length)!=0){ csum_errors++; return; }
+    }
     if(ip->protocol==IP_PROTO_UDP){
         if(payload_length>=sizeof(udp_header_t)){
             udp_packets_received_count++;
@@ -309,36 +412,33 @@ void ipv4_process_packet(const ipv4_header_t* ip,const mac_address_t* src_mac,si
     } else if (ip->protocol == IP_PROTO_TCP) {
         ipv4_address_t src_ip;
         kmemcpy(src_ip.bytes, ip->src_ip, 4);
-        tcp_handle_packet(src_ip, payload, payload_length);
+        ipv4_address_t dest_ip;
+        kmemcpy(dest_ip.bytes, ip->dest_ip, 4);
+        tcp_handle_packet(src_ip, dest_ip, payload, payload_length);
     }
 }
 
-int udp_send_packet(const ipv4_address_t* dest_ip,uint16_t dest_port,uint16_t src_port,const void* data,size_t data_length){
-    if(!network_initialized) return -1;
-    uint8_t udp_packet[ETH_FRAME_MAX_SIZE];
-    udp_header_t* udp=(udp_header_t*)udp_packet;
-    void* udp_payload=udp_packet+sizeof(udp_header_t);
+static void udp_push(netbuf_t* nb,uint16_t dest_port,uint16_t src_port){
+    udp_header_t* udp=(udp_header_t*)netbuf_push(nb,sizeof(udp_header_t));
     udp->src_port=htons(src_port);
     udp->dest_port=htons(dest_port);
-    udp->length=htons(sizeof(udp_header_t)+data_length);
+    udp->length=htons(nb->len);
     udp->checksum=0;
-    kmemcpy(udp_payload,data,data_length);
-    size_t udp_packet_length=sizeof(udp_header_t)+data_length;
-    return ipv4_send_packet(dest_ip,IP_PROTO_UDP,udp_packet,udp_packet_length);
+    nb->csum|=NETBUF_CSUM_UDP;     // Filled in once the IP addresses are known
+}
+
+int udp_send_packet(const ipv4_address_t* dest_ip,uint16_t dest_port,uint16_t src_port,const void* data,size_t data_length){
+    if(!network_initialized) return -1;
+    netbuf_t* nb=network_netbuf_from(data,data_length); if(!nb) return -1;
+    udp_push(nb,dest_port,src_port);
+    return ipv4_send_netbuf(dest_ip,IP_PROTO_UDP,nb);
 }
 
 int udp_send_packet_to_mac(const ipv4_address_t* dest_ip,const mac_address_t* dest_mac,uint16_t dest_port,uint16_t src_port,const void* data,size_t data_length){
     if(!network_initialized) return -1;
-    uint8_t udp_packet[ETH_FRAME_MAX_SIZE];
-    udp_header_t* udp=(udp_header_t*)udp_packet;
-    void* udp_payload=udp_packet+sizeof(udp_header_t);
-    udp->src_port=htons(src_port);
-    udp->dest_port=htons(dest_port);
-    udp->length=htons(sizeof(udp_header_t)+data_length);
-    udp->checksum=0;
-    kmemcpy(udp_payload,data,data_length);
-    size_t udp_packet_length=sizeof(udp_header_t)+data_length;
-    return ipv4_send_packet_to_mac(dest_ip,dest_mac,IP_PROTO_UDP,udp_packet,udp_packet_length);
+    netbuf_t* nb=network_netbuf_from(data,data_length); if(!nb) return -1;
+    udp_push(nb,dest_port,src_port);
+    return ipv4_send_netbuf_to_mac(dest_ip,dest_mac,IP_PROTO_UDP,nb);
 }
 
 int udp_register_callback(uint16_t port,udp_callback_t callback){
@@ -360,7 +460,9 @@ int network_get_udp_packets_received(void){ return udp_packets_received_count; }
 int network_get_udp_callbacks_called(void){ return udp_callbacks_called_count; }
 int network_get_e1000_receive_calls(void){ return e1000_receive_calls; }
 int network_get_e1000_receive_empty(void){ return e1000_receive_empty; }
+int network_rx_irq(void){ return rx_irq; }
 int network_get_process_calls(void){ return network_process_calls; }
+int network_get_csum_errors(void){ return csum_errors; }
 
 #define DHCP_CLIENT_PORT 68
 #define DHCP_SERVER_PORT 67
@@ -382,6 +484,7 @@ int network_get_process_calls(void){ return network_process_calls; }
 #define DHCP_OPT_DNS 6
 #define DHCP_OPT_PARAM_REQ_LIST 55
 #define DHCP_OPT_END 255
+#define DHCP_TIMEOUT_MS 5000      // Per phase (offer, then ack)
 
 typedef struct {
     uint8_t  op;
@@ -403,6 +506,7 @@ typedef struct {
 } __attribute__((packed)) dhcp_packet_t;
 
 static volatile int dhcp_state = 0;
+static WaitQueue dhcp_wait = WAIT_QUEUE_INIT;
 static uint32_t dhcp_xid = 0;
 static ipv4_address_t dhcp_offered_ip;
 static uint32_t dhcp_server_id = 0;
@@ -457,7 +561,7 @@ static void dhcp_udp_callback(const ipv4_address_t* src_ip,uint16_t src_port,con
         dhcp_offered_ip.bytes[3]=(uint8_t)(yi_host&0xFF);
         const uint8_t* p=pkt->options; dhcp_server_id=0;
         while(*p!=DHCP_OPT_END){ uint8_t c=*p++; uint8_t l=*p++; if(c==DHCP_OPT_SERVER_ID && l==4){ dhcp_server_id=((uint32_t)p[0]<<24)|((uint32_t)p[1]<<16)|((uint32_t)p[2]<<8)|(uint32_t)p[3]; break; } p+=l; }
-        if(dhcp_server_id!=0) dhcp_state=1;
+        if(dhcp_server_id!=0){ dhcp_state=1; wait_queue_wake_all(&dhcp_wait); }
     } else if(mtype==DHCP_MSG_ACK){
         uint32_t yi_host=ntohl32(pkt->yiaddr);
         ip_address.bytes[0]=(uint8_t)((yi_host>>24)&0xFF);
@@ -483,8 +587,10 @@ static void dhcp_udp_callback(const ipv4_address_t* src_ip,uint16_t src_port,con
         }
         
         dhcp_state=2;
+        wait_queue_wake_all(&dhcp_wait);
     } else if(mtype==DHCP_MSG_NAK){
         dhcp_state=-1;
+        wait_queue_wake_all(&dhcp_wait);
     }
 }
 
@@ -497,10 +603,10 @@ int network_dhcp_acquire(void){
     dhcp_build_discover(&pkt);
     ipv4_address_t bcast={{255,255,255,255}};
     udp_send_packet(&bcast,DHCP_SERVER_PORT,DHCP_CLIENT_PORT,&pkt,sizeof(dhcp_packet_t));
-    for(int i=0;i<500000 && dhcp_state==0;i++){ network_process_frames(); if(i%1000==0){ for(volatile int d=0; d<100000; d++){} } }
+    wait_event_timeout(&dhcp_wait,dhcp_state!=0,DHCP_TIMEOUT_MS);
     if(dhcp_state!=1) return -1;
     dhcp_build_request(&pkt);
     udp_send_packet(&bcast,DHCP_SERVER_PORT,DHCP_CLIENT_PORT,&pkt,sizeof(dhcp_packet_t));
-    for(int i=0;i<500000 && dhcp_state==1;i++){ network_process_frames(); if(i%1000==0){ for(volatile int d=0; d<100000; d++){} } }
+    wait_event_timeout(&dhcp_wait,dhcp_state!=1,DHCP_TIMEOUT_MS);
     return (dhcp_state==2)?0:-1;
 }
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "e1000.h"
+#include "netbuf.h"
 
 #define ETH_FRAME_MAX_SIZE 1518
 #define ETH_HEADER_SIZE 14
@@ -57,18 +58,31 @@ typedef struct {
 } __attribute__((packed)) udp_header_t;
 
 int network_init(void);
+// Descriptor ring sizes for the NIC; 0 picks the default (see e1000.h)
+int network_init_with_rings(uint16_t rx_ring_size, uint16_t tx_ring_size);
 int network_get_mac_address(mac_address_t* mac);
 int network_get_ipv4_address(ipv4_address_t* ip);
 int network_set_ipv4_address(const ipv4_address_t* ip);
 int network_send_frame(const void* data, size_t length);
-int network_receive_frame(void* buffer, size_t buffer_size);
+// The *_netbuf senders take ownership of nb, which must carry the payload
+// behind its headroom (netbuf_alloc + netbuf_put); headers are pushed in place
+int network_send_netbuf(netbuf_t* nb);
+// A netbuf with a copy of data behind the headroom, ready for the headers
+netbuf_t* network_netbuf_from(const void* data, size_t length);
+void network_tx_batch_begin(void);
+void network_tx_batch_end(void);
+// The next received frame, still in its DMA buffer; the caller frees it
+netbuf_t* network_receive_netbuf(void);
 void network_process_frames(void);
 int arp_send_request(const ipv4_address_t* target_ip);
 int arp_lookup(const ipv4_address_t* ip, mac_address_t* mac);
 void arp_process_packet(const arp_header_t* arp, size_t length);
 int ipv4_send_packet(const ipv4_address_t* dest_ip, uint8_t protocol, const void* data, size_t data_length);
 int ipv4_send_packet_to_mac(const ipv4_address_t* dest_ip, const mac_address_t* dest_mac, uint8_t protocol, const void* data, size_t data_length);
-void ipv4_process_packet(const ipv4_header_t* ip, const mac_address_t* src_mac, size_t length);
+int ipv4_send_netbuf(const ipv4_address_t* dest_ip, uint8_t protocol, netbuf_t* nb);
+int ipv4_send_netbuf_to_mac(const ipv4_address_t* dest_ip, const mac_address_t* dest_mac, uint8_t protocol, netbuf_t* nb);
+// csum: NETBUF_CSUM_*_OK flags for checksums the NIC has already verified
+void ipv4_process_packet(const ipv4_header_t* ip, const mac_address_t* src_mac, size_t length, uint8_t csum);
 int udp_send_packet(const ipv4_address_t* dest_ip, uint16_t dest_port, uint16_t src_port, const void* data, size_t data_length);
 int udp_send_packet_to_mac(const ipv4_address_t* dest_ip, const mac_address_t* dest_mac, uint16_t dest_port, uint16_t src_port, const void* data, size_t data_length);
 typedef void (*udp_callback_t)(const ipv4_address_t* src_ip, uint16_t src_port, const mac_address_t* src_mac, const void* data, size_t length);
@@ -80,6 +94,8 @@ int network_get_udp_callbacks_called(void);
 int network_get_e1000_receive_calls(void);
 int network_get_e1000_receive_empty(void);
 int network_get_process_calls(void);
+int network_get_csum_errors(void);       // Frames dropped for a bad IPv4/TCP/UDP checksum
+int network_rx_irq(void);               // 1 if receive is interrupt driven, 0 if polled
 int network_dhcp_acquire(void);
 int network_get_gateway_ip(ipv4_address_t* ip);
 int network_get_dns_ip(ipv4_address_t* ip);
@@ -0,0 +1,329 @@
+#include "perf.h"
+#include "graphics.h"
+#include "wm.h"
+#include "fat32.h"
+#include "memory_manager.h"
+#include "clock.h"
+#include "irqstat.h"
+#include <stddef.h>
+
+// Ring of finished frames
+static PerfFrame history[PERF_HISTORY];
+static int history_head = 0;
+static int history_count = 0;
+
+// Frame being measured
+static bool in_frame = false;
+static uint64_t frame_start;
+static uint64_t frame_stage[PERF_STAGE_COUNT];
+static uint64_t frame_written_start;
+static uint64_t frame_flipped_start;
+
+// Per-window paint cost, keyed by title pointer
+typedef struct {
+    const char *name;
+    uint64_t frame_cycles;      // This frame so far
+    uint64_t avg_cycles;        // Moving average over frames it was painted in
+    uint32_t last_tick;
+} PerfWindow;
+
+static PerfWindow windows[PERF_MAX_WINDOWS];
+static int window_slots = 0;
+
+static bool hud_visible = false;
+static PerfSummary hud_summary;
+static uint32_t hud_summary_tick = 0;
+
+// Interrupt load over the last refresh
+static uint64_t hud_irq_count = 0;
+static uint64_t hud_irq_ns = 0;
+static uint64_t hud_irq_rate = 0;
+static uint64_t hud_peak_handler = 0;
+static uint64_t hud_peak_irqoff = 0;
+static uint64_t hud_peak_latency = 0;
+
+#define HUD_W 240
+#define HUD_LINES 13
+#define HUD_LINE_H 10
+
+void perf_frame_begin(void) {
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) frame_stage[i] = 0;
+    for (int i = 0; i < window_slots; i++) windows[i].frame_cycles = 0;
+    graphics_get_pixel_counts(&frame_written_start, &frame_flipped_start);
+    in_frame = true;
+    frame_start = clock_cycles();
+}
+
+void perf_stage_add(PerfStage stage, uint64_t cycles) {
+    if (!in_frame || stage >= PERF_STAGE_COUNT) return;
+    frame_stage[stage] += cycles;
+}
+
+void perf_window_add(const char *name, uint64_t cycles) {
+    if (!in_frame) return;
+    frame_stage[PERF_STAGE_WINDOWS] += cycles;
+
+    for (int i = 0; i < window_slots; i++) {
+        if (windows[i].name == name) {
+            windows[i].frame_cycles += cycles;
+            return;
+        }
+    }
+    if (window_slots < PERF_MAX_WINDOWS) {
+        windows[window_slots].name = name;
+        windows[window_slots].frame_cycles = cycles;
+        windows[window_slots].avg_cycles = 0;
+        window_slots++;
+    }
+}
+
+static void hud_irq_refresh(void) {
+    uint64_t count = irqstat_total();
+    uint64_t ns = clock_monotonic_ns();
+    if (hud_irq_ns && ns > hud_irq_ns) {
+        hud_irq_rate = (count - hud_irq_count) * CLOCK_NS_PER_SEC / (ns - hud_irq_ns);
+    }
+    hud_irq_count = count;
+    hud_irq_ns = ns;
+    irqstat_take_peaks(&hud_peak_handler, &hud_peak_irqoff, &hud_peak_latency);
+}
+
+void perf_frame_end(void) {
+    if (!in_frame) return;
+    uint64_t end = clock_cycles();
+    uint32_t tick = wm_get_ticks();
+    in_frame = false;
+
+    PerfFrame *f = &history[history_head];
+    f->tick = tick;
+    f->cycles = end - frame_start;
+    for (int i = 0; i < PERF_STAGE_COUNT; i++) f->stage_cycles[i] = frame_stage[i];
+    uint64_t written, flipped;
+    graphics_get_pixel_counts(&written, &flipped);
+    f->pixels_written = written - frame_written_start;
+    f->pixels_flipped = flipped - frame_flipped_start;
+
+    history_head = (history_head + 1) % PERF_HISTORY;
+    if (history_count < PERF_HISTORY) history_count++;
+
+    for (int i = 0; i < window_slots; i++) {
+        PerfWindow *w = &windows[i];
+        if (w->frame_cycles == 0) continue;
+        w->avg_cycles = w->avg_cycles ? w->avg_cycles - w->avg_cycles / 8 + w->frame_cycles / 8
+                                      : w->frame_cycles;
+        w->last_tick = tick;
+    }
+
+    // Refresh the numbers shown by the overlay a few times a second
+    if (hud_visible && tick - hud_summary_tick >= 15) {
+        perf_get_summary(&hud_summary);
+        hud_irq_refresh();
+        hud_summary_tick = tick;
+    }
+}
+
+void perf_get_summary(PerfSummary *out) {
+    static uint64_t sorted[PERF_HISTORY];
+    int n = history_count;
+    uint32_t now = wm_get_ticks();
+
+    out->frames = n;
+    out->fps = 0;
+    out->p50_cycles = out->p99_cycles = out->max_cycles = 0;
+    out->avg_pixels_written = out->avg_bytes_flipped = 0;
+    for (int s = 0; s < PERF_STAGE_COUNT; s++) out->avg_stage_cycles[s] = 0;
+    if (n == 0) return;
+
+    uint64_t stage_sum[PERF_STAGE_COUNT] = {0};
+    uint64_t written_sum = 0, flipped_sum = 0;
+    for (int i = 0; i < n; i++) {
+        PerfFrame *f = &history[i];
+        if (now - f->tick < 60) out->fps++;
+        for (int s = 0; s < PERF_STAGE_COUNT; s++) stage_sum[s] += f->stage_cycles[s];
+        written_sum += f->pixels_written;
+        flipped_sum += f->pixels_flipped;
+
+        // Insertion sort - the history is small
+        int j = i;
+        while (j > 0 && sorted[j - 1] > f->cycles) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = f->cycles;
+    }
+
+    out->p50_cycles = sorted[n / 2];
+    out->p99_cycles = sorted[(n * 99) / 100 < n ? (n * 99) / 100 : n - 1];
+    out->max_cycles = sorted[n - 1];
+    for (int s = 0; s < PERF_STAGE_COUNT; s++) out->avg_stage_cycles[s] = stage_sum[s] / n;
+    out->avg_pixels_written = written_sum / n;
+    out->avg_bytes_flipped = flipped_sum * 4 / n;
+}
+
+void perf_reset(void) {
+    history_head = 0;
+    history_count = 0;
+    window_slots = 0;
+    hud_summary_tick = 0;
+    perf_get_summary(&hud_summary);
+}
+
+// --- Formatting ---
+
+static char *append_str(char *p, const char *s) {
+    while (*s) *p++ = *s++;
+    *p = 0;
+    return p;
+}
+
+static char *append_u64(char *p, uint64_t v) {
+    char tmp[21];
+    int n = 0;
+    do {
+        tmp[n++] = '0' + (v % 10);
+        v /= 10;
+    } while (v);
+    while (n) *p++ = tmp[--n];
+    *p = 0;
+    return p;
+}
+
+// Cycles as microseconds
+static char *append_time(char *p, uint64_t cycles) {
+    p = append_u64(p, clock_cycles_to_us(cycles));
+    return append_str(p, "us");
+}
+
+bool perf_dump_csv(const char *path) {
+    int row_max = 160;
+    char *buf = (char *)kmalloc((PERF_HISTORY + 1) * row_max);
+    if (!buf) return false;
+
+    char *p = append_str(buf, "frame,tick,cycles,background_cycles,windows_cycles,flip_cycles,"
+                              "pixels_written,bytes_flipped,us\n");
+    int first = (history_head - history_count + PERF_HISTORY) % PERF_HISTORY;
+    for (int i = 0; i < history_count; i++) {
+        PerfFrame *f = &history[(first + i) % PERF_HISTORY];
+        p = append_u64(p, i);                                   p = append_str(p, ",");
+        p = append_u64(p, f->tick);                             p = append_str(p, ",");
+        p = append_u64(p, f->cycles);                           p = append_str(p, ",");
+        p = append_u64(p, f->stage_cycles[PERF_STAGE_BACKGROUND]); p = append_str(p, ",");
+        p = append_u64(p, f->stage_cycles[PERF_STAGE_WINDOWS]); p = append_str(p, ",");
+        p = append_u64(p, f->stage_cycles[PERF_STAGE_FLIP]);    p = append_str(p, ",");
+        p = append_u64(p, f->pixels_written);                   p = append_str(p, ",");
+        p = append_u64(p, f->pixels_flipped * 4);               p = append_str(p, ",");
+        p = append_u64(p, clock_cycles_to_us(f->cycles));        p = append_str(p, "\n");
+    }
+
+    FAT32_FileHandle *fh = fat32_open(path, "w");
+    if (!fh) {
+        kfree(buf);
+        return false;
+    }
+    int len = (int)(p - buf);
+    bool ok = fat32_write(fh, buf, len) == len;
+    fat32_close(fh);
+    kfree(buf);
+    return ok;
+}
+
+// --- HUD ---
+
+void perf_hud_set_visible(bool visible) {
+    hud_visible = visible;
+    if (visible) {
+        perf_get_summary(&hud_summary);
+        hud_irq_ns = 0;
+        hud_irq_rate = 0;
+        hud_irq_refresh();
+        hud_summary_tick = wm_get_ticks();
+    }
+}
+
+bool perf_hud_visible(void) {
+    return hud_visible;
+}
+
+void perf_hud_rect(int *x, int *y, int *w, int *h) {
+    *w = HUD_W;
+    *h = HUD_LINES * HUD_LINE_H + 6;
+    *x = get_screen_width() - HUD_W - 4;
+    *y = 4;
+}
+
+void perf_hud_draw(void) {
+    if (!hud_visible) return;
+    int x, y, w, h;
+    perf_hud_rect(&x, &y, &w, &h);
+    draw_rect(x, y, w, h, COLOR_BLACK);
+
+    PerfSummary *s = &hud_summary;
+    char line[64];
+    char *p;
+    int ty = y + 4;
+
+    p = append_str(line, "FPS ");
+    p = append_u64(p, s->fps);
+    p = append_str(p, "  frames ");
+    append_u64(p, s->frames);
+    draw_string(x + 4, ty, line, COLOR_WHITE);
+    ty += HUD_LINE_H;
+
+    p = append_str(line, "p50 ");
+    p = append_time(p, s->p50_cycles);
+    p = append_str(p, " p99 ");
+    p = append_time(p, s->p99_cycles);
+    p = append_str(p, " max ");
+    append_time(p, s->max_cycles);
+    draw_string(x + 4, ty, line, COLOR_WHITE);
+    ty += HUD_LINE_H;
+
+    p = append_str(line, "bg ");
+    p = append_time(p, s->avg_stage_cycles[PERF_STAGE_BACKGROUND]);
+    p = append_str(p, " win ");
+    p = append_time(p, s->avg_stage_cycles[PERF_STAGE_WINDOWS]);
+    p = append_str(p, " flip ");
+    append_time(p, s->avg_stage_cycles[PERF_STAGE_FLIP]);
+    draw_string(x + 4, ty, line, COLOR_LTGRAY);
+    ty += HUD_LINE_H;
+
+    p = append_str(line, "px ");
+    p = append_u64(p, s->avg_pixels_written);
+    p = append_str(p, " flip ");
+    p = append_u64(p, s->avg_bytes_flipped / 1024);
+    append_str(p, "KB /frame");
+    draw_string(x + 4, ty, line, COLOR_LTGRAY);
+    ty += HUD_LINE_H;
+
+    // Worst cases since the last refresh
+    p = append_str(line, "irq ");
+    p = append_u64(p, hud_irq_rate);
+    p = append_str(p, "/s hmax ");
+    append_time(p, hud_peak_handler);
+    draw_string(x + 4, ty, line, COLOR_LTGRAY);
+    ty += HUD_LINE_H;
+
+    p = append_str(line, "irqoff ");
+    p = append_time(p, hud_peak_irqoff);
+    p = append_str(p, " late ");
+    p = append_u64(p, hud_peak_latency / CLOCK_NS_PER_US);
+    append_str(p, "us");
+    draw_string(x + 4, ty, line, COLOR_LTGRAY);
+    ty += HUD_LINE_H + 2;
+
+    // Windows painted during the last second, with their average paint cost
+    uint32_t now = wm_get_ticks();
+    int shown = 0;
+    for (int i = 0; i < window_slots && shown < HUD_LINES - 6; i++) {
+        PerfWindow *win = &windows[i];
+        if (now - win->last_tick >= 60 || !win->name) continue;
+        p = line;
+        for (int k = 0; k < 18 && win->name[k]; k++) *p++ = win->name[k];
+        *p = 0;
+        while (p - line < 20) *p++ = ' ';
+        append_time(p, win->avg_cycles);
+        draw_string(x + 4, ty, line, COLOR_APPLE_YELLOW);
+        ty += HUD_LINE_H;
+        shown++;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Rendering performance counters. Every repaint done by the frame timer is one
+// frame; the window manager reports how many TSC cycles (clock_cycles()) each
+// stage of it took.
+
+#define PERF_HISTORY 256        // Frames kept for percentiles and CSV dumps
+#define PERF_MAX_WINDOWS 16
+
+typedef enum {
+    PERF_STAGE_BACKGROUND,
+    PERF_STAGE_WINDOWS,
+    PERF_STAGE_FLIP,
+    PERF_STAGE_COUNT
+} PerfStage;
+
+typedef struct {
+    uint32_t tick;              // wm_get_ticks() when the frame finished
+    uint64_t cycles;            // Whole frame
+    uint64_t stage_cycles[PERF_STAGE_COUNT];
+    uint64_t pixels_written;
+    uint64_t pixels_flipped;
+} PerfFrame;
+
+typedef struct {
+    uint32_t frames;            // Frames in the history
+    uint32_t fps;               // Frames finished in the last second
+    uint64_t p50_cycles;
+    uint64_t p99_cycles;
+    uint64_t max_cycles;
+    uint64_t avg_stage_cycles[PERF_STAGE_COUNT];
+    uint64_t avg_pixels_written;
+    uint64_t avg_bytes_flipped;
+} PerfSummary;
+
+// Frame bracketing (called by the window manager from the timer tick)
+void perf_frame_begin(void);
+void perf_frame_end(void);
+void perf_stage_add(PerfStage stage, uint64_t cycles);
+void perf_window_add(const char *name, uint64_t cycles);
+
+// Results
+void perf_get_summary(PerfSummary *out);
+void perf_reset(void);
+bool perf_dump_csv(const char *path);
+
+// On-screen overlay
+void perf_hud_set_visible(bool visible);
+bool perf_hud_visible(void);
+void perf_hud_rect(int *x, int *y, int *w, int *h);
+void perf_hud_draw(void);
+
+#endif
@@ -0,0 +1,195 @@
+#include "profiler.h"
+#include "ksyms.h"
+#include "clock.h"
+#include "timer.h"
+#include "thread.h"
+#include "smp.h"
+#include "memory_manager.h"
+#include <stddef.h>
+
+typedef struct {
+    ProfSample *samples;
+    uint32_t head;              // Next slot to write
+    uint32_t count;
+    uint64_t overwritten;
+} ProfRing;
+
+static ProfRing rings[SMP_MAX_CPUS];
+static volatile bool running = false;
+static volatile bool reading = false;   // A report is walking the rings
+static bool callchains = false;
+static uint64_t period_ns = 0;
+static uint64_t next_sample_ns = 0;
+static Timer sample_timer;
+
+// Only here to make sure the timer interrupt comes round at the sample rate
+static void sample_timer_fn(void *arg) {
+    (void)arg;
+    if (running) timer_start(&sample_timer, next_sample_ns, sample_timer_fn, NULL);
+}
+
+bool profiler_has_frame_pointers(void) {
+#ifdef KERNEL_FRAME_POINTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef KERNEL_FRAME_POINTERS
+// Follow saved RBPs up the interrupted stack. Frames must stay inside the
+// stack the interrupt arrived on and move strictly upwards.
+static int walk_frames(uint64_t rbp, uint64_t rsp, uint64_t *out) {
+    uint64_t top = rsp + THREAD_STACK_SIZE;
+    int n = 0;
+    while (n < PROFILER_MAX_DEPTH && rbp >= rsp && rbp + 16 <= top && !(rbp & 7)) {
+        const uint64_t *fp = (const uint64_t *)rbp;
+        out[n++] = fp[1];
+        if (fp[0] <= rbp) break;
+        rbp = fp[0];
+    }
+    return n;
+}
+#endif
+
+void profiler_tick(const IrqFrame *frame) {
+    if (!running || reading) return;
+    uint64_t now = clock_monotonic_ns();
+    if (now < next_sample_ns) return;
+    next_sample_ns += period_ns;
+    if (next_sample_ns <= now) next_sample_ns = now + period_ns;
+
+    ProfRing *ring = &rings[this_cpu()->id];
+    if (!ring->samples) return;
+
+    ProfSample *s = &ring->samples[ring->head];
+    s->rip = frame->rip;
+    s->depth = 0;
+#ifdef KERNEL_FRAME_POINTERS
+    if (callchains) s->depth = (uint8_t)walk_frames(frame->rbp, frame->rsp, s->callers);
+#endif
+
+    ring->head = (ring->head + 1) % PROFILER_RING_SIZE;
+    if (ring->count < PROFILER_RING_SIZE) {
+        ring->count++;
+    } else {
+        ring->overwritten++;
+    }
+}
+
+void profiler_clear(void) {
+    uint64_t flags = irq_save();
+    for (int i = 0; i < SMP_MAX_CPUS; i++) {
+        rings[i].head = 0;
+        rings[i].count = 0;
+        rings[i].overwritten = 0;
+    }
+    irq_restore(flags);
+}
+
+bool profiler_start(uint32_t hz, bool chains) {
+    profiler_stop();
+    if (hz == 0) hz = PROFILER_DEFAULT_HZ;
+    if (hz > PROFILER_MAX_HZ) hz = PROFILER_MAX_HZ;
+
+    for (int i = 0; i < smp_cpu_count() && i < SMP_MAX_CPUS; i++) {
+        if (rings[i].samples) continue;
+        rings[i].samples = (ProfSample *)kmalloc(sizeof(ProfSample) * PROFILER_RING_SIZE);
+        if (!rings[i].samples) return false;
+    }
+    profiler_clear();
+
+    callchains = chains;
+    period_ns = CLOCK_NS_PER_SEC / hz;
+    next_sample_ns = clock_monotonic_ns() + period_ns;
+    running = true;
+    timer_start(&sample_timer, next_sample_ns, sample_timer_fn, NULL);
+    return true;
+}
+
+void profiler_stop(void) {
+    running = false;
+    timer_cancel(&sample_timer);
+}
+
+bool profiler_running(void) {
+    return running;
+}
+
+uint32_t profiler_sample_count(void) {
+    uint32_t n = 0;
+    for (int i = 0; i < SMP_MAX_CPUS; i++) n += rings[i].count;
+    return n;
+}
+
+uint64_t profiler_overwritten(void) {
+    uint64_t n = 0;
+    for (int i = 0; i < SMP_MAX_CPUS; i++) n += rings[i].overwritten;
+    return n;
+}
+
+// --- Report ---
+
+int profiler_report(ProfHotspot *out, int max, bool by_total) {
+    int nsyms = ksyms_count();
+    int unknown = nsyms;            // Extra bucket for addresses outside the table
+    uint32_t *self = (uint32_t *)kmalloc(sizeof(uint32_t) * (nsyms + 1));
+    uint32_t *total = (uint32_t *)kmalloc(sizeof(uint32_t) * (nsyms + 1));
+    uint32_t *seen = (uint32_t *)kmalloc(sizeof(uint32_t) * (nsyms + 1));
+    if (!self || !total || !seen) {
+        kfree(self);
+        kfree(total);
+        kfree(seen);
+        return 0;
+    }
+    for (int i = 0; i <= nsyms; i++) self[i] = total[i] = seen[i] = 0;
+
+    // The timer interrupt skips sampling while we read; being on the same
+    // CPU, it can't be halfway through a sample when we start
+    reading = true;
+    uint32_t stamp = 0;
+    for (int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        ProfRing *ring = &rings[cpu];
+        for (uint32_t i = 0; i < ring->count; i++) {
+            const ProfSample *s = &ring->samples[i];
+            stamp++;
+
+            int sym = ksyms_find(s->rip);
+            if (sym < 0) sym = unknown;
+            self[sym]++;
+            total[sym]++;
+            seen[sym] = stamp;
+
+            // Recursion must not count a function twice in one sample
+            for (int d = 0; d < s->depth; d++) {
+                int caller = ksyms_find(s->callers[d]);
+                if (caller < 0) caller = unknown;
+                if (seen[caller] == stamp) continue;
+                seen[caller] = stamp;
+                total[caller]++;
+            }
+        }
+    }
+    reading = false;
+
+    // Selection of the top entries; max is small
+    uint32_t *key = by_total ? total : self;
+    int n = 0;
+    while (n < max) {
+        int best = -1;
+        for (int i = 0; i <= nsyms; i++) {
+            if (key[i] && (best < 0 || key[i] > key[best])) best = i;
+        }
+        if (best < 0) break;
+        out[n].symbol = best == unknown ? -1 : best;
+        out[n].self = self[best];
+        out[n].total = total[best];
+        key[best] = 0;
+        n++;
+    }
+
+    kfree(self);
+    kfree(total);
+    kfree(seen);
+    return n;
+}
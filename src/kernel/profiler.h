@@ -0,0 +1,52 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "idt.h"
+
+// Sampling profiler. While it runs, the timer interrupt records the code
+// address it interrupted, at the chosen rate, into a ring buffer belonging to
+// the CPU it interrupted. With call chains on it also records the return
+// addresses found by walking the frame-pointer chain, which needs a kernel
+// built with PROFILE=1 (-fno-omit-frame-pointer). Addresses are resolved
+// through the link-time symbol table (ksyms.h) only when a report is built.
+//
+// Only the bootstrap processor takes timer interrupts, so that is where all
+// samples come from.
+
+#define PROFILER_RING_SIZE 8192     // Per CPU; the oldest samples are overwritten
+#define PROFILER_MAX_DEPTH 6
+#define PROFILER_DEFAULT_HZ 1000
+#define PROFILER_MAX_HZ 1000        // One sample per timer wheel tick
+
+typedef struct {
+    uint64_t rip;
+    uint64_t callers[PROFILER_MAX_DEPTH];
+    uint8_t depth;
+} ProfSample;
+
+typedef struct {
+    int symbol;                 // ksyms index, -1 if unknown
+    uint32_t self;              // Samples inside the function itself
+    uint32_t total;             // Samples with the function anywhere on the chain
+} ProfHotspot;
+
+// Discards the previous recording; false if the rings can't be allocated
+bool profiler_start(uint32_t hz, bool callchains);
+void profiler_stop(void);
+bool profiler_running(void);
+void profiler_clear(void);
+bool profiler_has_frame_pointers(void);
+
+uint32_t profiler_sample_count(void);   // Held in the rings right now
+uint64_t profiler_overwritten(void);
+
+// Hottest functions, sorted by self samples (or by total with by_total).
+// Returns the number of entries written.
+int profiler_report(ProfHotspot *out, int max, bool by_total);
+
+// Called from the timer interrupt with the interrupted registers
+void profiler_tick(const IrqFrame *frame);
+
+#endif
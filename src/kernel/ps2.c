@@ -1,17 +1,20 @@
 #include "ps2.h"
 #include "io.h"
+#include "idt.h"
 #include "wm.h"
-#include "network.h"
+#include "timer.h"
+#include "workqueue.h"
+#include "profiler.h"
 #include <stdbool.h>
 
 extern void serial_print(const char *s);
 extern void serial_print_hex(uint64_t n);
 
 // --- Timer Handler ---
-void timer_handler(void) {
-    wm_timer_tick();
-    network_process_frames();
-    outb(0x20, 0x20); // EOI to Master PIC
+void timer_handler(IrqFrame *frame) {
+    profiler_tick(frame);
+    timer_interrupt();
+    irq_eoi(0);
 }
 
 // --- Keyboard ---
@@ -40,7 +43,7 @@ void keyboard_handler(void) {
 
     if (scancode == 0xE0) {
         extended_scancode = true;
-        outb(0x20, 0x20);
+        irq_eoi(1);
         return;
     }
 
@@ -70,13 +73,46 @@ void keyboard_handler(void) {
         extended_scancode = false;
     }
 
-    outb(0x20, 0x20); // EOI
+    irq_eoi(1);
 }
 
 // --- Mouse ---
 static uint8_t mouse_cycle = 0;
 static int8_t mouse_byte[3];
 
+// Complete packets wait here for the worker thread; moving windows around is
+// too much for the interrupt handler
+#define MOUSE_QUEUE_SIZE 64
+
+typedef struct {
+    int8_t dx;
+    int8_t dy;
+    uint8_t buttons;
+} MousePacket;
+
+static MousePacket mouse_queue[MOUSE_QUEUE_SIZE];
+static volatile int mouse_head = 0;
+static volatile int mouse_tail = 0;
+
+// Runs of packets with the same buttons are merged into one move
+static void mouse_work_fn(void *arg) {
+    (void)arg;
+    while (mouse_tail != mouse_head) {
+        MousePacket p = mouse_queue[mouse_tail];
+        int dx = p.dx;
+        int dy = p.dy;
+        mouse_tail = (mouse_tail + 1) % MOUSE_QUEUE_SIZE;
+        while (mouse_tail != mouse_head && mouse_queue[mouse_tail].buttons == p.buttons) {
+            dx += mouse_queue[mouse_tail].dx;
+            dy += mouse_queue[mouse_tail].dy;
+            mouse_tail = (mouse_tail + 1) % MOUSE_QUEUE_SIZE;
+        }
+        wm_handle_mouse(dx, -dy, p.buttons);
+    }
+}
+
+static WorkItem mouse_work = WORK_INIT(mouse_work_fn, NULL);
+
 void mouse_wait(uint8_t type) {
     uint32_t timeout = 100000;
     if (type == 0) { // Write
@@ -131,8 +167,7 @@ void mouse_init(void) {
 void mouse_handler(void) {
     uint8_t status = inb(0x64);
     if (!(status & 0x20)) {
-        outb(0x20, 0x20);
-        outb(0xA0, 0x20);
+        irq_eoi(12);
         return;
     }
 
@@ -156,12 +191,18 @@ void mouse_handler(void) {
         int8_t dx = mouse_byte[1];
         int8_t dy = mouse_byte[2]; 
         
-        // Send to WM
-        wm_handle_mouse(dx, -dy, mouse_byte[0] & 0x07);
+        // Hand to the WM; a full queue drops the packet
+        int next = (mouse_head + 1) % MOUSE_QUEUE_SIZE;
+        if (next != mouse_tail) {
+            mouse_queue[mouse_head].dx = dx;
+            mouse_queue[mouse_head].dy = dy;
+            mouse_queue[mouse_head].buttons = mouse_byte[0] & 0x07;
+            mouse_head = next;
+        }
+        work_queue(&mouse_work);
     }
 
-    outb(0x20, 0x20);
-    outb(0xA0, 0x20); // Slave EOI
+    irq_eoi(12);
 }
 
 void ps2_init(void) {
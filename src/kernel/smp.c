@@ -0,0 +1,139 @@
+#include "smp.h"
+#include "limine.h"
+#include "apic.h"
+#include "idt.h"
+#include "clock.h"
+#include "io.h"
+#include <stddef.h>
+
+__attribute__((used, section(".requests")))
+static volatile struct limine_smp_request smp_request = {
+    .id = LIMINE_SMP_REQUEST,
+    .revision = 0,
+    .response = NULL,
+    .flags = 0
+};
+
+#define IA32_GS_BASE_MSR 0xC0000101
+#define AP_START_TIMEOUT_MS 100
+
+static PerCpu cpus[SMP_MAX_CPUS];
+static int cpu_count = 1;
+static uint8_t ap_stacks[SMP_MAX_CPUS][SMP_STACK_SIZE] __attribute__((aligned(16)));
+
+static void percpu_load(PerCpu *cpu, uint64_t stack_top) {
+    gdt_init_cpu(&cpu->gdt, &cpu->tss, stack_top);
+    wrmsr(IA32_GS_BASE_MSR, (uint64_t)cpu);
+}
+
+void smp_init_bsp(void) {
+    uint32_t eax, ebx, ecx, edx;
+    asm volatile ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+
+    PerCpu *bsp = &cpus[0];
+    bsp->self = bsp;
+    bsp->id = 0;
+    bsp->lapic_id = ebx >> 24;
+
+    // The BSP keeps running on the stack Limine gave it
+    uint64_t rsp;
+    asm volatile ("mov %%rsp, %0" : "=r"(rsp));
+    percpu_load(bsp, rsp);
+    bsp->online = true;
+}
+
+__attribute__((noreturn)) static void ap_main(PerCpu *cpu) {
+    percpu_load(cpu, (uint64_t)&ap_stacks[cpu->id][SMP_STACK_SIZE]);
+    idt_load_ap();
+    apic_init_ap();
+
+    __atomic_store_n(&cpu->online, true, __ATOMIC_RELEASE);
+    for (;;) {
+        asm volatile ("sti; hlt");
+    }
+}
+
+// Limine enters here on a stack of its own; move to ours straight away
+__attribute__((noreturn)) static void ap_entry(struct limine_smp_info *info) {
+    PerCpu *cpu = (PerCpu *)info->extra_argument;
+    uint64_t top = (uint64_t)&ap_stacks[cpu->id][SMP_STACK_SIZE] - 8;  // As if called
+    asm volatile (
+        "mov %0, %%rsp\n\t"
+        "xor %%ebp, %%ebp\n\t"
+        "jmp *%1"
+        : : "r"(top), "r"(ap_main), "D"(cpu) : "memory");
+    __builtin_unreachable();
+}
+
+void smp_start_aps(void) {
+    struct limine_smp_response *resp = smp_request.response;
+    // IPIs and the AP's local APIC need the APIC path
+    if (!resp || !apic_enabled()) return;
+
+    for (uint64_t i = 0; i < resp->cpu_count && cpu_count < SMP_MAX_CPUS; i++) {
+        struct limine_smp_info *info = resp->cpus[i];
+        if (info->lapic_id == resp->bsp_lapic_id) continue;
+
+        PerCpu *cpu = &cpus[cpu_count];
+        cpu->self = cpu;
+        cpu->id = cpu_count;
+        cpu->lapic_id = info->lapic_id;
+        cpu->online = false;
+        info->extra_argument = (uint64_t)cpu;
+        __atomic_store_n(&info->goto_address, ap_entry, __ATOMIC_SEQ_CST);
+
+        uint64_t deadline = clock_monotonic_ns() + AP_START_TIMEOUT_MS * CLOCK_NS_PER_MS;
+        while (!__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE) && clock_monotonic_ns() < deadline) {
+            asm volatile ("pause");
+        }
+        if (cpu->online) cpu_count++;
+    }
+}
+
+int smp_cpu_count(void) {
+    return cpu_count;
+}
+
+PerCpu *smp_cpu(int id) {
+    if (id < 0 || id >= cpu_count) return NULL;
+    return &cpus[id];
+}
+
+bool smp_call(int id, SmpCallFn fn, void *arg, bool wait) {
+    PerCpu *cpu = smp_cpu(id);
+    if (!cpu || !cpu->online) return false;
+
+    if (cpu == this_cpu()) {
+        fn(arg);
+        return true;
+    }
+
+    spin_lock(&cpu->call_lock);
+    uint64_t seq = ++cpu->calls_sent;
+    cpu->call_arg = arg;
+    __atomic_store_n(&cpu->call_fn, fn, __ATOMIC_RELEASE);
+    apic_send_ipi((uint8_t)cpu->lapic_id, IPI_CALL_VECTOR);
+
+    // The mailbox is free again once the target has taken the call
+    while (__atomic_load_n(&cpu->call_fn, __ATOMIC_ACQUIRE)) asm volatile ("pause");
+    spin_unlock(&cpu->call_lock);
+
+    // Calls run in order on the target, so this one is done once the
+    // handled count reaches it
+    if (wait) {
+        while (__atomic_load_n(&cpu->calls_handled, __ATOMIC_ACQUIRE) < seq) asm volatile ("pause");
+    }
+    return true;
+}
+
+void smp_call_handler(void) {
+    PerCpu *cpu = this_cpu();
+    SmpCallFn fn = __atomic_load_n(&cpu->call_fn, __ATOMIC_ACQUIRE);
+    if (fn) {
+        void *arg = cpu->call_arg;
+        __atomic_store_n(&cpu->call_fn, NULL, __ATOMIC_RELEASE);
+        fn(arg);
+        __atomic_store_n(&cpu->calls_handled, cpu->calls_handled + 1, __ATOMIC_RELEASE);
+    }
+    apic_eoi();
+}
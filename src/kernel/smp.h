@@ -0,0 +1,57 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gdt.h"
+#include "spinlock.h"
+
+// Application processors are started through the Limine SMP request. Each
+// CPU has a PerCpu area reachable through its GS base; the IDT is shared.
+
+#define SMP_MAX_CPUS 16
+#define SMP_STACK_SIZE (16 * 1024)
+#define IPI_CALL_VECTOR 0xF0
+
+typedef void (*SmpCallFn)(void *arg);
+
+typedef struct PerCpu {
+    struct PerCpu *self;        // Must stay first: this_cpu() reads %gs:0
+    int id;                     // 0 is the bootstrap processor
+    uint32_t lapic_id;
+    volatile bool online;
+    Gdt gdt;
+    Tss tss;
+
+    // smp_call() mailbox
+    Spinlock call_lock;
+    volatile SmpCallFn call_fn;
+    void *volatile call_arg;
+    uint64_t calls_sent;
+    volatile uint64_t calls_handled;
+} PerCpu;
+
+static inline PerCpu *this_cpu(void) {
+    PerCpu *cpu;
+    asm volatile ("mov %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+// Give the bootstrap processor its GDT and per-CPU area. Must run before the
+// IDT gates are registered (the kernel code selector changes).
+void smp_init_bsp(void);
+// Start the other CPUs; they idle until given work
+void smp_start_aps(void);
+
+int smp_cpu_count(void);        // CPUs online, the BSP included
+PerCpu *smp_cpu(int id);
+
+// Run fn(arg) on the given CPU from its IPI handler. With wait, returns once
+// fn has finished; otherwise once the target has picked it up. Returns false
+// if the CPU isn't online.
+bool smp_call(int cpu, SmpCallFn fn, void *arg, bool wait);
+
+// IPI_CALL_VECTOR handler
+void smp_call_handler(void);
+
+#endif
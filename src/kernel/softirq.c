@@ -0,0 +1,72 @@
+#include "softirq.h"
+#include "workqueue.h"
+#include "thread.h"
+#include "smp.h"
+#include "io.h"
+#include "idt.h"
+#include "trace.h"
+#include "irqstat.h"
+#include <stddef.h>
+
+static SoftirqHandler handlers[SOFTIRQ_COUNT];
+static const char *const names[SOFTIRQ_COUNT] = { "timer_softirq", "net_rx_softirq" };
+static volatile uint32_t pending = 0;
+static bool running = false;
+
+static void softirq_overflow(void *arg);
+static WorkItem overflow_work = WORK_INIT(softirq_overflow, NULL);
+
+void softirq_register(int nr, SoftirqHandler handler) {
+    handlers[nr] = handler;
+}
+
+void softirq_raise(int nr) {
+    __atomic_or_fetch(&pending, 1u << nr, __ATOMIC_RELAXED);
+}
+
+void softirq_run(void) {
+    // A nested interrupt leaves what it raised to the run it interrupted
+    if (running || !pending || this_cpu()->id != 0) return;
+    running = true;
+    preempt_disable();
+
+    for (int pass = 0; pending && pass < SOFTIRQ_MAX_RESTART; pass++) {
+        uint32_t bits = __atomic_exchange_n(&pending, 0, __ATOMIC_RELAXED);
+        asm volatile ("sti" ::: "memory");
+        while (bits) {
+            int nr = __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (!handlers[nr]) continue;
+            TRACE_BEGIN(TRACE_CAT_IRQ, names[nr], nr);
+            handlers[nr]();
+            TRACE_END(TRACE_CAT_IRQ, names[nr], nr);
+        }
+        asm volatile ("cli" ::: "memory");
+    }
+
+    preempt_enable();
+    running = false;
+    if (pending) work_queue(&overflow_work);
+}
+
+static void softirq_overflow(void *arg) {
+    (void)arg;
+    uint64_t flags = irq_save();
+    softirq_run();
+    irq_restore(flags);
+}
+
+void irq_enter(uint8_t vector) {
+    irqstat_handler_enter(vector);
+    TRACE_BEGIN(TRACE_CAT_IRQ, irq_vector_name(vector), vector);
+}
+
+void irq_exit(uint8_t vector) {
+    TRACE_END(TRACE_CAT_IRQ, irq_vector_name(vector), vector);
+    irqstat_handler_exit(vector);
+    softirq_run();
+    sched_irq_exit();
+    // iretq enables interrupts. This may be another thread than the one that
+    // was interrupted, resuming in the middle of a section it never closed.
+    irqoff_end();
+}
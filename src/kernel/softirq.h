@@ -0,0 +1,38 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Softirqs: the bottom half of an interrupt. A handler acknowledges its
+// hardware, raises a softirq and returns; the softirq runs on the way out of
+// the outermost interrupt, after the EOI, with interrupts enabled and
+// preemption off. Each softirq is a bit in a pending mask, so raising one
+// that is already pending costs nothing and bursts are batched into one run.
+// Softirqs never block; anything that may sleep or take long goes on a work
+// queue instead (workqueue.h). Bootstrap processor only.
+
+#define SOFTIRQ_TIMER   0
+#define SOFTIRQ_NET_RX  1
+#define SOFTIRQ_COUNT   2
+
+// Passes over the pending mask per interrupt exit. Whatever is raised again
+// after that is finished by the worker thread so interrupts can't starve
+// the threads.
+#define SOFTIRQ_MAX_RESTART 10
+
+typedef void (*SoftirqHandler)(void);
+
+void softirq_register(int nr, SoftirqHandler handler);
+void softirq_raise(int nr);
+
+// Run pending softirqs. Interrupts must be disabled; they are disabled again
+// on return.
+void softirq_run(void);
+
+// Called by the ISR wrappers around the handler. irq_exit() runs softirqs,
+// then lets the scheduler switch threads.
+void irq_enter(uint8_t vector);
+void irq_exit(uint8_t vector);
+
+#endif
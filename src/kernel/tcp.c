@@ -1,176 +1,700 @@
 #include "net_defs.h"
 #include "cmd.h"
 #include "memory_manager.h"
+#include "clock.h"
+#include "thread.h"
+#include "wait.h"
+#include "timer.h"
+#include "tcp_cong.h"
+
+#define TCP_CONNECT_TIMEOUT_MS 3000
+#define TCP_SEND_TIMEOUT_MS 10000       // Waiting for room in the send buffer
+#define TCP_CLOSE_TIMEOUT_MS 2000       // Waiting for our FIN to be acknowledged
+#define TCP_MSS 1460                    // Ethernet MTU less the IP and TCP headers
+#define TCP_RX_BUFFER_SIZE 65536        // Power of two
+#define TCP_OOO_MAX 8                   // Out-of-order ranges held per connection
+#define TCP_TX_BUFFER_SIZE 65536        // Power of two
+#define TCP_WINDOW_MAX 65535            // No window scaling
+#define TCP_HASH_BUCKETS 64             // Power of two
+#define TCP_EPHEMERAL_FIRST 49152       // IANA dynamic port range
+#define TCP_EPHEMERAL_LAST 65535
+
+// Retransmission timer (RFC 6298). RFC 6298 puts the floor at 1 s but only as
+// a SHOULD; on a LAN that is hundreds of round trips, so it is lower here.
+#define TCP_RTO_INITIAL_US 1000000
+#define TCP_RTO_MIN_US 200000
+#define TCP_RTO_MAX_US 60000000
+#define TCP_CLOCK_GRANULARITY_US 1000   // TIMER_TICK_NS
+#define TCP_MAX_BACKOFFS 8              // Consecutive timeouts before giving up
+#define TCP_DUPACK_THRESHOLD 3          // RFC 5681 fast retransmit
 
 // Simplified TCP State
 typedef enum {
     TCP_CLOSED,
     TCP_SYN_SENT,
     TCP_ESTABLISHED,
-    TCP_FIN_WAIT
+    TCP_FIN_WAIT                        // A FIN is queued or sent
 } tcp_state_enum;
 
+// One per connection
 struct tcp_socket_t {
+    struct tcp_socket_t *hash_next;     // Connection table chain
+    ipv4_address_t local_ip;
     ipv4_address_t remote_ip;
-    uint16_t remote_port;
     uint16_t local_port;
-    uint32_t seq_num;
-    uint32_t ack_num;
+    uint16_t remote_port;
     tcp_state_enum state;
     
-    // Receive Buffer
+    // Send side. The buffer holds everything from snd_una on: bytes in
+    // flight, then bytes not sent yet.
+    uint8_t *tx_buffer;
+    uint32_t tx_start;                  // Index of the byte at snd_una
+    uint32_t tx_len;
+    uint32_t iss;                       // Initial send sequence number
+    uint32_t snd_una;                   // Oldest unacknowledged
+    uint32_t snd_nxt;                   // Next to send; goes back on a timeout
+    uint32_t snd_max;                   // Highest ever sent
+    uint32_t snd_wnd;                   // Peer's receive window
+    const tcp_cong_ops_t *cong;
+    tcp_cong_t cc;
+    bool in_recovery;                   // NewReno fast recovery (RFC 6582)
+    uint32_t recover;                   // snd_max when recovery started
+    bool fin_queued;
+    bool fin_acked;
+    int dupacks;
+    
+    // Round-trip time (RFC 6298). One segment at a time is timed, and never
+    // a retransmitted one (Karn's algorithm).
+    uint32_t srtt_us;                   // 0 until the first sample
+    uint32_t rttvar_us;
+    uint32_t rto_us;
+    uint32_t rtt_seq;                   // Sample taken when this is acked
+    uint64_t rtt_start_ns;              // 0 when nothing is being timed
+    int backoffs;
+    Timer rtx_timer;                    // Retransmission and persist timer
+    bool persisting;                    // Timer is probing a zero window
+    uint32_t persist_us;                // Probe interval, backed off per probe
+    
+    // Receive side. The buffer is a ring: rx_len bytes of in-order data
+    // from rx_start for tcp_read, then room for the window. Out-of-order
+    // segments are written straight to their place in the window and their
+    // ranges kept, sorted and merged, until the gap before them fills.
+    uint32_t rcv_nxt;
+    uint32_t rcv_adv;                   // Right edge of the last advertised window
+    bool peer_fin;
+    bool fin_pending;                   // FIN seen, data before it still missing
+    uint32_t fin_seq;
     uint8_t *rx_buffer;
-    int rx_size;
-    int rx_pos;
+    uint32_t rx_start;
+    uint32_t rx_len;
+    struct { uint32_t start, end; } ooo[TCP_OOO_MAX];
+    int ooo_count;
     bool connected;
+    WaitQueue wait;                     // Woken on connect, data, acks and remote close
+    
+    uint32_t retransmits;
+    uint32_t fast_retransmits;
+    uint32_t timeouts;
+    uint32_t probes;
 };
 
-static tcp_socket_t *active_socket = NULL; // Single socket support for simplicity
+// Totals over every connection, including closed ones
+static uint32_t total_retransmits;
+static uint32_t total_fast_retransmits;
+static uint32_t total_timeouts;
 
-// Pseudo Header for Checksum
-typedef struct {
-    uint32_t src_ip;
-    uint32_t dst_ip;
-    uint8_t reserved;
-    uint8_t protocol;
-    uint16_t tcp_len;
-} __attribute__((packed)) tcp_pseudo_header_t;
+// Connections hashed by their 4-tuple. Like the rest of the stack the table
+// is protected by disabling interrupts: segments arrive from the RX softirq,
+// which can also run in the softirq worker thread, so connection lookup,
+// segment handling and unhashing all happen with interrupts off.
+static tcp_socket_t *tcp_table[TCP_HASH_BUCKETS];
+static uint32_t ephemeral_next;
+static bool ephemeral_seeded = false;
 
-static uint16_t tcp_checksum(tcp_socket_t *sock, tcp_header_t *tcp, const void *data, uint16_t len) {
-    uint32_t sum = 0;
-    
-    // Pseudo Header
-    ipv4_address_t local = get_local_ip();
-    tcp_pseudo_header_t ph;
-    ph.src_ip = *(uint32_t*)local.bytes;
-    ph.dst_ip = *(uint32_t*)sock->remote_ip.bytes;
-    ph.reserved = 0;
-    ph.protocol = IP_PROTO_TCP;
-    ph.tcp_len = htons(sizeof(tcp_header_t) + len);
-    
-    uint16_t *p = (uint16_t*)&ph;
-    for(int i=0; i<sizeof(tcp_pseudo_header_t)/2; i++) sum += p[i];
-    
-    // TCP Header + Data
-    p = (uint16_t*)tcp;
-    for(int i=0; i<sizeof(tcp_header_t)/2; i++) sum += p[i];
-    
-    p = (uint16_t*)data;
-    int dlen = len;
-    while(dlen > 1) {
-        sum += *p++;
-        dlen -= 2;
+static uint32_t ip_word(ipv4_address_t ip) {
+    return ((uint32_t)ip.bytes[0] << 24) | ((uint32_t)ip.bytes[1] << 16) | ((uint32_t)ip.bytes[2] << 8) | ip.bytes[3];
+}
+
+static uint32_t tcp_hash(ipv4_address_t local_ip, uint16_t local_port, ipv4_address_t remote_ip, uint16_t remote_port) {
+    uint32_t h = ip_word(local_ip) * 0x9E3779B1u;
+    h = (h ^ ip_word(remote_ip)) * 0x85EBCA6Bu;
+    h = (h ^ ((uint32_t)local_port << 16) ^ remote_port) * 0xC2B2AE35u;
+    return h ^ (h >> 16);
+}
+
+static tcp_socket_t **tcp_bucket(ipv4_address_t local_ip, uint16_t local_port, ipv4_address_t remote_ip, uint16_t remote_port) {
+    return &tcp_table[tcp_hash(local_ip, local_port, remote_ip, remote_port) & (TCP_HASH_BUCKETS - 1)];
+}
+
+static tcp_socket_t *tcp_lookup(ipv4_address_t local_ip, uint16_t local_port, ipv4_address_t remote_ip, uint16_t remote_port) {
+    for (tcp_socket_t *s = *tcp_bucket(local_ip, local_port, remote_ip, remote_port); s; s = s->hash_next) {
+        if (s->local_port == local_port && s->remote_port == remote_port &&
+            ip_word(s->local_ip) == ip_word(local_ip) && ip_word(s->remote_ip) == ip_word(remote_ip)) return s;
+    }
+    return NULL;
+}
+
+static void tcp_hash_insert(tcp_socket_t *sock) {
+    tcp_socket_t **bucket = tcp_bucket(sock->local_ip, sock->local_port, sock->remote_ip, sock->remote_port);
+    sock->hash_next = *bucket;
+    *bucket = sock;
+}
+
+static void tcp_hash_remove(tcp_socket_t *sock) {
+    tcp_socket_t **pp = tcp_bucket(sock->local_ip, sock->local_port, sock->remote_ip, sock->remote_port);
+    for (; *pp; pp = &(*pp)->hash_next) {
+        if (*pp == sock) {
+            *pp = sock->hash_next;
+            return;
+        }
+    }
+}
+
+// RFC 6056, algorithm 1 with a moving start: the first port in the dynamic
+// range that makes the 4-tuple unique. The same port can serve connections to
+// different peers. Returns 0 if every port is taken.
+static uint16_t tcp_ephemeral_port(ipv4_address_t local_ip, ipv4_address_t remote_ip, uint16_t remote_port) {
+    const uint32_t range = TCP_EPHEMERAL_LAST - TCP_EPHEMERAL_FIRST + 1;
+    if (!ephemeral_seeded) {
+        ephemeral_next = (uint32_t)(clock_cycles() % range);
+        ephemeral_seeded = true;
+    }
+    for (uint32_t i = 0; i < range; i++) {
+        uint16_t port = (uint16_t)(TCP_EPHEMERAL_FIRST + (ephemeral_next + i) % range);
+        if (!tcp_lookup(local_ip, port, remote_ip, remote_port)) {
+            ephemeral_next = (ephemeral_next + i + 1) % range;
+            return port;
+        }
     }
-    if(dlen) sum += *(uint8_t*)p;
+    return 0;
+}
+
+// RFC 6528: a clock ticking every 4 us or so, offset per 4-tuple so a new
+// connection doesn't pick up where an old one on the same ports left off
+static uint32_t tcp_initial_seq(const tcp_socket_t *sock) {
+    return (uint32_t)(clock_monotonic_ns() >> 12) +
+           tcp_hash(sock->local_ip, sock->local_port, sock->remote_ip, sock->remote_port);
+}
+
+
+// Sequence numbers wrap, so they compare by the sign of their difference
+static bool seq_lt(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+static bool seq_le(uint32_t a, uint32_t b) { return (int32_t)(a - b) <= 0; }
+
+static void tcp_destroy(tcp_socket_t *sock) {
+    uint64_t flags = irq_save();
+    tcp_hash_remove(sock);
+    timer_cancel(&sock->rtx_timer);
+    irq_restore(flags);
+    kfree(sock->tx_buffer);
+    kfree(sock->rx_buffer);
+    kfree(sock);
+}
+
+// A netbuf holding len bytes of the send buffer from seq on. The buffer is
+// circular, so the bytes can come in two pieces; the running payload sum
+// only carries over when the first piece has an even length.
+static netbuf_t *tcp_payload(tcp_socket_t *sock, uint32_t seq, uint16_t len) {
+    uint32_t off = (sock->tx_start + (seq - sock->snd_una)) & (TCP_TX_BUFFER_SIZE - 1);
+    uint32_t first = TCP_TX_BUFFER_SIZE - off;
+    if (first >= len) return network_netbuf_from(sock->tx_buffer + off, len);
     
-    while(sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
-    return (uint16_t)~sum;
+    netbuf_t *nb = network_netbuf_from(sock->tx_buffer + off, first);
+    if (!nb) return NULL;
+    uint32_t rest = len - first;
+    uint8_t *p = netbuf_put(nb, rest);
+    if ((nb->csum & NETBUF_CSUM_PARTIAL) && !(first & 1)) {
+        nb->sum = csum_partial_copy(p, sock->tx_buffer, rest, nb->sum);
+        nb->sum_len += (uint16_t)rest;
+    } else {
+        for (uint32_t i = 0; i < rest; i++) p[i] = sock->tx_buffer[i];
+        nb->csum &= (uint8_t)~NETBUF_CSUM_PARTIAL;
+    }
+    return nb;
 }
 
-void tcp_send_packet(tcp_socket_t *sock, uint8_t flags, const void *data, uint16_t len) {
-    uint16_t total_len = sizeof(tcp_header_t) + len;
-    uint8_t *packet = kmalloc(total_len);
+// Room left in the receive buffer, which is what we advertise
+static uint16_t tcp_rcv_window(const tcp_socket_t *sock) {
+    uint32_t space = TCP_RX_BUFFER_SIZE - sock->rx_len;
+    return (uint16_t)(space > TCP_WINDOW_MAX ? TCP_WINDOW_MAX : space);
+}
+
+// Send one segment: len bytes of the send buffer from seq, or none. Does not
+// touch the send state.
+static void tcp_transmit(tcp_socket_t *sock, uint8_t flags, uint32_t seq, uint16_t len) {
+    // The only copy: straight into the buffer the NIC sends from
+    netbuf_t *nb = len ? tcp_payload(sock, seq, len) : network_netbuf_from(NULL, 0);
+    if (!nb) return;
     
-    tcp_header_t *tcp = (tcp_header_t*)packet;
+    tcp_header_t *tcp = (tcp_header_t*)netbuf_push(nb, sizeof(tcp_header_t));
     tcp->src_port = htons(sock->local_port);
     tcp->dst_port = htons(sock->remote_port);
-    tcp->seq_num = htonl(sock->seq_num);
-    tcp->ack_num = htonl(sock->ack_num);
+    tcp->seq_num = htonl(seq);
+    tcp->ack_num = (flags & TCP_ACK) ? htonl(sock->rcv_nxt) : 0;
     tcp->data_offset = (sizeof(tcp_header_t) / 4) << 4;
     tcp->flags = flags;
-    tcp->window_size = htons(8192);
+    uint16_t window = tcp_rcv_window(sock);
+    tcp->window_size = htons(window);
+    sock->rcv_adv = sock->rcv_nxt + window;
     tcp->urgent_ptr = 0;
     tcp->checksum = 0;
+    nb->csum |= NETBUF_CSUM_TCP;    // The IP layer or the NIC fills it in
     
-    if (data) {
-        // Copy data
-        uint8_t *payload = packet + sizeof(tcp_header_t);
-        const uint8_t *d = (const uint8_t*)data;
-        for(int i=0; i<len; i++) payload[i] = d[i];
+    ip_send_netbuf(sock->remote_ip, IP_PROTO_TCP, nb);
+}
+
+static void tcp_arm_timer(tcp_socket_t *sock);
+static void tcp_arm_persist(tcp_socket_t *sock);
+
+// Account for a segment of len sequence numbers just sent from seq
+static void tcp_sent(tcp_socket_t *sock, uint32_t seq, uint32_t len) {
+    uint32_t end = seq + len;
+    // Only new data is timed; a sample from a retransmission is ambiguous
+    if (!sock->rtt_start_ns && !seq_lt(seq, sock->snd_max)) {
+        sock->rtt_seq = end;
+        sock->rtt_start_ns = clock_monotonic_ns();
     }
+    if (seq_lt(sock->snd_nxt, end)) sock->snd_nxt = end;
+    if (seq_lt(sock->snd_max, end)) sock->snd_max = end;
+    if (!timer_pending(&sock->rtx_timer)) tcp_arm_timer(sock);
+}
+
+// Send whatever the peer's window and the congestion window allow, then the
+// FIN once the data is out. Returns the number of segments sent. Interrupts
+// off.
+static int tcp_output(tcp_socket_t *sock) {
+    if (sock->state != TCP_ESTABLISHED && sock->state != TCP_FIN_WAIT) return 0;
+    uint32_t end = sock->snd_una + sock->tx_len;   // Past the buffered data
+    int sent = 0;
+    uint32_t limit = sock->snd_wnd < sock->cc.cwnd ? sock->snd_wnd : sock->cc.cwnd;
+    while (seq_lt(sock->snd_nxt, end)) {
+        uint32_t in_flight = sock->snd_nxt - sock->snd_una;
+        uint32_t window = limit > in_flight ? limit - in_flight : 0;
+        uint32_t len = end - sock->snd_nxt;
+        if (len > TCP_MSS) len = TCP_MSS;
+        if (len > window) len = window;
+        if (!len) break;
+        uint32_t seq = sock->snd_nxt;
+        tcp_transmit(sock, seq + len == end ? TCP_PSH | TCP_ACK : TCP_ACK, seq, (uint16_t)len);
+        tcp_sent(sock, seq, len);
+        sent++;
+    }
+    if (sock->fin_queued && sock->snd_nxt == end) {
+        tcp_transmit(sock, TCP_FIN | TCP_ACK, end, 0);
+        tcp_sent(sock, end, 1);
+        sent++;
+    }
+    // Data waiting on a closed window: the timer doubles as the persist
+    // timer, and probes the window when it fires
+    if (sock->snd_nxt == sock->snd_una && sock->tx_len && !sock->snd_wnd && !timer_pending(&sock->rtx_timer)) {
+        if (!sock->persisting) {
+            sock->persisting = true;
+            sock->persist_us = sock->rto_us;
+        }
+        tcp_arm_persist(sock);
+    }
+    return sent;
+}
+
+// Send the segment at snd_una again: data, or the FIN if that is all that's
+// left. Only one byte goes if the window has shrunk to nothing since.
+static void tcp_retransmit(tcp_socket_t *sock) {
+    uint32_t len = sock->tx_len > TCP_MSS ? TCP_MSS : sock->tx_len;
+    if (len && !sock->snd_wnd) len = 1;
+    if (len) {
+        tcp_transmit(sock, TCP_PSH | TCP_ACK, sock->snd_una, (uint16_t)len);
+        if (seq_lt(sock->snd_nxt, sock->snd_una + len)) sock->snd_nxt = sock->snd_una + len;
+        if (seq_lt(sock->snd_max, sock->snd_nxt)) sock->snd_max = sock->snd_nxt;
+    } else if (sock->fin_queued && !sock->fin_acked) {
+        tcp_transmit(sock, TCP_FIN | TCP_ACK, sock->snd_una, 0);
+        sock->snd_nxt = sock->snd_una + 1;
+        if (seq_lt(sock->snd_max, sock->snd_nxt)) sock->snd_max = sock->snd_nxt;
+    } else {
+        return;
+    }
+    sock->retransmits++;
+    total_retransmits++;
+    sock->rtt_start_ns = 0;         // Karn: whatever was timed is ambiguous now
+}
+
+static void tcp_rtx_timeout(void *arg) {
+    tcp_socket_t *sock = (tcp_socket_t*)arg;
+    uint64_t flags = irq_save();
+    if (sock->persisting && sock->state != TCP_CLOSED) {
+        // Zero-window probe (RFC 1122 4.2.2.17). The peer is only slow to
+        // read, which is not a loss: cwnd, ssthresh, the RTO and the loss
+        // counters stay as they are, and the probing never gives up.
+        if (sock->snd_wnd || !sock->tx_len) {
+            sock->persisting = false;
+        } else {
+            tcp_transmit(sock, TCP_ACK, sock->snd_una, 1);
+            if (seq_lt(sock->snd_max, sock->snd_una + 1)) sock->snd_max = sock->snd_una + 1;
+            sock->probes++;
+            sock->persist_us = sock->persist_us > TCP_RTO_MAX_US / 2 ? TCP_RTO_MAX_US : sock->persist_us * 2;
+            tcp_arm_persist(sock);
+        }
+        irq_restore(flags);
+        return;
+    }
+    bool outstanding = sock->state == TCP_SYN_SENT || sock->snd_max != sock->snd_una;
+    if (sock->state == TCP_CLOSED || !outstanding) {
+        irq_restore(flags);
+        return;
+    }
+    if (++sock->backoffs > TCP_MAX_BACKOFFS) {
+        // The peer is gone
+        sock->state = TCP_CLOSED;
+        sock->connected = false;
+        wait_queue_wake_all(&sock->wait);
+        irq_restore(flags);
+        return;
+    }
+    sock->timeouts++;
+    total_timeouts++;
+    if (sock->state == TCP_SYN_SENT) {
+        tcp_transmit(sock, TCP_SYN, sock->iss, 0);
+        sock->retransmits++;
+        total_retransmits++;
+        sock->rtt_start_ns = 0;
+        sock->cc.cwnd = sock->cc.mss;   // RFC 5681 3.1: a lost SYN leaves one segment
+    } else {
+        // RFC 5681 3.1: ssthresh drops on the first timeout only, and the
+        // window restarts from one segment in slow start
+        if (sock->backoffs == 1) {
+            sock->cc.ssthresh = sock->cong->ssthresh(&sock->cc, sock->snd_max - sock->snd_una);
+        }
+        sock->cc.cwnd = sock->cc.mss;
+        sock->cc.bytes_acked = 0;
+        sock->in_recovery = false;
+        sock->recover = sock->snd_max;
+        // Go back to the oldest unacknowledged segment; the rest follows
+        // as acks come in
+        sock->snd_nxt = sock->snd_una;
+        sock->dupacks = 0;
+        tcp_retransmit(sock);
+    }
+    // RFC 6298 5.5: back off
+    sock->rto_us = sock->rto_us > TCP_RTO_MAX_US / 2 ? TCP_RTO_MAX_US : sock->rto_us * 2;
+    tcp_arm_timer(sock);
+    irq_restore(flags);
+}
+
+static void tcp_arm_timer(tcp_socket_t *sock) {
+    timer_start(&sock->rtx_timer, clock_monotonic_ns() + (uint64_t)sock->rto_us * 1000, tcp_rtx_timeout, sock);
+}
+
+static void tcp_arm_persist(tcp_socket_t *sock) {
+    timer_start(&sock->rtx_timer, clock_monotonic_ns() + (uint64_t)sock->persist_us * 1000, tcp_rtx_timeout, sock);
+}
+
+// The window reopened: whatever the persist timer had pending gives way to
+// the retransmission timer, which tcp_sent() arms for the next segment
+static void tcp_update_window(tcp_socket_t *sock, uint32_t window) {
+    sock->snd_wnd = window;
+    if (window && sock->persisting) {
+        sock->persisting = false;
+        timer_cancel(&sock->rtx_timer);
+    }
+}
+
+// RFC 6298 section 2, in microseconds
+static void tcp_rtt_sample(tcp_socket_t *sock, uint32_t r) {
+    if (!r) r = 1;
+    if (!sock->srtt_us) {
+        sock->srtt_us = r;
+        sock->rttvar_us = r / 2;
+    } else {
+        uint32_t delta = sock->srtt_us > r ? sock->srtt_us - r : r - sock->srtt_us;
+        sock->rttvar_us = (3 * sock->rttvar_us + delta) / 4;
+        sock->srtt_us = (7 * sock->srtt_us + r) / 8;
+    }
+    uint32_t var = 4 * sock->rttvar_us;
+    uint64_t rto = (uint64_t)sock->srtt_us + (var > TCP_CLOCK_GRANULARITY_US ? var : TCP_CLOCK_GRANULARITY_US);
+    if (rto < TCP_RTO_MIN_US) rto = TCP_RTO_MIN_US;
+    if (rto > TCP_RTO_MAX_US) rto = TCP_RTO_MAX_US;
+    sock->rto_us = (uint32_t)rto;
+}
+
+// Process the acknowledgment and window of an incoming segment. Interrupts off.
+static void tcp_ack(tcp_socket_t *sock, uint32_t ack, uint32_t window, bool dup_candidate) {
+    if (seq_lt(sock->snd_max, ack)) return;     // Acks something never sent
     
-    tcp->checksum = tcp_checksum(sock, tcp, data, len);
-    
-    ip_send_packet(sock->remote_ip, IP_PROTO_TCP, packet, total_len);
-    kfree(packet);
+    if (seq_lt(sock->snd_una, ack)) {
+        uint32_t acked = ack - sock->snd_una;
+        // Window growth only counts while the window was what held us back
+        bool cwnd_limited = sock->snd_nxt - sock->snd_una + sock->cc.mss >= sock->cc.cwnd;
+        uint32_t data = acked > sock->tx_len ? sock->tx_len : acked;
+        sock->tx_start = (sock->tx_start + data) & (TCP_TX_BUFFER_SIZE - 1);
+        sock->tx_len -= data;
+        if (acked > data) sock->fin_acked = true;
+        sock->snd_una = ack;
+        if (seq_lt(sock->snd_nxt, ack)) sock->snd_nxt = ack;
+        if (sock->rtt_start_ns && seq_le(sock->rtt_seq, ack)) {
+            tcp_rtt_sample(sock, (uint32_t)((clock_monotonic_ns() - sock->rtt_start_ns) / 1000));
+            sock->rtt_start_ns = 0;
+        }
+        sock->dupacks = 0;
+        sock->backoffs = 0;
+        tcp_update_window(sock, window);
+        if (sock->in_recovery) {
+            if (seq_lt(ack, sock->recover)) {
+                // RFC 6582 3.2 step 5: a partial ack. The next hole is lost
+                // too; deflate by what was acked and keep going.
+                tcp_retransmit(sock);
+                sock->cc.cwnd = sock->cc.cwnd > acked ? sock->cc.cwnd - acked : 0;
+                if (acked >= sock->cc.mss) sock->cc.cwnd += sock->cc.mss;
+            } else {
+                // Step 6: everything outstanding at the loss is in
+                uint32_t flight = sock->snd_max - sock->snd_una;
+                uint32_t deflated = (flight > sock->cc.mss ? flight : sock->cc.mss) + sock->cc.mss;
+                sock->cc.cwnd = deflated < sock->cc.ssthresh ? deflated : sock->cc.ssthresh;
+                sock->in_recovery = false;
+            }
+        } else if (cwnd_limited) {
+            sock->cong->ack(&sock->cc, acked, sock->srtt_us);
+        }
+        // RFC 6298 5.2/5.3
+        if (sock->snd_una == sock->snd_max) timer_cancel(&sock->rtx_timer);
+        else tcp_arm_timer(sock);
+        if (sock->fin_acked && sock->peer_fin) sock->state = TCP_CLOSED;
+        wait_queue_wake_all(&sock->wait);
+        return;
+    }
     
-    // Advance sequence for SYN/FIN or data
-    if (len > 0 || (flags & (TCP_SYN|TCP_FIN))) {
-        sock->seq_num += (len > 0 ? len : 1);
+    // RFC 5681: a duplicate ack carries no data and no new window while
+    // something is in flight
+    if (ack == sock->snd_una && dup_candidate && window == sock->snd_wnd && window &&
+        sock->snd_max != sock->snd_una) {
+        if (sock->in_recovery) {
+            // Step 4: each duplicate means a segment has left the network
+            sock->cc.cwnd += sock->cc.mss;
+        } else if (++sock->dupacks == TCP_DUPACK_THRESHOLD && seq_lt(sock->recover, ack)) {
+            // Steps 2 and 3; not again for losses from before the last
+            // recovery or timeout
+            sock->cc.ssthresh = sock->cong->ssthresh(&sock->cc, sock->snd_max - sock->snd_una);
+            sock->recover = sock->snd_max;
+            sock->in_recovery = true;
+            tcp_retransmit(sock);
+            sock->cc.cwnd = sock->cc.ssthresh + TCP_DUPACK_THRESHOLD * sock->cc.mss;
+            sock->fast_retransmits++;
+            total_fast_retransmits++;
+        }
+        return;
     }
+    if (ack == sock->snd_una) {
+        tcp_update_window(sock, window);
+        if (!window) sock->backoffs = 0;        // Alive, just not reading
+    }
+}
+
+// Copy len bytes to the receive ring, offset bytes past rcv_nxt
+static void tcp_rx_copy(tcp_socket_t *sock, uint32_t offset, const uint8_t *data, uint32_t len) {
+    uint32_t pos = sock->rx_start + sock->rx_len + offset;
+    for (uint32_t i = 0; i < len; i++) {
+        sock->rx_buffer[(pos + i) & (TCP_RX_BUFFER_SIZE - 1)] = data[i];
+    }
+}
+
+// Remember that [start, end) is in the ring, merging it with the ranges it
+// overlaps or touches. When all slots are taken the segment is dropped and
+// the peer sends it again.
+static void tcp_ooo_add(tcp_socket_t *sock, uint32_t start, uint32_t end) {
+    int i = 0;
+    while (i < sock->ooo_count && seq_lt(sock->ooo[i].end, start)) i++;
+    int j = i;
+    while (j < sock->ooo_count && seq_le(sock->ooo[j].start, end)) {
+        if (seq_lt(sock->ooo[j].start, start)) start = sock->ooo[j].start;
+        if (seq_lt(end, sock->ooo[j].end)) end = sock->ooo[j].end;
+        j++;
+    }
+    if (i == j) {
+        if (sock->ooo_count == TCP_OOO_MAX) return;
+        for (int k = sock->ooo_count; k > i; k--) sock->ooo[k] = sock->ooo[k - 1];
+        sock->ooo_count++;
+    } else {
+        // Ranges i..j-1 become one
+        for (int k = j; k < sock->ooo_count; k++) sock->ooo[i + 1 + k - j] = sock->ooo[k];
+        sock->ooo_count -= j - i - 1;
+    }
+    sock->ooo[i].start = start;
+    sock->ooo[i].end = end;
+}
+
+// rcv_nxt moved: take in the held ranges it has reached
+static void tcp_ooo_pull(tcp_socket_t *sock) {
+    int n = 0;
+    while (n < sock->ooo_count && seq_le(sock->ooo[n].start, sock->rcv_nxt)) {
+        if (seq_lt(sock->rcv_nxt, sock->ooo[n].end)) {
+            sock->rx_len += sock->ooo[n].end - sock->rcv_nxt;
+            sock->rcv_nxt = sock->ooo[n].end;
+        }
+        n++;
+    }
+    if (!n) return;
+    for (int k = n; k < sock->ooo_count; k++) sock->ooo[k - n] = sock->ooo[k];
+    sock->ooo_count -= n;
 }
 
-void tcp_handle_packet(ipv4_address_t src, void *data, uint16_t len) {
-    if (!active_socket) return;
+// Take payload and FIN into the receive window. Returns true if the segment
+// needs an ack, which for anything out of order is the duplicate ack that
+// tells the peer what is missing. Interrupts off.
+static bool tcp_receive(tcp_socket_t *sock, uint32_t seq, uint8_t *payload, uint32_t data_len, bool fin) {
+    if (!data_len && !fin) return false;
+    if (sock->peer_fin) return true;            // Retransmitted FIN
     
-    tcp_header_t *tcp = (tcp_header_t*)data;
-    uint16_t data_len = len - ((tcp->data_offset >> 4) * 4);
-    uint8_t *payload = (uint8_t*)data + ((tcp->data_offset >> 4) * 4);
+    // Trim what we already have
+    if (seq_lt(seq, sock->rcv_nxt)) {
+        uint32_t skip = sock->rcv_nxt - seq;
+        if (skip > data_len) return true;       // Old FIN too
+        payload += skip;
+        data_len -= skip;
+        seq = sock->rcv_nxt;
+    }
+    // ... and what is past the window
+    uint32_t offset = seq - sock->rcv_nxt;
+    uint32_t space = TCP_RX_BUFFER_SIZE - sock->rx_len;
+    if (offset > space || (offset == space && data_len)) return true;
+    if (data_len > space - offset) {
+        data_len = space - offset;
+        fin = false;
+    }
+    
+    tcp_rx_copy(sock, offset, payload, data_len);
+    if (fin) {
+        sock->fin_pending = true;
+        sock->fin_seq = seq + data_len;
+    }
+    if (offset) {
+        if (data_len) tcp_ooo_add(sock, seq, seq + data_len);
+        return true;
+    }
+    
+    sock->rcv_nxt += data_len;
+    sock->rx_len += data_len;
+    tcp_ooo_pull(sock);
+    
+    // A FIN only counts once everything before it is in
+    if (sock->fin_pending && sock->rcv_nxt == sock->fin_seq) {
+        sock->rcv_nxt++;
+        sock->peer_fin = true;
+        sock->connected = false;
+        // Close our side too
+        sock->fin_queued = true;
+        sock->state = sock->fin_acked ? TCP_CLOSED : TCP_FIN_WAIT;
+    }
+    if (data_len || sock->peer_fin) wait_queue_wake_all(&sock->wait);
+    return true;
+}
+
+// Interrupts off
+static void tcp_segment(tcp_socket_t *sock, tcp_header_t *tcp, uint8_t *payload, uint16_t data_len) {
+    uint32_t seq = ntohl(tcp->seq_num);
+    uint32_t ack = ntohl(tcp->ack_num);
+    uint32_t window = ntohs(tcp->window_size);
     
-    // Check ports
-    if (ntohs(tcp->dst_port) != active_socket->local_port) return;
+    if (tcp->flags & TCP_RST) {
+        if (sock->state == TCP_SYN_SENT && (!(tcp->flags & TCP_ACK) || ack != sock->iss + 1)) return;
+        sock->state = TCP_CLOSED;
+        sock->connected = false;
+        timer_cancel(&sock->rtx_timer);
+        wait_queue_wake_all(&sock->wait);
+        return;
+    }
     
     // State Machine
-    if (active_socket->state == TCP_SYN_SENT) {
-        if ((tcp->flags & TCP_SYN) && (tcp->flags & TCP_ACK)) {
-            active_socket->ack_num = ntohl(tcp->seq_num) + 1;
-            active_socket->state = TCP_ESTABLISHED;
-            active_socket->connected = true;
-            // Send ACK
-            tcp_send_packet(active_socket, TCP_ACK, NULL, 0);
-        }
-    } else if (active_socket->state == TCP_ESTABLISHED) {
-        if (tcp->flags & TCP_FIN) {
-            active_socket->ack_num = ntohl(tcp->seq_num) + 1;
-            tcp_send_packet(active_socket, TCP_ACK | TCP_FIN, NULL, 0);
-            active_socket->state = TCP_CLOSED;
-            active_socket->connected = false;
-        } else if (data_len > 0) {
-            // Accept data
-            if (active_socket->rx_pos < active_socket->rx_size) {
-                for(int i=0; i<data_len && active_socket->rx_pos < active_socket->rx_size - 1; i++) {
-                    active_socket->rx_buffer[active_socket->rx_pos++] = payload[i];
-                }
-                active_socket->rx_buffer[active_socket->rx_pos] = 0; // Null terminate for text
+    if (sock->state == TCP_SYN_SENT) {
+        if ((tcp->flags & TCP_SYN) && (tcp->flags & TCP_ACK) && ack == sock->iss + 1) {
+            sock->rcv_nxt = seq + 1;
+            sock->snd_una = sock->snd_nxt = sock->snd_max = ack;
+            sock->snd_wnd = window;
+            if (sock->rtt_start_ns) {
+                tcp_rtt_sample(sock, (uint32_t)((clock_monotonic_ns() - sock->rtt_start_ns) / 1000));
+                sock->rtt_start_ns = 0;
             }
-            active_socket->ack_num = ntohl(tcp->seq_num) + data_len;
-            tcp_send_packet(active_socket, TCP_ACK, NULL, 0);
+            sock->backoffs = 0;
+            timer_cancel(&sock->rtx_timer);
+            sock->state = TCP_ESTABLISHED;
+            sock->connected = true;
+            // Send ACK
+            tcp_transmit(sock, TCP_ACK, sock->snd_nxt, 0);
+            wait_queue_wake_all(&sock->wait);
         }
+        return;
     }
+    if (sock->state == TCP_CLOSED) return;
+    
+    bool fin = (tcp->flags & TCP_FIN) != 0;
+    if (tcp->flags & TCP_ACK) tcp_ack(sock, ack, window, !data_len && !fin);
+    bool need_ack = tcp_receive(sock, seq, payload, data_len, fin);
+    
+    // Data and our FIN carry the ack; otherwise it goes out on its own
+    if (!tcp_output(sock) && need_ack) tcp_transmit(sock, TCP_ACK, sock->snd_nxt, 0);
+}
+
+void tcp_handle_packet(ipv4_address_t src, ipv4_address_t dst, void *data, uint16_t len) {
+    if (len < sizeof(tcp_header_t)) return;
+    tcp_header_t *tcp = (tcp_header_t*)data;
+    uint16_t hdr_len = (tcp->data_offset >> 4) * 4;
+    if (hdr_len < sizeof(tcp_header_t) || hdr_len > len) return;
+    
+    uint64_t flags = irq_save();
+    tcp_socket_t *sock = tcp_lookup(dst, ntohs(tcp->dst_port), src, ntohs(tcp->src_port));
+    if (sock) tcp_segment(sock, tcp, (uint8_t*)data + hdr_len, len - hdr_len);
+    irq_restore(flags);
 }
 
 tcp_socket_t* tcp_connect(ipv4_address_t ip, uint16_t port) {
-    if (active_socket) kfree(active_socket);
-    
-    active_socket = kmalloc(sizeof(tcp_socket_t));
-    active_socket->remote_ip = ip;
-    active_socket->remote_port = port;
-    active_socket->local_port = 49152 + (port % 1000); // Random-ish ephemeral
-    active_socket->seq_num = 1000;
-    active_socket->ack_num = 0;
-    active_socket->state = TCP_SYN_SENT;
-    active_socket->connected = false;
-    active_socket->rx_buffer = kmalloc(65536); // 64KB buffer
-    active_socket->rx_size = 65536;
-    active_socket->rx_pos = 0;
-    
-    // Send SYN
-    tcp_send_packet(active_socket, TCP_SYN, NULL, 0);
+    tcp_socket_t *sock = kmalloc(sizeof(tcp_socket_t));
+    if (!sock) return NULL;
+    *sock = (tcp_socket_t){0};
+    sock->rx_buffer = kmalloc(TCP_RX_BUFFER_SIZE);
+    sock->tx_buffer = kmalloc(TCP_TX_BUFFER_SIZE);
+    if (!sock->rx_buffer || !sock->tx_buffer) {
+        kfree(sock->rx_buffer);
+        kfree(sock->tx_buffer);
+        kfree(sock);
+        return NULL;
+    }
+    sock->local_ip = get_local_ip();
+    sock->remote_ip = ip;
+    sock->remote_port = port;
+    sock->state = TCP_SYN_SENT;
+    sock->rto_us = TCP_RTO_INITIAL_US;
+    sock->cong = tcp_cong_default();
+    tcp_cong_init(&sock->cc, sock->cong, TCP_MSS);
+    wait_queue_init(&sock->wait);
     
-    // Wait for connection (Blocking)
-    int timeout = 100000000;
-    while (!active_socket->connected && timeout-- > 0);
+    uint64_t flags = irq_save();
+    sock->local_port = tcp_ephemeral_port(sock->local_ip, ip, port);
+    if (sock->local_port) {
+        sock->iss = tcp_initial_seq(sock);
+        sock->snd_una = sock->snd_nxt = sock->snd_max = sock->iss;
+        sock->recover = sock->iss;
+        tcp_hash_insert(sock);
+        // Send SYN
+        tcp_transmit(sock, TCP_SYN, sock->iss, 0);
+        tcp_sent(sock, sock->iss, 1);
+    }
+    irq_restore(flags);
+    if (!sock->local_port) {
+        kfree(sock->rx_buffer);
+        kfree(sock->tx_buffer);
+        kfree(sock);
+        return NULL;
+    }
     
-    if (!active_socket->connected) {
-        kfree(active_socket->rx_buffer);
-        kfree(active_socket);
-        active_socket = NULL;
+    // Wait for connection (Blocking)
+    wait_event_timeout(&sock->wait, sock->connected || sock->state == TCP_CLOSED, TCP_CONNECT_TIMEOUT_MS);
+    if (!sock->connected) {
+        tcp_destroy(sock);
         return NULL;
     }
     
-    return active_socket;
+    return sock;
 }
 
+// Queue data behind what is already buffered and send what the window
+// allows; blocks while the send buffer is full
 void tcp_send(tcp_socket_t *sock, const char *data, int len) {
     if (!sock || !sock->connected) return;
     if (len == 0) {
@@ -178,28 +702,222 @@ void tcp_send(tcp_socket_t *sock, const char *data, int len) {
         const char *p = data;
         while(*p++) len++;
     }
-    tcp_send_packet(sock, TCP_PSH | TCP_ACK, data, len);
+    // Segments sent together reach the NIC with a single doorbell
+    network_tx_batch_begin();
+    while (len > 0) {
+        uint64_t flags = irq_save();
+        uint32_t space = TCP_TX_BUFFER_SIZE - sock->tx_len;
+        uint32_t count = (uint32_t)len < space ? (uint32_t)len : space;
+        uint32_t tail = (sock->tx_start + sock->tx_len) & (TCP_TX_BUFFER_SIZE - 1);
+        for (uint32_t i = 0; i < count; i++) {
+            sock->tx_buffer[(tail + i) & (TCP_TX_BUFFER_SIZE - 1)] = (uint8_t)data[i];
+        }
+        sock->tx_len += count;
+        tcp_output(sock);
+        irq_restore(flags);
+        data += count;
+        len -= (int)count;
+        if (!len) break;
+        
+        network_tx_batch_end();
+        bool room = wait_event_timeout(&sock->wait, !sock->connected || sock->tx_len < TCP_TX_BUFFER_SIZE,
+                                       TCP_SEND_TIMEOUT_MS);
+        if (!room || !sock->connected) return;
+        network_tx_batch_begin();
+    }
+    network_tx_batch_end();
 }
 
 void tcp_close(tcp_socket_t *sock) {
     if (!sock) return;
-    tcp_send_packet(sock, TCP_FIN | TCP_ACK, NULL, 0);
-    sock->state = TCP_CLOSED;
+    uint64_t flags = irq_save();
+    if (sock->state == TCP_ESTABLISHED || sock->state == TCP_FIN_WAIT) {
+        sock->fin_queued = true;
+        sock->state = TCP_FIN_WAIT;
+        tcp_output(sock);
+    }
     sock->connected = false;
-    // Give time for packet to go out
-    for(volatile int i=0; i<1000000; i++);
-    kfree(sock->rx_buffer);
-    kfree(sock);
-    active_socket = NULL;
+    irq_restore(flags);
+    // Wait for the buffered data and the FIN to be acknowledged
+    wait_event_timeout(&sock->wait, sock->fin_acked || sock->state == TCP_CLOSED, TCP_CLOSE_TIMEOUT_MS);
+    tcp_destroy(sock);
+}
+
+bool tcp_wait_closed(tcp_socket_t *sock, uint32_t timeout_ms) {
+    if (!sock) return true;
+    return wait_event_timeout(&sock->wait, sock->peer_fin || sock->state == TCP_CLOSED, timeout_ms);
 }
 
 int tcp_read(tcp_socket_t *sock, char *buffer, int max_len) {
+    if (!sock || max_len <= 0) return 0;
+    uint64_t flags = irq_save();
+    uint32_t count = sock->rx_len < (uint32_t)max_len ? sock->rx_len : (uint32_t)max_len;
+    for (uint32_t i = 0; i < count; i++) {
+        buffer[i] = (char)sock->rx_buffer[(sock->rx_start + i) & (TCP_RX_BUFFER_SIZE - 1)];
+    }
+    sock->rx_start = (sock->rx_start + count) & (TCP_RX_BUFFER_SIZE - 1);
+    sock->rx_len -= count;
+    
+    // Tell the peer about the room as soon as it is worth a segment (RFC
+    // 1122 4.2.3.3), so a sender stalled on a full buffer resumes right away
+    uint32_t edge = sock->rcv_nxt + tcp_rcv_window(sock);
+    if (count && !sock->peer_fin && (sock->state == TCP_ESTABLISHED || sock->state == TCP_FIN_WAIT) &&
+        (int32_t)(edge - sock->rcv_adv) >= TCP_MSS) {
+        tcp_transmit(sock, TCP_ACK, sock->snd_nxt, 0);
+    }
+    irq_restore(flags);
+    return (int)count;
+}
+
+int tcp_recv(tcp_socket_t *sock, char *buffer, int max_len, uint32_t timeout_ms) {
     if (!sock) return 0;
-    // Simple copy of what we have
+    wait_event_timeout(&sock->wait, sock->rx_len || sock->peer_fin || sock->state == TCP_CLOSED, timeout_ms);
+    int count = tcp_read(sock, buffer, max_len);
+    if (count) return count;
+    return sock->peer_fin || sock->state == TCP_CLOSED ? 0 : -1;
+}
+
+bool tcp_set_congestion(tcp_socket_t *sock, const char *name) {
+    const tcp_cong_ops_t *ops = tcp_cong_find(name);
+    if (!sock || !ops) return false;
+    uint64_t flags = irq_save();
+    // The window carries over; the new algorithm starts its own state fresh
+    sock->cong = ops;
+    ops->init(&sock->cc);
+    irq_restore(flags);
+    return true;
+}
+
+static const char *tcp_state_name(tcp_state_enum state) {
+    switch (state) {
+        case TCP_SYN_SENT: return "SYN_SENT";
+        case TCP_ESTABLISHED: return "ESTABLISHED";
+        case TCP_FIN_WAIT: return "FIN_WAIT";
+        default: return "CLOSED";
+    }
+}
+
+// Interrupts off
+static void tcp_fill_info(const tcp_socket_t *sock, tcp_info_t *info) {
+    info->local_ip = sock->local_ip;
+    info->remote_ip = sock->remote_ip;
+    info->local_port = sock->local_port;
+    info->remote_port = sock->remote_port;
+    info->state = tcp_state_name(sock->state);
+    info->cong = sock->cong->name;
+    info->cwnd = sock->cc.cwnd;
+    info->ssthresh = sock->cc.ssthresh;
+    info->snd_wnd = sock->snd_wnd;
+    info->srtt_us = sock->srtt_us;
+    info->rto_us = sock->rto_us;
+    info->retransmits = sock->retransmits;
+    info->fast_retransmits = sock->fast_retransmits;
+    info->timeouts = sock->timeouts;
+    info->probes = sock->probes;
+}
+
+void tcp_get_info(tcp_socket_t *sock, tcp_info_t *info) {
+    if (!sock) return;
+    uint64_t flags = irq_save();
+    tcp_fill_info(sock, info);
+    irq_restore(flags);
+}
+
+// --- Commands ---
+
+#define NETSTAT_MAX 16
+
+static void write_endpoint(ipv4_address_t ip, uint16_t port) {
+    for (int i = 0; i < 4; i++) {
+        cmd_write_int(ip.bytes[i]);
+        cmd_write(i < 3 ? "." : ":");
+    }
+    cmd_write_int(port);
+}
+
+void cli_cmd_netstat(char *args) {
+    (void)args;
+    // Copied out with interrupts off, printed afterwards
+    static tcp_info_t infos[NETSTAT_MAX];
     int count = 0;
-    for (int i = 0; i < sock->rx_pos && i < max_len; i++) {
-        buffer[i] = sock->rx_buffer[i];
-        count++;
+    int total = 0;
+    uint64_t flags = irq_save();
+    for (int b = 0; b < TCP_HASH_BUCKETS; b++) {
+        for (tcp_socket_t *s = tcp_table[b]; s; s = s->hash_next) {
+            if (count < NETSTAT_MAX) tcp_fill_info(s, &infos[count++]);
+            total++;
+        }
     }
-    return count;
-}
\ No newline at end of file
+    uint32_t retransmits = total_retransmits;
+    uint32_t fast_retransmits = total_fast_retransmits;
+    uint32_t timeouts = total_timeouts;
+    irq_restore(flags);
+    
+    for (int i = 0; i < count; i++) {
+        tcp_info_t *t = &infos[i];
+        cmd_write("TCP ");
+        write_endpoint(t->local_ip, t->local_port);
+        cmd_write(" -> ");
+        write_endpoint(t->remote_ip, t->remote_port);
+        cmd_write(" ");
+        cmd_write(t->state);
+        cmd_write(" ");
+        cmd_write(t->cong);
+        cmd_write("\n    cwnd ");
+        cmd_write_int((int)t->cwnd);
+        cmd_write(" ssthresh ");
+        if (t->ssthresh >= TCP_CONG_INITIAL_SSTHRESH) cmd_write("-");
+        else cmd_write_int((int)t->ssthresh);
+        cmd_write(" wnd ");
+        cmd_write_int((int)t->snd_wnd);
+        cmd_write(" srtt ");
+        cmd_write_int((int)(t->srtt_us / 1000));
+        cmd_write("ms rto ");
+        cmd_write_int((int)(t->rto_us / 1000));
+        cmd_write("ms retrans ");
+        cmd_write_int((int)t->retransmits);
+        cmd_write(" (fast ");
+        cmd_write_int((int)t->fast_retransmits);
+        cmd_write(", timeouts ");
+        cmd_write_int((int)t->timeouts);
+        cmd_write(") probes ");
+        cmd_write_int((int)t->probes);
+        cmd_write("\n");
+    }
+    if (total > count) {
+        cmd_write("... ");
+        cmd_write_int(total - count);
+        cmd_write(" more\n");
+    }
+    if (!total) cmd_write("No TCP connections\n");
+    cmd_write("Retransmits: ");
+    cmd_write_int((int)retransmits);
+    cmd_write(" (fast ");
+    cmd_write_int((int)fast_retransmits);
+    cmd_write(", timeouts ");
+    cmd_write_int((int)timeouts);
+    cmd_write(")\nCongestion control: ");
+    cmd_write(tcp_cong_default()->name);
+    cmd_write("\n");
+}
+
+// TCPCC [algorithm] - congestion control for new connections
+void cli_cmd_tcpcc(char *args) {
+    while (args && *args == ' ') args++;
+    if (args && *args) {
+        const tcp_cong_ops_t *ops = tcp_cong_find(args);
+        if (!ops) {
+            cmd_write("Usage: TCPCC [");
+            for (int i = 0; tcp_cong_get(i); i++) {
+                if (i) cmd_write("|");
+                cmd_write(tcp_cong_get(i)->name);
+            }
+            cmd_write("]\n");
+            return;
+        }
+        tcp_cong_set_default(ops);
+    }
+    cmd_write("Congestion control: ");
+    cmd_write(tcp_cong_default()->name);
+    cmd_write("\n");
+}
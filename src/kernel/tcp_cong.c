@@ -0,0 +1,172 @@
+#include "tcp_cong.h"
+#include "clock.h"
+
+static const tcp_cong_ops_t *const algorithms[] = {
+    &tcp_cong_newreno,
+    &tcp_cong_cubic,
+};
+#define ALGORITHM_COUNT (int)(sizeof(algorithms) / sizeof(algorithms[0]))
+
+static const tcp_cong_ops_t *default_ops = &tcp_cong_cubic;
+
+void tcp_cong_init(tcp_cong_t *cc, const tcp_cong_ops_t *ops, uint32_t mss) {
+    // RFC 5681 3.1: min(4 * SMSS, max(2 * SMSS, 4380 bytes))
+    uint32_t iw = 2 * mss > 4380 ? 2 * mss : 4380;
+    if (iw > 4 * mss) iw = 4 * mss;
+    cc->mss = mss;
+    cc->cwnd = iw;
+    cc->ssthresh = TCP_CONG_INITIAL_SSTHRESH;
+    cc->bytes_acked = 0;
+    ops->init(cc);
+}
+
+const tcp_cong_ops_t *tcp_cong_find(const char *name) {
+    for (int i = 0; i < ALGORITHM_COUNT; i++) {
+        const char *a = algorithms[i]->name;
+        const char *b = name;
+        while (*a && *a == *b) {
+            a++;
+            b++;
+        }
+        if (!*a && !*b) return algorithms[i];
+    }
+    return 0;
+}
+
+const tcp_cong_ops_t *tcp_cong_get(int index) {
+    return index >= 0 && index < ALGORITHM_COUNT ? algorithms[index] : 0;
+}
+
+const tcp_cong_ops_t *tcp_cong_default(void) {
+    return default_ops;
+}
+
+void tcp_cong_set_default(const tcp_cong_ops_t *ops) {
+    if (ops) default_ops = ops;
+}
+
+// RFC 5681 3.1 with RFC 3465's L = 1: at most one segment per ack
+static void slow_start(tcp_cong_t *cc, uint32_t acked) {
+    cc->cwnd += acked < cc->mss ? acked : cc->mss;
+}
+
+// --- NewReno (RFC 5681, RFC 6582) ---
+
+static void newreno_init(tcp_cong_t *cc) {
+    cc->bytes_acked = 0;
+}
+
+static void newreno_ack(tcp_cong_t *cc, uint32_t acked, uint32_t srtt_us) {
+    (void)srtt_us;
+    if (cc->cwnd < cc->ssthresh) {
+        slow_start(cc, acked);
+        return;
+    }
+    // Congestion avoidance: one segment per window acked (RFC 3465)
+    cc->bytes_acked += acked;
+    if (cc->bytes_acked >= cc->cwnd) {
+        cc->bytes_acked -= cc->cwnd;
+        cc->cwnd += cc->mss;
+    }
+}
+
+// RFC 5681 eqn. 4
+static uint32_t newreno_ssthresh(tcp_cong_t *cc, uint32_t flight) {
+    uint32_t half = flight / 2;
+    return half > 2 * cc->mss ? half : 2 * cc->mss;
+}
+
+const tcp_cong_ops_t tcp_cong_newreno = {
+    .name = "newreno",
+    .init = newreno_init,
+    .ack = newreno_ack,
+    .ssthresh = newreno_ssthresh,
+};
+
+// --- CUBIC (RFC 9438) ---
+//
+// W_cubic(t) = C * (t - K)^3 + W_max, t in seconds and the window in
+// segments, with C = 0.4 and beta = 0.7. Here t and K are in milliseconds,
+// so C * (t - K)^3 segments is 2 * d^3 / 5e9 with d = t - K in ms.
+
+#define CUBIC_D_MAX 100000          // ms; keeps d^3 * 2 * mss in 63 bits
+
+static uint32_t cube_root(uint64_t x) {
+    uint64_t r = 0;
+    for (int s = 63; s >= 0; s -= 3) {
+        r <<= 1;
+        uint64_t b = 3 * r * (r + 1) + 1;
+        if ((x >> s) >= b) {
+            x -= b << s;
+            r++;
+        }
+    }
+    return (uint32_t)r;
+}
+
+static void cubic_init(tcp_cong_t *cc) {
+    cc->bytes_acked = 0;
+    cc->w_max = 0;
+    cc->epoch_ns = 0;
+}
+
+static void cubic_ack(tcp_cong_t *cc, uint32_t acked, uint32_t srtt_us) {
+    if (cc->cwnd < cc->ssthresh) {
+        slow_start(cc, acked);
+        return;
+    }
+    uint64_t now = clock_monotonic_ns();
+    if (!cc->epoch_ns) {
+        // RFC 9438 4.2: K = cbrt((W_max - cwnd) / C)
+        cc->epoch_ns = now;
+        cc->bytes_acked = 0;
+        cc->w_est = cc->cwnd;
+        if (cc->cwnd < cc->w_max) {
+            cc->k_ms = cube_root((uint64_t)(cc->w_max - cc->cwnd) * 2500000000ULL / cc->mss);
+            cc->origin = cc->w_max;
+        } else {
+            cc->k_ms = 0;
+            cc->origin = cc->cwnd;
+        }
+    }
+
+    // Where the curve will be one round trip from now
+    int64_t d = (int64_t)((now - cc->epoch_ns) / CLOCK_NS_PER_MS) + srtt_us / 1000 - cc->k_ms;
+    if (d > CUBIC_D_MAX) d = CUBIC_D_MAX;
+    if (d < -CUBIC_D_MAX) d = -CUBIC_D_MAX;
+    int64_t target = (int64_t)cc->origin + d * d * d * 2 * (int64_t)cc->mss / 5000000000LL;
+
+    // RFC 9438 4.3: never slower than Reno, whose window grows by
+    // 3 * (1 - beta) / (1 + beta) = 9/17 of a segment per window acked
+    cc->bytes_acked += acked;
+    while (cc->bytes_acked >= cc->cwnd) {
+        cc->bytes_acked -= cc->cwnd;
+        cc->w_est += cc->mss * 9 / 17;
+    }
+    if (target < cc->w_est) target = cc->w_est;
+
+    // RFC 9438 4.4: close (target - cwnd) / cwnd of the gap per segment
+    // acked, at most half a window per round trip
+    if (target > (int64_t)cc->cwnd) {
+        int64_t limit = (int64_t)cc->cwnd * 3 / 2;
+        if (target > limit) target = limit;
+        cc->cwnd += (uint32_t)((target - cc->cwnd) * acked / cc->cwnd);
+    }
+}
+
+static uint32_t cubic_ssthresh(tcp_cong_t *cc, uint32_t flight) {
+    (void)flight;
+    cc->epoch_ns = 0;
+    // RFC 9438 4.7 fast convergence: yield to newer flows
+    if (cc->cwnd < cc->w_max) cc->w_max = cc->cwnd * 17 / 20;
+    else cc->w_max = cc->cwnd;
+    uint32_t s = cc->cwnd / 10 * 7;
+    return s > 2 * cc->mss ? s : 2 * cc->mss;
+}
+
+const tcp_cong_ops_t tcp_cong_cubic = {
+    .name = "cubic",
+    .init = cubic_init,
+    .ack = cubic_ack,
+    .ssthresh = cubic_ssthresh,
+};
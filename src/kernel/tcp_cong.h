@@ -0,0 +1,52 @@
+#ifndef TCP_CONG_H
+#define TCP_CONG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// TCP congestion control. tcp.c does fast retransmit and NewReno fast
+// recovery (RFC 6582) and collapses the window on a retransmission timeout;
+// the algorithm decides how the window grows on new acks (slow start and
+// congestion avoidance) and how far it drops on a loss. Windows are in bytes.
+
+#define TCP_CONG_INITIAL_SSTHRESH 0x7FFFFFFF   // "Arbitrarily high" (RFC 5681)
+
+typedef struct {
+    uint32_t cwnd;
+    uint32_t ssthresh;
+    uint32_t mss;
+    uint32_t bytes_acked;           // Towards the next window increase
+    // CUBIC
+    uint32_t w_max;                 // Window before the last reduction
+    uint32_t origin;                // Window the cubic curve flattens out at
+    uint32_t k_ms;                  // Time from the epoch start to get there
+    uint32_t w_est;                 // What Reno would have by now
+    uint64_t epoch_ns;              // clock_monotonic_ns(), 0 before the first ack after a loss
+} tcp_cong_t;
+
+typedef struct tcp_cong_ops {
+    const char *name;
+    // Reset the algorithm's own state; cwnd and ssthresh are kept
+    void (*init)(tcp_cong_t *cc);
+    // acked bytes of new data acknowledged while the window was the limit,
+    // outside fast recovery. srtt_us is 0 before the first RTT sample.
+    void (*ack)(tcp_cong_t *cc, uint32_t acked, uint32_t srtt_us);
+    // A loss was detected with flight bytes outstanding: the new ssthresh
+    uint32_t (*ssthresh)(tcp_cong_t *cc, uint32_t flight);
+} tcp_cong_ops_t;
+
+extern const tcp_cong_ops_t tcp_cong_newreno;
+extern const tcp_cong_ops_t tcp_cong_cubic;
+
+// Initial window for a new connection (RFC 5681) and the algorithm's state
+void tcp_cong_init(tcp_cong_t *cc, const tcp_cong_ops_t *ops, uint32_t mss);
+
+// Algorithms by name, or by index until NULL
+const tcp_cong_ops_t *tcp_cong_find(const char *name);
+const tcp_cong_ops_t *tcp_cong_get(int index);
+
+// What new connections use
+const tcp_cong_ops_t *tcp_cong_default(void);
+void tcp_cong_set_default(const tcp_cong_ops_t *ops);
+
+#endif
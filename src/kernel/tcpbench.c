@@ -0,0 +1,98 @@
+#include "net_defs.h"
+#include "cmd.h"
+#include "clock.h"
+
+#define TCPBENCH_DEFAULT_KB 4096
+#define TCPBENCH_CHUNK 16384
+
+static char chunk[TCPBENCH_CHUNK];
+
+static const char *parse_uint(const char *p, uint32_t *out) {
+    uint32_t v = 0;
+    if (*p < '0' || *p > '9') return NULL;
+    while (*p >= '0' && *p <= '9') v = v * 10 + (uint32_t)(*p++ - '0');
+    *out = v;
+    return p;
+}
+
+// tcpbench <ip> <port> [KB] [algorithm] - bulk send to a discard server,
+// e.g. "nc -l 5001 > /dev/null" on the host
+void cli_cmd_tcpbench(char *args) {
+    const char *usage = "Usage: tcpbench <ip> <port> [KB] [newreno|cubic]\n";
+    if (!args || !*args) {
+        cmd_write(usage);
+        return;
+    }
+
+    ipv4_address_t ip;
+    const char *p = args;
+    uint32_t v;
+    for (int i = 0; i < 4; i++) {
+        p = parse_uint(p, &v);
+        if (!p || v > 255 || *p != (i < 3 ? '.' : ' ')) {
+            cmd_write(usage);
+            return;
+        }
+        ip.bytes[i] = (uint8_t)v;
+        p++;
+    }
+    uint32_t port;
+    while (*p == ' ') p++;
+    p = parse_uint(p, &port);
+    if (!p || !port || port > 65535) {
+        cmd_write(usage);
+        return;
+    }
+    uint32_t kb = TCPBENCH_DEFAULT_KB;
+    while (*p == ' ') p++;
+    if (*p >= '0' && *p <= '9') {
+        p = parse_uint(p, &kb);
+        while (*p == ' ') p++;
+    }
+    const char *cong = *p ? p : NULL;
+
+    tcp_socket_t *sock = tcp_connect(ip, (uint16_t)port);
+    if (!sock) {
+        cmd_write("Connection failed.\n");
+        return;
+    }
+    if (cong && !tcp_set_congestion(sock, cong)) {
+        cmd_write(usage);
+        tcp_close(sock);
+        return;
+    }
+    for (int i = 0; i < TCPBENCH_CHUNK; i++) chunk[i] = (char)('a' + i % 26);
+
+    uint64_t bytes = (uint64_t)kb * 1024;
+    uint64_t start = clock_monotonic_ns();
+    for (uint64_t left = bytes; left; ) {
+        int n = left > TCPBENCH_CHUNK ? TCPBENCH_CHUNK : (int)left;
+        tcp_send(sock, chunk, n);
+        left -= (uint64_t)n;
+    }
+    tcp_info_t info;
+    tcp_get_info(sock, &info);
+    // Returns once the tail of the data and our FIN are acked
+    tcp_close(sock);
+    uint64_t us = (clock_monotonic_ns() - start) / CLOCK_NS_PER_US;
+    if (!us) us = 1;
+
+    cmd_write_int((int)kb);
+    cmd_write(" KB in ");
+    cmd_write_int((int)(us / 1000));
+    cmd_write(" ms, ");
+    cmd_write_int((int)(bytes * 1000000 / 1024 / us));
+    cmd_write(" KB/s with ");
+    cmd_write(info.cong);
+    cmd_write("\ncwnd ");
+    cmd_write_int((int)info.cwnd);
+    cmd_write(" srtt ");
+    cmd_write_int((int)info.srtt_us);
+    cmd_write("us retrans ");
+    cmd_write_int((int)info.retransmits);
+    cmd_write(" (fast ");
+    cmd_write_int((int)info.fast_retransmits);
+    cmd_write(", timeouts ");
+    cmd_write_int((int)info.timeouts);
+    cmd_write(")\n");
+}
@@ -0,0 +1,296 @@
+#include "thread.h"
+#include "clock.h"
+#include "memory_manager.h"
+#include "smp.h"
+#include "io.h"
+#include "trace.h"
+#include <stddef.h>
+
+extern void context_switch(uint64_t *old_rsp, uint64_t new_rsp);
+extern void thread_trampoline(void);
+
+static Thread boot_thread;
+static Thread *idle_thread = NULL;
+static Thread *current = NULL;
+static Thread *all_threads = NULL;
+static Thread *dead_threads = NULL;     // Freed by whoever runs next
+
+static Thread *run_head[THREAD_PRIORITIES];
+static Thread *run_tail[THREAD_PRIORITIES];
+
+static volatile bool need_resched = false;
+static volatile int preempt_count = 0;
+static Timer slice_timer;
+static int next_id = 0;
+
+static void copy_name(char *dst, const char *src) {
+    int i = 0;
+    while (src[i] && i < THREAD_NAME_LEN - 1) {
+        dst[i] = src[i];
+        i++;
+    }
+    dst[i] = 0;
+}
+
+// --- Run queues (interrupts must be off) ---
+
+static void runqueue_push(Thread *t) {
+    t->next = NULL;
+    if (run_tail[t->priority]) {
+        run_tail[t->priority]->next = t;
+    } else {
+        run_head[t->priority] = t;
+    }
+    run_tail[t->priority] = t;
+}
+
+static Thread *runqueue_pop(void) {
+    for (int p = 0; p < THREAD_PRIORITIES; p++) {
+        Thread *t = run_head[p];
+        if (t) {
+            run_head[p] = t->next;
+            if (!run_head[p]) run_tail[p] = NULL;
+            t->next = NULL;
+            return t;
+        }
+    }
+    return NULL;
+}
+
+// Highest priority with a ready thread, or THREAD_PRIORITIES if none
+static int runqueue_top(void) {
+    for (int p = 0; p < THREAD_PRIORITIES; p++) {
+        if (run_head[p]) return p;
+    }
+    return THREAD_PRIORITIES;
+}
+
+static void slice_expired(void *arg) {
+    (void)arg;
+    need_resched = true;
+}
+
+static void reap_dead(void) {
+    while (dead_threads) {
+        Thread *t = dead_threads;
+        dead_threads = t->next;
+
+        Thread **p = &all_threads;
+        while (*p && *p != t) p = &(*p)->all_next;
+        if (*p) *p = t->all_next;
+
+        kfree(t->stack);
+        kfree(t);
+    }
+}
+
+// Pick the next thread and switch to it. Interrupts must be off.
+static void schedule(void) {
+    Thread *prev = current;
+    need_resched = false;
+
+    if (prev->state == THREAD_RUNNING) {
+        prev->state = THREAD_READY;
+        if (prev != idle_thread) runqueue_push(prev);
+    }
+
+    Thread *next = runqueue_pop();
+    if (!next) next = idle_thread;
+
+    // Round-robin only matters while others of the same priority wait
+    if (runqueue_top() <= next->priority && next != idle_thread) {
+        timer_start(&slice_timer, clock_monotonic_ns() + SCHED_SLICE_NS, slice_expired, NULL);
+    } else {
+        timer_cancel(&slice_timer);
+    }
+
+    next->state = THREAD_RUNNING;
+    if (next == prev) return;
+
+    uint64_t now = clock_cycles();
+    prev->runtime_cycles += now - prev->switched_in;
+    next->switched_in = now;
+    next->switches++;
+    TRACE_INSTANT(TRACE_CAT_SCHED, "switch", next->id);
+    current = next;
+
+    context_switch(&prev->rsp, next->rsp);
+
+    // Back on prev's stack
+    reap_dead();
+}
+
+// --- Threads ---
+
+// A new thread's first switch lands here, still with interrupts disabled
+void thread_entry(void) {
+    irqoff_end();
+    asm volatile ("sti");
+    current->fn(current->arg);
+    thread_exit();
+}
+
+static void idle_loop(void *arg) {
+    (void)arg;
+    for (;;) {
+        irqoff_end();
+        asm volatile ("sti; hlt");
+    }
+}
+
+static Thread *thread_alloc(const char *name, ThreadFn fn, void *arg, int priority) {
+    Thread *t = (Thread *)kmalloc(sizeof(Thread));
+    if (!t) return NULL;
+    t->stack = (uint8_t *)kmalloc(THREAD_STACK_SIZE);
+    if (!t->stack) {
+        kfree(t);
+        return NULL;
+    }
+
+    copy_name(t->name, name);
+    t->fn = fn;
+    t->arg = arg;
+    t->state = THREAD_BLOCKED;          // Until thread_create() wakes it
+    t->priority = priority < 0 ? 0 : (priority >= THREAD_PRIORITIES ? THREAD_PRIORITIES - 1 : priority);
+
+    // Initial frame for context_switch: six callee-saved registers, then the
+    // return address. The stack is 16-byte aligned when the trampoline runs.
+    uint64_t *sp = (uint64_t *)(((uint64_t)t->stack + THREAD_STACK_SIZE) & ~0xFULL);
+    *--sp = (uint64_t)thread_trampoline;
+    for (int i = 0; i < 6; i++) *--sp = 0;
+    t->rsp = (uint64_t)sp;
+
+    uint64_t flags = irq_save();
+    t->id = next_id++;
+    t->all_next = all_threads;
+    all_threads = t;
+    irq_restore(flags);
+    return t;
+}
+
+void sched_init(const char *name, int priority) {
+    Thread *t = &boot_thread;
+    copy_name(t->name, name);
+    t->id = next_id++;
+    t->priority = priority;
+    t->state = THREAD_RUNNING;
+    t->switched_in = clock_cycles();
+    t->all_next = NULL;
+    all_threads = t;
+
+    // Runs whenever the run queues are empty; it is never queued itself
+    idle_thread = thread_alloc("idle", idle_loop, NULL, THREAD_PRIORITIES - 1);
+    if (!idle_thread) return;
+    idle_thread->state = THREAD_READY;
+    current = t;
+}
+
+bool sched_running(void) {
+    return current != NULL;
+}
+
+Thread *thread_create(const char *name, ThreadFn fn, void *arg, int priority) {
+    if (!current) return NULL;
+    Thread *t = thread_alloc(name, fn, arg, priority);
+    if (!t) return NULL;
+    thread_wake(t);
+    return t;
+}
+
+Thread *thread_current(void) {
+    return current;
+}
+
+void thread_yield(void) {
+    if (!current) return;
+    uint64_t flags = irq_save();
+    schedule();
+    irq_restore(flags);
+}
+
+static void sleep_expired(void *arg) {
+    thread_wake((Thread *)arg);
+}
+
+void thread_sleep(uint64_t ns) {
+    if (!current) {
+        timer_sleep_until(clock_monotonic_ns() + ns);
+        return;
+    }
+    uint64_t flags = irq_save();
+    timer_start(&current->sleep_timer, clock_monotonic_ns() + ns, sleep_expired, current);
+    thread_block();
+    irq_restore(flags);
+}
+
+void thread_exit(void) {
+    asm volatile ("cli");
+    current->state = THREAD_DEAD;
+    current->next = dead_threads;
+    dead_threads = current;
+    schedule();
+    for (;;) asm volatile ("hlt");
+}
+
+void thread_block(void) {
+    current->state = THREAD_BLOCKED;
+    schedule();
+}
+
+void thread_wake(Thread *t) {
+    uint64_t flags = irq_save();
+    if (t->state == THREAD_BLOCKED) {
+        t->state = THREAD_READY;
+        runqueue_push(t);
+        if (current == idle_thread || t->priority < current->priority) {
+            need_resched = true;
+        } else if (t->priority == current->priority && !timer_pending(&slice_timer)) {
+            timer_start(&slice_timer, clock_monotonic_ns() + SCHED_SLICE_NS, slice_expired, NULL);
+        }
+    }
+    irq_restore(flags);
+    thread_preempt_point();
+}
+
+void thread_preempt_point(void) {
+    uint64_t flags;
+    asm volatile ("pushfq; pop %0" : "=r"(flags));
+    if (need_resched && (flags & 0x200) && !preempt_count) thread_yield();
+}
+
+void preempt_disable(void) {
+    preempt_count++;
+}
+
+void preempt_enable(void) {
+    preempt_count--;
+}
+
+void sched_irq_exit(void) {
+    if (!current || !need_resched || preempt_count || this_cpu()->id != 0) return;
+    schedule();
+}
+
+// --- Introspection ---
+
+int thread_snapshot(Thread *out, int max) {
+    uint64_t flags = irq_save();
+    int n = 0;
+    for (Thread *t = all_threads; t && n < max; t = t->all_next) {
+        out[n] = *t;
+        if (t == current) out[n].runtime_cycles += clock_cycles() - t->switched_in;
+        n++;
+    }
+    irq_restore(flags);
+    return n;
+}
+
+const char *thread_state_name(ThreadState state) {
+    switch (state) {
+        case THREAD_READY:   return "ready";
+        case THREAD_RUNNING: return "running";
+        case THREAD_BLOCKED: return "blocked";
+        case THREAD_DEAD:    return "dead";
+    }
+    return "?";
+}
@@ -0,0 +1,79 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "timer.h"
+
+// Kernel threads with a preemptive priority round-robin scheduler. Threads of
+// the highest ready priority share the CPU in SCHED_SLICE_NS slices; a thread
+// woken at a higher priority preempts straight away (on the way out of the
+// interrupt that woke it). Scheduling happens on the bootstrap processor only.
+
+#define THREAD_PRIORITY_HIGH   0    // UI / input
+#define THREAD_PRIORITY_NORMAL 1    // Shell commands
+#define THREAD_PRIORITY_LOW    2
+#define THREAD_PRIORITIES      3
+
+#define THREAD_STACK_SIZE (64 * 1024)
+#define THREAD_NAME_LEN 24
+#define SCHED_SLICE_NS (10 * 1000 * 1000ULL)
+
+typedef void (*ThreadFn)(void *arg);
+
+typedef enum {
+    THREAD_READY,
+    THREAD_RUNNING,
+    THREAD_BLOCKED,
+    THREAD_DEAD
+} ThreadState;
+
+typedef struct Thread {
+    uint64_t rsp;               // Saved stack pointer while switched out
+    int id;
+    char name[THREAD_NAME_LEN];
+    ThreadState state;
+    int priority;
+    uint8_t *stack;             // NULL for the boot thread
+    ThreadFn fn;
+    void *arg;
+    Timer sleep_timer;
+    uint64_t runtime_cycles;
+    uint64_t switched_in;       // clock_cycles() when it last got the CPU
+    uint64_t switches;
+    struct Thread *next;        // Run queue / dead list
+    struct Thread *all_next;
+} Thread;
+
+// Turn the caller (kmain) into the first thread and start the idle thread
+void sched_init(const char *name, int priority);
+bool sched_running(void);
+
+Thread *thread_create(const char *name, ThreadFn fn, void *arg, int priority);
+Thread *thread_current(void);
+void thread_yield(void);
+void thread_sleep(uint64_t ns);
+__attribute__((noreturn)) void thread_exit(void);
+
+// Blocking primitives for wait queues and the like. thread_block() must be
+// called with interrupts disabled; it returns once someone calls
+// thread_wake() on the thread. thread_wake() may be called from interrupts.
+void thread_block(void);
+void thread_wake(Thread *t);
+
+// Switch now if a higher-priority thread is waiting and interrupts are on
+void thread_preempt_point(void);
+
+// Hold off preemption (on the bootstrap processor) without disabling
+// interrupts, e.g. while softirqs run. Calls nest.
+void preempt_disable(void);
+void preempt_enable(void);
+
+// Called from irq_exit() once the handler has sent its EOI
+void sched_irq_exit(void);
+
+// Walk all threads (for the threads command); returns the count copied
+int thread_snapshot(Thread *out, int max);
+const char *thread_state_name(ThreadState state);
+
+#endif
@@ -0,0 +1,222 @@
+#include "timer.h"
+#include "clock.h"
+#include "apic.h"
+#include "idt.h"
+#include "io.h"
+#include "softirq.h"
+#include "irqstat.h"
+#include <stddef.h>
+
+#define LEVEL_BITS 6
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define WHEEL_MAX_DELTA ((1ULL << (LEVEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+#define NO_EVENT UINT64_MAX
+
+static Timer *wheel[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+static uint64_t occupied[TIMER_WHEEL_LEVELS];   // One bit per non-empty slot
+static uint64_t wheel_clock = 0;                // Last tick processed
+static Timer *expired = NULL;                   // Waiting for the timer softirq
+static uint64_t interrupts = 0;
+static uint64_t programmed = 0;                 // Deadline the APIC timer is set for, ns
+
+// --- Wheel (interrupts must be off) ---
+
+static void list_add(Timer **head, Timer *t) {
+    t->next = *head;
+    if (*head) (*head)->pprev = &t->next;
+    t->pprev = head;
+    *head = t;
+}
+
+static void timer_unlink(Timer *t) {
+    *t->pprev = t->next;
+    if (t->next) t->next->pprev = t->pprev;
+    if (t->slot >= 0 && !wheel[t->slot]) {
+        occupied[t->slot / TIMER_WHEEL_SLOTS] &= ~(1ULL << (t->slot & SLOT_MASK));
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+    t->pending = false;
+}
+
+// The level is picked by distance from the wheel clock; the slot by the
+// expiry tick's digit at that level
+static void wheel_add(Timer *t) {
+    uint64_t delta = t->expires - wheel_clock;
+    if (delta > WHEEL_MAX_DELTA) {
+        delta = WHEEL_MAX_DELTA;
+        t->expires = wheel_clock + delta;
+    }
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << (LEVEL_BITS * (level + 1)))) level++;
+    int slot = (int)((t->expires >> (LEVEL_BITS * level)) & SLOT_MASK);
+
+    t->slot = level * TIMER_WHEEL_SLOTS + slot;
+    list_add(&wheel[t->slot], t);
+    occupied[level] |= 1ULL << slot;
+}
+
+// Next tick after the wheel clock at which an occupied slot either expires
+// (level 0) or cascades (upper levels)
+static uint64_t wheel_next_event(void) {
+    uint64_t next = NO_EVENT;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (!occupied[level]) continue;
+        int shift = LEVEL_BITS * level;
+        uint64_t base = (wheel_clock >> shift) + 1;
+        uint64_t bits = occupied[level];
+        int rot = (int)(base & SLOT_MASK);
+        if (rot) bits = (bits >> rot) | (bits << (TIMER_WHEEL_SLOTS - rot));
+        uint64_t tick = (base + (uint64_t)__builtin_ctzll(bits)) << shift;
+        if (tick < next) next = tick;
+    }
+    return next;
+}
+
+static void wheel_cascade(int level) {
+    int index = level * TIMER_WHEEL_SLOTS + (int)((wheel_clock >> (LEVEL_BITS * level)) & SLOT_MASK);
+    Timer *t = wheel[index];
+    wheel[index] = NULL;
+    occupied[level] &= ~(1ULL << (index & SLOT_MASK));
+    while (t) {
+        Timer *next = t->next;
+        wheel_add(t);
+        t = next;
+    }
+}
+
+// Advance the wheel clock to now, moving everything due to the expired list.
+// Empty stretches are skipped in one step.
+static void wheel_advance(uint64_t now_tick) {
+    while (wheel_clock < now_tick) {
+        uint64_t next = wheel_next_event();
+        if (next > now_tick) {
+            wheel_clock = now_tick;
+            break;
+        }
+        wheel_clock = next;
+
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if (wheel_clock & ((1ULL << (LEVEL_BITS * level)) - 1)) break;
+            wheel_cascade(level);
+        }
+
+        int slot = (int)(wheel_clock & SLOT_MASK);
+        while (wheel[slot]) {
+            Timer *t = wheel[slot];
+            timer_unlink(t);
+            t->pending = true;
+            t->slot = -1;
+            list_add(&expired, t);
+        }
+    }
+}
+
+// Arm the hardware for the next wheel event. On the PIC fallback the PIT
+// keeps ticking at TIMER_HZ and there is nothing to program.
+static void timer_program(void) {
+    if (!irq_using_apic()) return;
+    uint64_t next = wheel_next_event();
+    if (next == NO_EVENT) {
+        apic_timer_stop();
+        programmed = 0;
+        return;
+    }
+    uint64_t deadline = next * TIMER_TICK_NS;
+    uint64_t now = clock_monotonic_ns();
+    programmed = deadline;
+    apic_timer_oneshot_ns(deadline > now ? deadline - now : 0, IRQ_VECTOR(0));
+}
+
+// --- Timers ---
+
+void timer_start(Timer *t, uint64_t deadline_ns, TimerCallback callback, void *arg) {
+    uint64_t flags = irq_save();
+    if (t->pending) timer_unlink(t);
+
+    t->deadline = deadline_ns;
+    t->callback = callback;
+    t->arg = arg;
+    t->pending = true;
+
+    // The wheel clock only moves in the interrupt, so a deadline it has
+    // already passed goes in the next slot and fires on the next interrupt
+    uint64_t ticks = (deadline_ns + TIMER_TICK_NS - 1) / TIMER_TICK_NS;
+    t->expires = ticks > wheel_clock ? ticks : wheel_clock + 1;
+
+    uint64_t before = wheel_next_event();
+    wheel_add(t);
+
+    // Only a new earliest event changes what the hardware waits for
+    if (wheel_next_event() < before) timer_program();
+    irq_restore(flags);
+}
+
+void timer_cancel(Timer *t) {
+    uint64_t flags = irq_save();
+    if (t->pending) timer_unlink(t);
+    irq_restore(flags);
+}
+
+bool timer_pending(const Timer *t) {
+    return t->pending;
+}
+
+static void timer_wake(void *arg) {
+    *(volatile bool *)arg = true;
+}
+
+void timer_sleep_until(uint64_t deadline_ns) {
+    volatile bool done = false;
+    Timer t = {0};
+    timer_start(&t, deadline_ns, timer_wake, (void *)&done);
+
+    // sti only takes effect after the following instruction, so an interrupt
+    // can't slip in between the check and the hlt
+    while (!done) {
+        asm volatile ("cli");
+        if (done) {
+            asm volatile ("sti");
+            break;
+        }
+        asm volatile ("sti; hlt");
+    }
+}
+
+void timer_interrupt(void) {
+    interrupts++;
+    uint64_t now = clock_monotonic_ns();
+    if (programmed) {
+        irqstat_timer_latency(now > programmed ? now - programmed : 0);
+        programmed = 0;
+    }
+    wheel_advance(now / TIMER_TICK_NS);
+    if (expired) softirq_raise(SOFTIRQ_TIMER);
+    timer_program();
+}
+
+static void timer_softirq(void) {
+    for (;;) {
+        uint64_t flags = irq_save();
+        Timer *t = expired;
+        if (!t) {
+            irq_restore(flags);
+            break;
+        }
+        timer_unlink(t);
+        TimerCallback callback = t->callback;
+        void *arg = t->arg;
+        irq_restore(flags);
+
+        callback(arg);
+    }
+}
+
+void timer_init(void) {
+    softirq_register(SOFTIRQ_TIMER, timer_softirq);
+}
+
+uint64_t timer_interrupt_count(void) {
+    return interrupts;
+}
@@ -0,0 +1,55 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// One-shot software timers on clock_monotonic_ns() deadlines, kept in a
+// hierarchical timing wheel: TIMER_WHEEL_LEVELS levels of 64 slots, level 0
+// one tick per slot and each level above 64 times coarser. Starting and
+// cancelling a timer are O(1); timers in the upper levels cascade down as
+// their slot comes round, so nothing scans the pending timers. Deadlines are
+// rounded up to the next TIMER_TICK_NS tick, so a timer never fires early.
+//
+// With the local APIC the hardware timer is armed for the next occupied slot
+// only, so an idle system sleeps until something is actually due. On the PIC
+// fallback the PIT keeps ticking and the wheel catches up on each tick.
+//
+// The interrupt only moves expired timers to a list; their callbacks run from
+// the timer softirq (softirq.h), with interrupts enabled and preemption off.
+// Callbacks must not block; heavy work belongs on a work queue. A timer may
+// be restarted from its own callback.
+
+#define TIMER_TICK_NS (1000 * 1000ULL)
+#define TIMER_WHEEL_LEVELS 6
+#define TIMER_WHEEL_SLOTS 64
+
+typedef void (*TimerCallback)(void *arg);
+
+typedef struct Timer {
+    uint64_t deadline;          // clock_monotonic_ns()
+    uint64_t expires;           // Wheel tick
+    TimerCallback callback;
+    void *arg;
+    bool pending;
+    int slot;                   // Wheel slot, or -1 once expired
+    struct Timer *next;
+    struct Timer **pprev;
+} Timer;
+
+// Register the timer softirq; before interrupts are enabled
+void timer_init(void);
+
+// (Re)arm t; a pending timer is moved to the new deadline
+void timer_start(Timer *t, uint64_t deadline_ns, TimerCallback callback, void *arg);
+void timer_cancel(Timer *t);
+bool timer_pending(const Timer *t);
+
+// Halt until deadline_ns. Must be called with interrupts enabled.
+void timer_sleep_until(uint64_t deadline_ns);
+
+// Called from the IRQ 0 handler
+void timer_interrupt(void);
+uint64_t timer_interrupt_count(void);
+
+#endif
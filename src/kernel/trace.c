@@ -0,0 +1,215 @@
+#include "trace.h"
+#include "clock.h"
+#include "thread.h"
+#include "smp.h"
+#include "fat32.h"
+#include "memory_manager.h"
+#include <stddef.h>
+
+volatile uint32_t trace_mask = 0;
+
+static TraceRecord *ring = NULL;
+static volatile uint64_t write_index = 0;      // Next slot to claim
+static uint64_t clear_index = 0;               // Records before this are discarded
+
+static const char *category_names[TRACE_CAT_COUNT] = {
+    "irq", "sched", "wm", "net", "mem", "fs", "vm"
+};
+
+void trace_write(uint32_t category, TracePhase phase, const char *name, uint64_t arg) {
+    TraceRecord *r0 = ring;
+    if (!r0) return;
+
+    uint64_t idx = __atomic_fetch_add(&write_index, 1, __ATOMIC_RELAXED);
+    TraceRecord *r = &r0[idx & (TRACE_RING_SIZE - 1)];
+
+    // Readers skip the slot until seq matches again
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+    r->cycles = clock_cycles();
+    r->name = name;
+    r->arg = arg;
+    int cpu = this_cpu()->id;
+    r->cpu = (uint16_t)cpu;
+    Thread *t = cpu == 0 ? thread_current() : NULL;
+    r->tid = t ? (int16_t)t->id : -1;
+    r->phase = (uint8_t)phase;
+    r->category = (uint8_t)__builtin_ctz(category);
+    __atomic_store_n(&r->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+bool trace_set_mask(uint32_t mask) {
+    if (mask && !ring) {
+        TraceRecord *r = (TraceRecord *)kmalloc(sizeof(TraceRecord) * TRACE_RING_SIZE);
+        if (!r) return false;
+        for (int i = 0; i < TRACE_RING_SIZE; i++) r[i].seq = 0;
+        ring = r;
+    }
+    trace_mask = mask & TRACE_CAT_ALL;
+    return true;
+}
+
+void trace_clear(void) {
+    clear_index = write_index;
+}
+
+uint64_t trace_recorded(void) {
+    return write_index - clear_index;
+}
+
+const char *trace_category_name(int bit) {
+    if (bit < 0 || bit >= TRACE_CAT_COUNT) return "?";
+    return category_names[bit];
+}
+
+int trace_category_bit(const char *name) {
+    for (int i = 0; i < TRACE_CAT_COUNT; i++) {
+        const char *a = category_names[i];
+        const char *b = name;
+        while (*a && *a == *b) {
+            a++;
+            b++;
+        }
+        if (!*a && !*b) return i;
+    }
+    return -1;
+}
+
+// --- JSON dump ---
+// The file is written in small chunks so the dump needs no big buffer.
+
+#define CHUNK_SIZE 4096
+#define CHUNK_SLACK 512             // Longest single event, with room to spare
+
+typedef struct {
+    FAT32_FileHandle *fh;
+    char buf[CHUNK_SIZE + CHUNK_SLACK];
+    int len;
+    bool first;
+    bool failed;
+} JsonOut;
+
+static void out_flush(JsonOut *o) {
+    if (o->len == 0 || o->failed) return;
+    if (fat32_write(o->fh, o->buf, o->len) != o->len) o->failed = true;
+    o->len = 0;
+}
+
+static void out_str(JsonOut *o, const char *s) {
+    while (*s) o->buf[o->len++] = *s++;
+}
+
+static void out_u64(JsonOut *o, uint64_t v) {
+    char tmp[21];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n) o->buf[o->len++] = tmp[--n];
+}
+
+static void out_int(JsonOut *o, int v) {
+    if (v < 0) {
+        o->buf[o->len++] = '-';
+        v = -v;
+    }
+    out_u64(o, (uint64_t)v);
+}
+
+// Chrome wants microseconds; keep nanosecond precision as decimals
+static void out_us(JsonOut *o, uint64_t ns) {
+    out_u64(o, ns / 1000);
+    int frac = (int)(ns % 1000);
+    o->buf[o->len++] = '.';
+    o->buf[o->len++] = (char)('0' + frac / 100);
+    o->buf[o->len++] = (char)('0' + frac / 10 % 10);
+    o->buf[o->len++] = (char)('0' + frac % 10);
+}
+
+static void out_begin_event(JsonOut *o) {
+    out_str(o, o->first ? "{" : ",\n{");
+    o->first = false;
+}
+
+static void out_end_event(JsonOut *o) {
+    out_str(o, "}");
+    if (o->len >= CHUNK_SIZE) out_flush(o);
+}
+
+static void out_metadata(JsonOut *o, const char *kind, int pid, int tid, const char *name) {
+    out_begin_event(o);
+    out_str(o, "\"name\":\""); out_str(o, kind);
+    out_str(o, "\",\"ph\":\"M\",\"pid\":"); out_int(o, pid);
+    out_str(o, ",\"tid\":"); out_int(o, tid);
+    out_str(o, ",\"args\":{\"name\":\""); out_str(o, name);
+    out_str(o, "\"}");
+    out_end_event(o);
+}
+
+int trace_dump_json(const char *path) {
+    if (!ring) return 0;
+    uint32_t saved_mask = trace_mask;
+    trace_mask = 0;
+
+    static JsonOut out;
+    JsonOut *o = &out;
+    o->fh = fat32_open(path, "w");
+    if (!o->fh) {
+        trace_mask = saved_mask;
+        return -1;
+    }
+    o->len = 0;
+    o->first = true;
+    o->failed = false;
+
+    out_str(o, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    // Name the tracks: one process per CPU, threads by name
+    char label[16];
+    for (int cpu = 0; cpu < smp_cpu_count(); cpu++) {
+        label[0] = 'C'; label[1] = 'P'; label[2] = 'U'; label[3] = ' ';
+        int n = 4;
+        if (cpu >= 10) label[n++] = (char)('0' + cpu / 10);
+        label[n++] = (char)('0' + cpu % 10);
+        label[n] = 0;
+        out_metadata(o, "process_name", cpu, 0, label);
+    }
+    static Thread threads[32];
+    int thread_count = thread_snapshot(threads, 32);
+    for (int i = 0; i < thread_count; i++) {
+        out_metadata(o, "thread_name", 0, threads[i].id, threads[i].name);
+    }
+
+    uint64_t end = write_index;
+    uint64_t start = clear_index;
+    if (end - start > TRACE_RING_SIZE) start = end - TRACE_RING_SIZE;
+
+    int events = 0;
+    uint64_t base = 0;
+    for (uint64_t idx = start; idx < end; idx++) {
+        TraceRecord *r = &ring[idx & (TRACE_RING_SIZE - 1)];
+        if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != idx + 1) continue;
+        if (events == 0) base = r->cycles;
+        uint64_t ns = r->cycles > base ? clock_cycles_to_ns(r->cycles - base) : 0;
+
+        char phase[2] = {(char)r->phase, 0};
+        out_begin_event(o);
+        out_str(o, "\"name\":\""); out_str(o, r->name);
+        out_str(o, "\",\"cat\":\""); out_str(o, trace_category_name(r->category));
+        out_str(o, "\",\"ph\":\""); out_str(o, phase);
+        out_str(o, "\",\"ts\":"); out_us(o, ns);
+        out_str(o, ",\"pid\":"); out_int(o, r->cpu);
+        out_str(o, ",\"tid\":"); out_int(o, r->tid);
+        if (r->phase == TRACE_PH_INSTANT) out_str(o, ",\"s\":\"t\"");
+        out_str(o, ",\"args\":{\"arg\":"); out_u64(o, r->arg);
+        out_str(o, "}");
+        out_end_event(o);
+        events++;
+    }
+
+    out_str(o, "\n]}\n");
+    out_flush(o);
+    fat32_close(o->fh);
+    trace_mask = saved_mask;
+    return o->failed ? -1 : events;
+}
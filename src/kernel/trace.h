@@ -0,0 +1,72 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Event tracing. Static tracepoints throughout the kernel write fixed-size
+// records, timestamped with clock_cycles(), into one ring buffer shared by
+// all CPUs. Writers claim a slot with an atomic increment and never wait, so
+// a tracepoint is safe anywhere, interrupt handlers included. When the ring
+// is full the oldest records are overwritten.
+//
+// Tracepoints are grouped into categories that are switched on and off at
+// run time; a disabled tracepoint costs one load and a branch. The trace
+// command dumps the ring as Chrome trace JSON (chrome://tracing, Perfetto),
+// with begin/end pairs shown as nested spans per CPU and thread.
+
+#define TRACE_CAT_IRQ    (1u << 0)      // Interrupt handlers and softirqs
+#define TRACE_CAT_SCHED  (1u << 1)      // Context switches
+#define TRACE_CAT_WM     (1u << 2)      // Frames
+#define TRACE_CAT_NET    (1u << 3)      // Packets in and out
+#define TRACE_CAT_MEM    (1u << 4)      // kmalloc / kfree
+#define TRACE_CAT_FS     (1u << 5)      // FAT32 open / read / write
+#define TRACE_CAT_VM     (1u << 6)      // Bytecode VM syscalls
+#define TRACE_CAT_COUNT  7
+#define TRACE_CAT_ALL    ((1u << TRACE_CAT_COUNT) - 1)
+
+#define TRACE_RING_SIZE 8192            // Records; must be a power of two
+
+typedef enum {
+    TRACE_PH_BEGIN = 'B',
+    TRACE_PH_END = 'E',
+    TRACE_PH_INSTANT = 'i'
+} TracePhase;
+
+typedef struct {
+    uint64_t seq;               // Claimed index + 1 once the record is complete
+    uint64_t cycles;
+    const char *name;           // Static string
+    uint64_t arg;
+    uint16_t cpu;
+    int16_t tid;                // Thread id, -1 outside any thread
+    uint8_t phase;
+    uint8_t category;           // Bit number of the category
+} TraceRecord;
+
+extern volatile uint32_t trace_mask;
+
+void trace_write(uint32_t category, TracePhase phase, const char *name, uint64_t arg);
+
+#define trace_enabled(cat) (trace_mask & (cat))
+#define TRACE_BEGIN(cat, name, arg) \
+    do { if (trace_enabled(cat)) trace_write((cat), TRACE_PH_BEGIN, (name), (uint64_t)(arg)); } while (0)
+#define TRACE_END(cat, name, arg) \
+    do { if (trace_enabled(cat)) trace_write((cat), TRACE_PH_END, (name), (uint64_t)(arg)); } while (0)
+#define TRACE_INSTANT(cat, name, arg) \
+    do { if (trace_enabled(cat)) trace_write((cat), TRACE_PH_INSTANT, (name), (uint64_t)(arg)); } while (0)
+
+// Enable the given categories (allocating the ring on first use); 0 turns
+// tracing off but keeps what was recorded
+bool trace_set_mask(uint32_t mask);
+void trace_clear(void);
+uint64_t trace_recorded(void);          // Records written since the last clear
+
+const char *trace_category_name(int bit);
+int trace_category_bit(const char *name);   // -1 if unknown
+
+// Write the ring as Chrome trace JSON. Tracing is paused meanwhile. Returns
+// the number of events written, or -1 if the file could not be written.
+int trace_dump_json(const char *path);
+
+#endif
@@ -8,6 +8,7 @@
 #include "ps2.h"
 #include "cli_apps/cli_utils.h"
 #include "io.h"
+#include "trace.h"
 
 // --- Scancode Map (Set 1) ---
 static char vm_scancode_map[128] = {
@@ -585,7 +586,9 @@ int vm_exec(const uint8_t *code, int code_size) {
                 id |= memory[pc++] << 8;
                 id |= memory[pc++] << 16;
                 id |= memory[pc++] << 24;
+                TRACE_BEGIN(TRACE_CAT_VM, "vm_syscall", id);
                 vm_syscall(id);
+                TRACE_END(TRACE_CAT_VM, "vm_syscall", id);
                 break;
             }
             case OP_PUSH_PTR: {
@@ -0,0 +1,117 @@
+#include "wait.h"
+#include "thread.h"
+#include "timer.h"
+#include <stddef.h>
+
+void wait_queue_init(WaitQueue *wq) {
+    wq->head = NULL;
+}
+
+static void waiter_remove(WaitQueue *wq, Waiter *w) {
+    Waiter **p = &wq->head;
+    while (*p && *p != w) p = &(*p)->next;
+    if (*p) *p = w->next;
+}
+
+static void waiter_timeout(void *arg) {
+    Waiter *w = (Waiter *)arg;
+    if (w->thread) thread_wake(w->thread);
+}
+
+bool wait_queue_sleep(WaitQueue *wq, uint64_t deadline_ns) {
+    Waiter w;
+    w.thread = thread_current();
+    w.woken = false;
+
+    // FIFO, so wake_one() serves the longest waiter first
+    w.next = NULL;
+    Waiter **p = &wq->head;
+    while (*p) p = &(*p)->next;
+    *p = &w;
+
+    // Also ends the halt on the pre-scheduler path when no other interrupt is due
+    Timer timeout = {0};
+    timer_start(&timeout, deadline_ns, waiter_timeout, &w);
+
+    if (w.thread) {
+        thread_block();
+    } else {
+        irqoff_end();
+        asm volatile ("sti; hlt; cli" ::: "memory");
+        irqoff_begin();
+    }
+
+    timer_cancel(&timeout);
+    if (!w.woken) waiter_remove(wq, &w);
+    return w.woken;
+}
+
+static bool wake_first(WaitQueue *wq) {
+    Waiter *w = wq->head;
+    if (!w) return false;
+    wq->head = w->next;
+    w->woken = true;
+    if (w->thread) thread_wake(w->thread);
+    return true;
+}
+
+void wait_queue_wake_one(WaitQueue *wq) {
+    uint64_t flags = irq_save();
+    wake_first(wq);
+    irq_restore(flags);
+    thread_preempt_point();
+}
+
+void wait_queue_wake_all(WaitQueue *wq) {
+    uint64_t flags = irq_save();
+    while (wake_first(wq)) {}
+    irq_restore(flags);
+    thread_preempt_point();
+}
+
+// --- Completions ---
+
+void completion_init(Completion *c) {
+    c->done = false;
+    wait_queue_init(&c->wq);
+}
+
+void reinit_completion(Completion *c) {
+    c->done = false;
+}
+
+void complete(Completion *c) {
+    c->done = true;
+    wait_queue_wake_all(&c->wq);
+}
+
+bool wait_for_completion_timeout(Completion *c, uint32_t timeout_ms) {
+    return wait_event_timeout(&c->wq, c->done, timeout_ms);
+}
+
+// --- Mutexes ---
+
+void mutex_init(Mutex *m) {
+    m->owner = NULL;
+    wait_queue_init(&m->wq);
+}
+
+void mutex_lock(Mutex *m) {
+    Thread *self = thread_current();
+    if (!self) return;
+    uint64_t flags = irq_save();
+    // Wakeups can be spurious, and the timeout only bounds each sleep
+    while (m->owner) {
+        wait_queue_sleep(&m->wq, clock_monotonic_ns() + CLOCK_NS_PER_SEC);
+    }
+    m->owner = self;
+    irq_restore(flags);
+}
+
+void mutex_unlock(Mutex *m) {
+    if (!thread_current()) return;
+    uint64_t flags = irq_save();
+    m->owner = NULL;
+    irq_restore(flags);
+    wait_queue_wake_one(&m->wq);
+}
@@ -0,0 +1,80 @@
+#ifndef WAIT_H
+#define WAIT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "clock.h"
+#include "io.h"
+
+// Wait queues: a thread sleeps on a queue until some event source (usually an
+// interrupt handler) wakes it, or until its deadline passes. The CPU halts in
+// the idle thread meanwhile instead of spinning. Before sched_init() a waiter
+// simply halts until the next interrupt and re-checks.
+//
+// Like the scheduler, queues are protected by disabling interrupts and are
+// only used on the bootstrap processor.
+
+typedef struct Waiter {
+    struct Thread *thread;
+    bool woken;
+    struct Waiter *next;
+} Waiter;
+
+typedef struct {
+    Waiter *head;
+} WaitQueue;
+
+#define WAIT_QUEUE_INIT {0}
+
+void wait_queue_init(WaitQueue *wq);
+
+// Sleep on wq until woken or until deadline_ns. Interrupts must be disabled;
+// they are still disabled on return. Returns true if woken, false on timeout.
+// Wakeups can be spurious: callers re-check their condition.
+bool wait_queue_sleep(WaitQueue *wq, uint64_t deadline_ns);
+
+// Safe to call from interrupt handlers
+void wait_queue_wake_one(WaitQueue *wq);
+void wait_queue_wake_all(WaitQueue *wq);
+
+// Block until cond is true or timeout_ms passes; evaluates to the final value
+// of cond. cond is re-checked with interrupts off, so a wakeup between the
+// check and the sleep is never lost.
+#define wait_event_timeout(wq, cond, timeout_ms) ({                              \
+    uint64_t _deadline = clock_monotonic_ns() + (uint64_t)(timeout_ms) * CLOCK_NS_PER_MS; \
+    uint64_t _flags = irq_save();                                                \
+    while (!(cond) && clock_monotonic_ns() < _deadline) {                        \
+        wait_queue_sleep((wq), _deadline);                                       \
+    }                                                                            \
+    bool _done = (cond);                                                         \
+    irq_restore(_flags);                                                         \
+    _done;                                                                       \
+})
+
+// One-shot events: complete() releases every current and future waiter until
+// reinit_completion().
+typedef struct {
+    volatile bool done;
+    WaitQueue wq;
+} Completion;
+
+void completion_init(Completion *c);
+void reinit_completion(Completion *c);
+void complete(Completion *c);
+bool wait_for_completion_timeout(Completion *c, uint32_t timeout_ms);
+
+// Sleeping lock for data shared between threads. Not for interrupt handlers
+// or softirqs, and not recursive. Before sched_init() there is only one
+// thread of execution and locking does nothing.
+typedef struct {
+    struct Thread *owner;
+    WaitQueue wq;
+} Mutex;
+
+#define MUTEX_INIT {0, WAIT_QUEUE_INIT}
+
+void mutex_init(Mutex *m);
+void mutex_lock(Mutex *m);
+void mutex_unlock(Mutex *m);
+
+#endif
@@ -7,6 +7,13 @@
 #include "explorer.h"
 #include "editor.h"
 #include "markdown.h"
+#include "perf.h"
+#include "clock.h"
+#include "timer.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "trace.h"
+#include "idt.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include "notepad.h"
@@ -64,9 +71,13 @@ static Window *all_windows[10];
 static int window_count = 0;
 
 // Redraw system
-static bool force_redraw = true;  // Force full redraw on next tick
-static uint32_t timer_ticks = 0;
-static int desktop_refresh_timer = 0;
+static bool force_redraw = true;  // Full redraw on the next frame
+static bool render_paused = false;  // Something else is driving wm_render_frame()
+
+static void request_full_redraw(void) {
+    force_redraw = true;
+    wm_request_frame();
+}
 
 // Cursor state
 static bool cursor_visible = true;
@@ -75,11 +86,33 @@ static int last_cursor_y = 300;
 
 // --- Desktop State ---
 #define MAX_DESKTOP_ICONS 32
+
+typedef enum {
+    ICON_FILE,
+    ICON_FOLDER,
+    ICON_DOCUMENT,
+    ICON_MARKDOWN,
+    ICON_NOTEPAD,
+    ICON_CALCULATOR,
+    ICON_TERMINAL,
+    ICON_MINESWEEPER,
+    ICON_CONTROL_PANEL,
+    ICON_ABOUT,
+    ICON_RECYCLE_BIN,
+    ICON_PAINT,
+    ICON_KIND_COUNT
+} IconKind;
+
 typedef struct {
     char name[64];
     int x, y;
     int type; // 0=File, 1=Folder, 2=App
     bool selected;
+    
+    // Cached at refresh time so painting needs no string matching
+    int icon_kind;
+    char label_line1[10];
+    char label_line2[10];
 } DesktopIcon;
 
 static DesktopIcon desktop_icons[MAX_DESKTOP_ICONS];
@@ -116,6 +149,42 @@ static int str_eq(const char *s1, const char *s2) {
     return *(const unsigned char*)s1 - *(const unsigned char*)s2;
 }
 
+static void icon_label_layout(const char *label, char *line1, char *line2);
+
+// Resolve the icon kind and wrapped label once, so wm_paint only blits
+static void resolve_desktop_icon(DesktopIcon *icon) {
+    if (icon->type == 1) {
+        icon->icon_kind = ICON_FOLDER;
+        icon_label_layout(icon->name, icon->label_line1, icon->label_line2);
+    } else if (icon->type == 2) {
+        // App icon - strip .shortcut for display
+        char label[64];
+        int len = 0;
+        while(icon->name[len] && len < 63) { label[len] = icon->name[len]; len++; }
+        label[len] = 0;
+        if (len > 9 && str_ends_with(label, ".shortcut")) {
+            label[len-9] = 0;
+        }
+        
+        if (str_starts_with(icon->name, "Notepad")) icon->icon_kind = ICON_NOTEPAD;
+        else if (str_starts_with(icon->name, "Calculator")) icon->icon_kind = ICON_CALCULATOR;
+        else if (str_starts_with(icon->name, "Terminal")) icon->icon_kind = ICON_TERMINAL;
+        else if (str_starts_with(icon->name, "Minesweeper")) icon->icon_kind = ICON_MINESWEEPER;
+        else if (str_starts_with(icon->name, "Control Panel")) icon->icon_kind = ICON_CONTROL_PANEL;
+        else if (str_starts_with(icon->name, "About")) icon->icon_kind = ICON_ABOUT;
+        else if (str_starts_with(icon->name, "Recycle Bin")) icon->icon_kind = ICON_RECYCLE_BIN;
+        else if (str_starts_with(icon->name, "Explorer")) icon->icon_kind = ICON_FOLDER;
+        else if (str_starts_with(icon->name, "Paint")) icon->icon_kind = ICON_PAINT;
+        else icon->icon_kind = ICON_FILE;
+        icon_label_layout(label, icon->label_line1, icon->label_line2);
+    } else {
+        if (str_ends_with(icon->name, ".pnt")) icon->icon_kind = ICON_PAINT;
+        else if (str_ends_with(icon->name, ".md")) icon->icon_kind = ICON_MARKDOWN;
+        else icon->icon_kind = ICON_DOCUMENT;
+        icon_label_layout(icon->name, icon->label_line1, icon->label_line2);
+    }
+}
+
 static void refresh_desktop_icons(void) {
     // Update limit in FS
     fat32_set_desktop_limit(desktop_max_cols * desktop_max_rows_per_col);
@@ -175,7 +244,10 @@ static void refresh_desktop_icons(void) {
     }
     
     desktop_icon_count = new_count;
-    for(int i=0; i<new_count; i++) desktop_icons[i] = new_icons[i];
+    for(int i=0; i<new_count; i++) {
+        desktop_icons[i] = new_icons[i];
+        resolve_desktop_icon(&desktop_icons[i]);
+    }
     kfree(files);
     
     // 3. Layout Icons
@@ -248,7 +320,7 @@ static void refresh_desktop_icons(void) {
 
 void wm_refresh_desktop(void) {
     refresh_desktop_icons();
-    force_redraw = true;
+    request_full_redraw();
 }
 
 static void create_desktop_shortcut(const char *app_name) {
@@ -272,12 +344,13 @@ void wm_show_message(const char *title, const char *message) {
     int i=0; while(title[i] && i<63) { msg_box_title[i] = title[i]; i++; } msg_box_title[i] = 0;
     i=0; while(message[i] && i<63) { msg_box_text[i] = message[i]; i++; } msg_box_text[i] = 0;
     msg_box_visible = true;
-    force_redraw = true;
+    request_full_redraw();
 }
 
-static void draw_icon_label(int x, int y, const char *label) {
-    char line1[10] = {0};
-    char line2[10] = {0};
+// Split a label into (up to) two centered 8-char lines for an 80px cell
+static void icon_label_layout(const char *label, char *line1, char *line2) {
+    line1[0] = 0;
+    line2[0] = 0;
     int len = 0; while(label[len]) len++;
     
     if (len <= 8) {
@@ -321,7 +394,9 @@ static void draw_icon_label(int x, int y, const char *label) {
             else { line2[j++] = '.'; line2[j++] = '.'; line2[j] = 0; }
         }
     }
-    
+}
+
+static void draw_icon_label_lines(int x, int y, const char *line1, const char *line2) {
     // Draw Line 1 Centered in 80px cell
     int l1_len = 0; while(line1[l1_len]) l1_len++;
     int l1_w = l1_len * 8;
@@ -336,6 +411,13 @@ static void draw_icon_label(int x, int y, const char *label) {
     }
 }
 
+static void draw_icon_label(int x, int y, const char *label) {
+    char line1[10];
+    char line2[10];
+    icon_label_layout(label, line1, line2);
+    draw_icon_label_lines(x, y, line1, line2);
+}
+
 // --- Drawing Helpers ---
 
 // Draw a bevelled box (Win 3.1 style)
@@ -397,19 +479,16 @@ void draw_coffee_cup(int x, int y, int size) {
     draw_rect(x + 2, coffee_y + stripe_height * 5, cup_w - 4, stripe_height, COLOR_APPLE_BLUE);
 }
 
-void draw_icon(int x, int y, const char *label) {
+static void render_file_glyph(int x, int y) {
     // Simple "File" Icon
     draw_rect(x + 29, y, 20, 25, COLOR_WHITE);
     draw_rect(x + 29, y, 20, 1, COLOR_BLACK);
     draw_rect(x + 29, y, 1, 25, COLOR_BLACK);
     draw_rect(x + 49, y, 1, 25, COLOR_BLACK);
     draw_rect(x + 29, y + 25, 21, 1, COLOR_BLACK);
-    
-    // Label
-    draw_icon_label(x, y, label);
 }
 
-void draw_folder_icon(int x, int y, const char *label) {
+static void render_folder_glyph(int x, int y) {
     // Folder icon (yellow folder)
     // Folder tab
     draw_rect(x + 27, y, 15, 6, COLOR_LTGRAY);
@@ -423,12 +502,9 @@ void draw_folder_icon(int x, int y, const char *label) {
     draw_rect(x + 27, y + 6, 1, 15, COLOR_BLACK);
     draw_rect(x + 51, y + 6, 1, 15, COLOR_BLACK);
     draw_rect(x + 27, y + 20, 25, 1, COLOR_BLACK);
-    
-    // Label
-    draw_icon_label(x, y, label);
 }
 
-void draw_document_icon(int x, int y, const char *label) {
+static void render_document_glyph(int x, int y) {
     // Document icon (white paper with lines)
     draw_rect(x + 29, y, 20, 25, COLOR_WHITE);
     draw_rect(x + 29, y, 20, 1, COLOR_BLACK);
@@ -440,12 +516,9 @@ void draw_document_icon(int x, int y, const char *label) {
     draw_rect(x + 33, y + 8, 12, 1, COLOR_BLACK);
     draw_rect(x + 33, y + 12, 12, 1, COLOR_BLACK);
     draw_rect(x + 33, y + 16, 12, 1, COLOR_BLACK);
-    
-    // Label
-    draw_icon_label(x, y, label);
 }
 
-void draw_notepad_icon(int x, int y, const char *label) {
+static void render_notepad_glyph(int x, int y) {
     // Notepad icon (Blue notebook)
     draw_rect(x + 29, y, 20, 25, COLOR_BLUE);
     draw_rect(x + 29, y, 20, 1, COLOR_BLACK);
@@ -459,11 +532,9 @@ void draw_notepad_icon(int x, int y, const char *label) {
     draw_rect(x + 33, y + 6, 13, 1, COLOR_GRAY);
     draw_rect(x + 33, y + 10, 13, 1, COLOR_GRAY);
     draw_rect(x + 33, y + 14, 13, 1, COLOR_GRAY);
-    
-    draw_icon_label(x, y, label);
 }
 
-void draw_calculator_icon(int x, int y, const char *label) {
+static void render_calculator_glyph(int x, int y) {
     // Calculator icon
     draw_rect(x + 29, y, 20, 25, COLOR_DKGRAY);
     draw_rect(x + 29, y, 20, 1, COLOR_BLACK);
@@ -480,11 +551,9 @@ void draw_calculator_icon(int x, int y, const char *label) {
             draw_rect(x + 32 + c*5, y + 12 + r*4, 3, 2, COLOR_WHITE);
         }
     }
-    
-    draw_icon_label(x, y, label);
 }
 
-void draw_terminal_icon(int x, int y, const char *label) {
+static void render_terminal_glyph(int x, int y) {
     // Terminal icon
     draw_rect(x + 27, y + 2, 24, 20, COLOR_BLACK);
     draw_rect(x + 27, y + 2, 24, 1, COLOR_GRAY);
@@ -497,11 +566,9 @@ void draw_terminal_icon(int x, int y, const char *label) {
     draw_rect(x + 32, y + 7, 2, 1, COLOR_APPLE_GREEN);
     draw_rect(x + 31, y + 8, 4, 1, COLOR_APPLE_GREEN);
     draw_rect(x + 37, y + 6, 6, 1, COLOR_APPLE_GREEN); // _
-    
-    draw_icon_label(x, y, label);
 }
 
-void draw_minesweeper_icon(int x, int y, const char *label) {
+static void render_minesweeper_glyph(int x, int y) {
     // Mine icon
     draw_rect(x + 29, y, 20, 25, COLOR_LTGRAY);
     draw_rect(x + 29, y, 20, 1, COLOR_BLACK);
@@ -515,11 +582,9 @@ void draw_minesweeper_icon(int x, int y, const char *label) {
     // Spikes
     draw_rect(x + 39, y + 6, 1, 12, COLOR_BLACK);
     draw_rect(x + 33, y + 12, 12, 1, COLOR_BLACK);
-    
-    draw_icon_label(x, y, label);
 }
 
-void draw_control_panel_icon(int x, int y, const char *label) {
+static void render_control_panel_glyph(int x, int y) {
     // Control Panel (Gear/Sliders)
     draw_rect(x + 29, y, 20, 25, COLOR_GRAY);
     draw_rect(x + 29, y, 20, 1, COLOR_BLACK);
@@ -533,11 +598,9 @@ void draw_control_panel_icon(int x, int y, const char *label) {
     
     draw_rect(x + 42, y + 5, 2, 15, COLOR_DKGRAY);
     draw_rect(x + 41, y + 16, 4, 3, COLOR_WHITE); // Knob
-    
-    draw_icon_label(x, y, label);
 }
 
-void draw_about_icon(int x, int y, const char *label) {
+static void render_about_glyph(int x, int y) {
     // About icon (Info)
     draw_rect(x + 29, y, 20, 25, COLOR_WHITE);
     draw_rect(x + 29, y, 20, 1, COLOR_BLACK);
@@ -548,11 +611,9 @@ void draw_about_icon(int x, int y, const char *label) {
     // 'i'
     draw_rect(x + 38, y + 5, 3, 3, COLOR_BLUE); // Dot
     draw_rect(x + 38, y + 10, 3, 10, COLOR_BLUE); // Body
-    
-    draw_icon_label(x, y, label);
 }
 
-void draw_recycle_bin_icon(int x, int y, const char *label) {
+static void render_recycle_bin_glyph(int x, int y) {
     // Recycle Bin (Trash can)
     draw_rect(x + 29, y, 20, 25, COLOR_LTGRAY);
     draw_rect(x + 29, y, 20, 1, COLOR_BLACK);
@@ -564,11 +625,9 @@ void draw_recycle_bin_icon(int x, int y, const char *label) {
     draw_rect(x + 32, y + 5, 2, 15, COLOR_DKGRAY);
     draw_rect(x + 38, y + 5, 2, 15, COLOR_DKGRAY);
     draw_rect(x + 44, y + 5, 2, 15, COLOR_DKGRAY);
-    
-    draw_icon_label(x, y, label);
 }
 
-void draw_paint_icon(int x, int y, const char *label) {
+static void render_paint_glyph(int x, int y) {
     // Paint Palette Icon
     draw_rect(x + 27, y + 2, 26, 20, COLOR_WHITE);
     draw_rect(x + 27, y + 2, 26, 1, COLOR_BLACK);
@@ -582,7 +641,104 @@ void draw_paint_icon(int x, int y, const char *label) {
     draw_rect(x + 46, y + 5, 4, 4, COLOR_APPLE_BLUE);
     draw_rect(x + 30, y + 13, 4, 4, COLOR_APPLE_YELLOW);
     draw_rect(x + 38, y + 13, 4, 4, COLOR_PURPLE);
+}
 
+static void render_markdown_glyph(int x, int y) {
+    render_document_glyph(x, y);
+    draw_string(x + 31, y + 2, "MD", COLOR_BLACK);
+}
+
+// --- Icon Cache ---
+// Every icon kind is rendered once into a bitmap covering the glyph area of
+// its 80px cell; painting an icon is then a single masked blit.
+#define ICON_BMP_X 27
+#define ICON_BMP_W 27
+#define ICON_BMP_H 26
+
+static void (*const icon_glyph_renderers[ICON_KIND_COUNT])(int x, int y) = {
+    [ICON_FILE]          = render_file_glyph,
+    [ICON_FOLDER]        = render_folder_glyph,
+    [ICON_DOCUMENT]      = render_document_glyph,
+    [ICON_MARKDOWN]      = render_markdown_glyph,
+    [ICON_NOTEPAD]       = render_notepad_glyph,
+    [ICON_CALCULATOR]    = render_calculator_glyph,
+    [ICON_TERMINAL]      = render_terminal_glyph,
+    [ICON_MINESWEEPER]   = render_minesweeper_glyph,
+    [ICON_CONTROL_PANEL] = render_control_panel_glyph,
+    [ICON_ABOUT]         = render_about_glyph,
+    [ICON_RECYCLE_BIN]   = render_recycle_bin_glyph,
+    [ICON_PAINT]         = render_paint_glyph,
+};
+
+static uint32_t icon_bitmaps[ICON_KIND_COUNT][ICON_BMP_W * ICON_BMP_H];
+static bool icon_cache_ready = false;
+
+static void icon_cache_init(void) {
+    for (int k = 0; k < ICON_KIND_COUNT; k++) {
+        graphics_begin_offscreen(icon_bitmaps[k], ICON_BMP_W, ICON_BMP_H);
+        icon_glyph_renderers[k](-ICON_BMP_X, 0);
+        graphics_end_offscreen();
+    }
+    icon_cache_ready = true;
+}
+
+static void draw_icon_bitmap(int kind, int x, int y) {
+    if (!icon_cache_ready) icon_cache_init();
+    graphics_blit_masked(x + ICON_BMP_X, y, ICON_BMP_W, ICON_BMP_H, icon_bitmaps[kind]);
+}
+
+void draw_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_FILE, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_folder_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_FOLDER, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_document_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_DOCUMENT, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_notepad_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_NOTEPAD, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_calculator_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_CALCULATOR, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_terminal_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_TERMINAL, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_minesweeper_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_MINESWEEPER, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_control_panel_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_CONTROL_PANEL, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_about_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_ABOUT, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_recycle_bin_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_RECYCLE_BIN, x, y);
+    draw_icon_label(x, y, label);
+}
+
+void draw_paint_icon(int x, int y, const char *label) {
+    draw_icon_bitmap(ICON_PAINT, x, y);
     draw_icon_label(x, y, label);
 }
 
@@ -692,51 +848,33 @@ static void draw_clock(int x, int y) {
 }
 
 // --- Main Paint Function ---
-void wm_paint(void) {
+// Repaint the part of the scene that lies inside one screen region. All drawing
+// goes through a frame clip, so anything outside the region is left as it is.
+static bool region_overlaps(int rx, int ry, int rw, int rh, int x, int y, int w, int h) {
+    return x < rx + rw && rx < x + w && y < ry + rh && ry < y + h;
+}
+
+static void wm_paint_region(int rx, int ry, int rw, int rh) {
     int sw = get_screen_width();
     int sh = get_screen_height();
     
+    graphics_set_frame_clip(rx, ry, rw, rh);
+    
     // First, erase the old cursor (before redrawing anything)
     if (cursor_visible) {
         erase_cursor(last_cursor_x, last_cursor_y);
     }
     
     // 1. Desktop
+    uint64_t t0 = clock_cycles();
     draw_desktop_background();
+    perf_stage_add(PERF_STAGE_BACKGROUND, clock_cycles() - t0);
     
-    // Draw Desktop Icons
+    // Draw Desktop Icons (kind and label are resolved by refresh_desktop_icons)
     for (int i = 0; i < desktop_icon_count; i++) {
         DesktopIcon *icon = &desktop_icons[i];
-        if (icon->type == 1) draw_folder_icon(icon->x, icon->y, icon->name);
-        else if (icon->type == 2) {
-            // App icon - strip .app for display
-            char label[64];
-            int len = 0;
-            while(icon->name[len] && len < 63) { label[len] = icon->name[len]; len++; }
-            label[len] = 0;
-            // Remove .app suffix if present
-            if (len > 9 && str_ends_with(label, ".shortcut")) {
-                label[len-9] = 0;
-            }
-            
-            if (str_starts_with(icon->name, "Notepad")) draw_notepad_icon(icon->x, icon->y, label);
-            else if (str_starts_with(icon->name, "Calculator")) draw_calculator_icon(icon->x, icon->y, label);
-            else if (str_starts_with(icon->name, "Terminal")) draw_terminal_icon(icon->x, icon->y, label);
-            else if (str_starts_with(icon->name, "Minesweeper")) draw_minesweeper_icon(icon->x, icon->y, label);
-            else if (str_starts_with(icon->name, "Control Panel")) draw_control_panel_icon(icon->x, icon->y, label);
-            else if (str_starts_with(icon->name, "About")) draw_about_icon(icon->x, icon->y, label);
-            else if (str_starts_with(icon->name, "Recycle Bin")) draw_recycle_bin_icon(icon->x, icon->y, label);
-            else if (str_starts_with(icon->name, "Explorer")) draw_folder_icon(icon->x, icon->y, label);
-            else if (str_starts_with(icon->name, "Paint")) draw_paint_icon(icon->x, icon->y, label);
-            else draw_icon(icon->x, icon->y, label);
-        } else {
-            if (str_ends_with(icon->name, ".pnt")) draw_paint_icon(icon->x, icon->y, icon->name);
-            else if (str_ends_with(icon->name, ".md")) {
-                draw_document_icon(icon->x, icon->y, icon->name);
-                draw_string(icon->x + 31, icon->y + 2, "MD", COLOR_BLACK);
-            }
-            else draw_document_icon(icon->x, icon->y, icon->name);
-        }
+        draw_icon_bitmap(icon->icon_kind, icon->x, icon->y);
+        draw_icon_label_lines(icon->x, icon->y, icon->label_line1, icon->label_line2);
     }
     
     // 3. Windows - sort by z-index and draw
@@ -756,9 +894,13 @@ void wm_paint(void) {
         }
     }
     
-    // Draw windows in z-order (lowest first)
+    // Draw windows in z-order (lowest first), skipping any outside the region
     for (int i = 0; i < window_count; i++) {
-        draw_window(sorted_windows[i]);
+        Window *win = sorted_windows[i];
+        if (!region_overlaps(rx, ry, rw, rh, win->x, win->y, win->w, win->h)) continue;
+        t0 = clock_cycles();
+        draw_window(win);
+        if (win->visible) perf_window_add(win->title, clock_cycles() - t0);
     }
     
     // 4. Taskbar
@@ -772,8 +914,10 @@ void wm_paint(void) {
     // Draw BrewOS text
     draw_string(35, sh - 18, "BrewOS", COLOR_BLACK);
     
-    // Clock
-    draw_clock(sw - 80, sh - 20);
+    // Clock (reading the RTC is slow, only do it when the clock is being repainted)
+    if (region_overlaps(rx, ry, rw, rh, sw - 80, sh - 20, 64, 8)) {
+        draw_clock(sw - 80, sh - 20);
+    }
     
     // 6. Start Menu (if open)
     if (start_menu_open) {
@@ -873,13 +1017,26 @@ void wm_paint(void) {
         else draw_document_icon(mx - 20, my - 20, "Moving...");
     }
     
+    // Performance overlay
+    if (perf_hud_visible()) {
+        perf_hud_draw();
+    }
+    
     // 7. Mouse cursor (draw last so it's on top)
     draw_cursor(mx, my);
     last_cursor_x = mx;
     last_cursor_y = my;
     
+    graphics_clear_frame_clip();
+}
+
+void wm_paint(void) {
+    wm_paint_region(0, 0, get_screen_width(), get_screen_height());
+    
     // Flip the buffer - display the rendered frame atomically
+    uint64_t t0 = clock_cycles();
     graphics_flip_buffer();
+    perf_stage_add(PERF_STAGE_FLIP, clock_cycles() - t0);
 }
 
 // --- Input Handling ---
@@ -888,6 +1045,92 @@ bool rect_contains(int x, int y, int w, int h, int px, int py) {
     return px >= x && px < x + w && py >= y && py < y + h;
 }
 
+// Summary of everything that decides where windows and overlays are on screen.
+// If it changes, pixels can't be reused and the whole screen is repainted.
+static uint32_t wm_layout_signature(void) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < window_count; i++) {
+        Window *win = all_windows[i];
+        uint32_t v[6] = { (uint32_t)win->visible | ((uint32_t)win->focused << 1),
+                          (uint32_t)win->z_index, (uint32_t)win->x, (uint32_t)win->y,
+                          (uint32_t)win->w, (uint32_t)win->h };
+        for (int j = 0; j < 6; j++) {
+            h = (h ^ v[j]) * 16777619u;
+        }
+    }
+    uint32_t overlays = (uint32_t)start_menu_open | ((uint32_t)desktop_menu_visible << 1) |
+                        ((uint32_t)msg_box_visible << 2) | ((uint32_t)is_dragging_file << 3) |
+                        ((uint32_t)desktop_dialog_state << 4);
+    h = (h ^ overlays) * 16777619u;
+    h = (h ^ (uint32_t)desktop_icon_count) * 16777619u;
+    return h;
+}
+
+// True if the window would be fully visible at (x, y): on top of every other
+// window, on-screen above the taskbar and not covered by a menu or overlay.
+static bool wm_window_unobscured(Window *win, int x, int y) {
+    int sw = get_screen_width();
+    int sh = get_screen_height();
+    
+    if (!win->visible) return false;
+    if (x < 0 || y < 0 || x + win->w > sw || y + win->h > sh - 28) return false;
+    if (start_menu_open || desktop_menu_visible || msg_box_visible ||
+        desktop_dialog_state != 0 || is_dragging_file || wm_custom_paint_hook) {
+        return false;
+    }
+    for (int i = 0; i < window_count; i++) {
+        Window *other = all_windows[i];
+        if (other != win && other->visible && other->z_index >= win->z_index) return false;
+    }
+    return true;
+}
+
+bool wm_scroll_window_region(Window *win, int x, int y, int w, int h, int dy) {
+    if (dy == 0) return true;
+    if (!wm_window_unobscured(win, win->x, win->y)) return false;
+    
+    uint64_t flags = irq_save();
+    if (dy <= -h || dy >= h) {
+        graphics_mark_dirty(x, y, w, h);
+    } else if (dy < 0) {
+        graphics_copy_rect(x, y - dy, w, h + dy, x, y);
+        graphics_mark_dirty(x, y + h + dy, w, -dy);
+    } else {
+        graphics_copy_rect(x, y, w, h - dy, x, y + dy);
+        graphics_mark_dirty(x, y, w, dy);
+    }
+    // The mouse cursor may have been copied along with the content
+    graphics_mark_dirty(last_cursor_x, last_cursor_y + dy, 10, 10);
+    irq_restore(flags);
+    return true;
+}
+
+// Move a window by copying its pixels to the new position and repainting only
+// the strips it uncovered. Returns false if a full repaint is needed instead.
+static bool wm_blit_window_move(Window *win, int old_x, int old_y) {
+    if (!wm_window_unobscured(win, old_x, old_y) || !wm_window_unobscured(win, win->x, win->y)) {
+        return false;
+    }
+    
+    int dx = win->x - old_x;
+    int dy = win->y - old_y;
+    if (dx == 0 && dy == 0) return true;
+    
+    graphics_copy_rect(old_x, old_y, win->w, win->h, win->x, win->y);
+    
+    if (dx >= win->w || -dx >= win->w || dy >= win->h || -dy >= win->h) {
+        // No overlap - everything under the old position is exposed
+        graphics_mark_dirty(old_x, old_y, win->w, win->h);
+    } else {
+        if (dx > 0) graphics_mark_dirty(old_x, old_y, dx, win->h);
+        else if (dx < 0) graphics_mark_dirty(win->x + win->w, old_y, -dx, win->h);
+        if (dy > 0) graphics_mark_dirty(old_x, old_y, win->w, dy);
+        else if (dy < 0) graphics_mark_dirty(old_x, win->y + win->h, win->w, -dy);
+    }
+    graphics_mark_dirty(last_cursor_x + dx, last_cursor_y + dy, 10, 10);
+    return true;
+}
+
 static void wm_bring_to_front(Window *win) {
     // Clear focus from all windows
     for (int i = 0; i < window_count; i++) {
@@ -916,7 +1159,7 @@ void wm_handle_click(int x, int y) {
         int my = (sh - mh) / 2;
         if (rect_contains(mx + mw/2 - 30, my + 70, 60, 20, x, y)) {
             msg_box_visible = false;
-            force_redraw = true;
+            request_full_redraw();
         }
         return;
     }
@@ -979,7 +1222,7 @@ void wm_handle_click(int x, int y) {
             }
         }
         desktop_menu_visible = false;
-        force_redraw = true;
+        request_full_redraw();
         return;
     }
 
@@ -994,19 +1237,19 @@ void wm_handle_click(int x, int y) {
             
             if (fat32_rename(old_path, new_path)) refresh_desktop_icons();
             desktop_dialog_state = 0;
-            force_redraw = true;
+            request_full_redraw();
             return;
         }
         if (rect_contains(dlg_x + 170, dlg_y + 65, 80, 25, x, y)) { // Cancel
             desktop_dialog_state = 0;
-            force_redraw = true;
+            request_full_redraw();
             return;
         }
         if (rect_contains(dlg_x + 10, dlg_y + 35, 280, 20, x, y)) {
             desktop_dialog_cursor = (x - dlg_x - 15) / 8;
             int len = 0; while(desktop_dialog_input[len]) len++;
             if (desktop_dialog_cursor > len) desktop_dialog_cursor = len;
-            force_redraw = true;
+            request_full_redraw();
             return;
         }
     }
@@ -1014,7 +1257,7 @@ void wm_handle_click(int x, int y) {
     // Check Start Button
     if (rect_contains(2, sh - 26, 90, 24, x, y)) {
         start_menu_open = !start_menu_open;
-        force_redraw = true;
+        request_full_redraw();
         pending_desktop_icon_click = -1;
         return;
     }
@@ -1089,7 +1332,7 @@ void wm_handle_click(int x, int y) {
         start_menu_open = false;
     }
     
-    force_redraw = true;
+    request_full_redraw();
 }
 
 // Handle right click (context menu or special actions)
@@ -1134,11 +1377,13 @@ void wm_handle_right_click(int x, int y) {
         }
     }
     
-    force_redraw = true;
+    request_full_redraw();
 }void wm_handle_mouse(int dx, int dy, uint8_t buttons) {
     int sw = get_screen_width();
     int sh = get_screen_height();
     
+    uint32_t layout_before = wm_layout_signature();
+    
     prev_mx = mx;
     prev_my = my;
     
@@ -1192,12 +1437,19 @@ void wm_handle_right_click(int x, int y) {
         int rel_x = mx - win_paint.x;
         int rel_y = my - win_paint.y;
         paint_handle_mouse(rel_x, rel_y);
-        force_redraw = true;
+        request_full_redraw();
     } else if (left && is_dragging && drag_window) {
+        int old_x = drag_window->x;
+        int old_y = drag_window->y;
         drag_window->x = mx - drag_offset_x;
         drag_window->y = my - drag_offset_y;
-        // Mark for full redraw since window moved
-        force_redraw = true;
+        // Shift the pixels already drawn; fall back to a full redraw if the
+        // window is partly covered or off-screen
+        if (wm_blit_window_move(drag_window, old_x, old_y)) {
+            layout_before = wm_layout_signature();
+        } else {
+            request_full_redraw();
+        }
     } else if (left && !is_dragging && !is_dragging_file && (dx != 0 || dy != 0)) {
         // Check deadzone
         int dist_x = mx - drag_start_x;
@@ -1246,14 +1498,14 @@ void wm_handle_right_click(int x, int y) {
                 }
             }
             
-            if (is_dragging_file) force_redraw = true;
+            if (is_dragging_file) request_full_redraw();
         }
         
     } else if (!left) {
         if (is_dragging) {
             is_dragging = false;
             drag_window = NULL;
-            force_redraw = true;
+            request_full_redraw();
         }
         
         // Handle Start Menu Click (Mouse Up without Drag)
@@ -1285,7 +1537,7 @@ void wm_handle_right_click(int x, int y) {
             
             start_menu_open = false;
             start_menu_pending_app = NULL;
-            force_redraw = true;
+            request_full_redraw();
         }
         
         // Handle Desktop Icon Click (Mouse Up)
@@ -1544,17 +1796,22 @@ void wm_handle_right_click(int x, int y) {
                 }
             }
             is_dragging_file = false;
-            force_redraw = true;
+            request_full_redraw();
         }
     }
     
     if (is_dragging_file) {
-        force_redraw = true;
+        request_full_redraw();
     }
     
     prev_left = left;
     prev_right = right;
     
+    // Windows opened, closed or raised without an explicit redraw
+    if (wm_layout_signature() != layout_before) {
+        request_full_redraw();
+    }
+    
     if (prev_mx != mx || prev_my != my) {
         // Cursor moved - just mark dirty cursor areas
         wm_mark_dirty(prev_mx, prev_my, 10, 10);
@@ -1596,7 +1853,7 @@ static void wm_dispatch_key(char c) {
             desktop_dialog_input[desktop_dialog_cursor] = c;
             desktop_dialog_cursor++;
         }
-        force_redraw = true;
+        request_full_redraw();
         return;
     }
 
@@ -1611,20 +1868,50 @@ static void wm_dispatch_key(char c) {
     
     if (!target) return;
     
+    uint32_t layout_before = wm_layout_signature();
+    
     if (target->handle_key) {
         target->handle_key(target, c);
     }
     
-    // Mark window as needing redraw on next timer tick
-    wm_mark_dirty(target->x, target->y, target->w, target->h);
+    if (wm_layout_signature() != layout_before) {
+        // The key opened, closed or moved something
+        request_full_redraw();
+    } else if (!target->partial_redraw) {
+        // Mark window as needing redraw on next timer tick
+        wm_mark_dirty(target->x, target->y, target->w, target->h);
+    }
 }
 
+static Thread *input_waiter = NULL;
+
 void wm_handle_key(char c) {
     int next = (key_head + 1) % INPUT_QUEUE_SIZE;
     if (next != key_tail) {
         key_queue[key_head] = c;
         key_head = next;
     }
+    if (input_waiter) {
+        Thread *t = input_waiter;
+        input_waiter = NULL;
+        thread_wake(t);
+    }
+}
+
+void wm_wait_for_input(void) {
+    uint64_t flags = irq_save();
+    while (key_head == key_tail) {
+        if (sched_running()) {
+            input_waiter = thread_current();
+            thread_block();
+        } else {
+            // sti;hlt is atomic, so a key queued after the check still wakes us
+            irqoff_end();
+            asm volatile ("sti; hlt; cli");
+            irqoff_begin();
+        }
+    }
+    irq_restore(flags);
 }
 
 void wm_process_input(void) {
@@ -1640,10 +1927,102 @@ void wm_mark_dirty(int x, int y, int w, int h) {
 }
 
 void wm_refresh(void) {
-    force_redraw = true;
+    request_full_redraw();
+}
+
+// --- Frame scheduling ---
+// Nothing repaints on a fixed tick. Marking something dirty asks for a frame,
+// which runs one frame interval after the previous one (or straight away if
+// the screen has been idle). The clock and the desktop icons have their own
+// once-a-second timer, so an idle desktop wakes about once a second.
+
+#define FRAME_INTERVAL_NS (CLOCK_NS_PER_SEC / TIMER_HZ)
+#define HUD_REFRESH_NS (250 * CLOCK_NS_PER_MS)
+
+static Timer frame_timer;
+static Timer second_timer;
+static Timer hud_timer;
+static uint64_t last_frame_ns = 0;
+static uint8_t last_second = 0xFF;
+
+// Painting a frame can take milliseconds, so the timer only hands it to the
+// worker thread. The mouse is handled there too, so windows don't move
+// underneath a frame.
+static void wm_frame_work(void *arg) {
+    (void)arg;
+    if (render_paused) return;
+    last_frame_ns = clock_monotonic_ns();
+    wm_render_frame();
+}
+
+static WorkItem frame_work = WORK_INIT(wm_frame_work, NULL);
+
+static void wm_frame(void *arg) {
+    (void)arg;
+    work_queue(&frame_work);
+}
+
+void wm_request_frame(void) {
+    uint64_t flags = irq_save();
+    // A queued frame picks up everything marked dirty before it runs
+    if (!timer_pending(&frame_timer) && !work_pending(&frame_work)) {
+        timer_start(&frame_timer, last_frame_ns + FRAME_INTERVAL_NS, wm_frame, NULL);
+    }
+    irq_restore(flags);
+}
+
+// Keep the performance overlay's numbers moving
+static void wm_hud_refresh(void *arg) {
+    (void)arg;
+    if (!perf_hud_visible()) return;
+    int hx, hy, hw, hh;
+    perf_hud_rect(&hx, &hy, &hw, &hh);
+    wm_mark_dirty(hx, hy, hw, hh);
+}
+
+// The per-second repaint. Refreshing the desktop icons lists a directory
+// and allocates, so like painting it runs on the worker thread rather than in
+// the timer softirq, which could land in the middle of a frame.
+static void wm_second_work(void *arg) {
+    (void)arg;
+    if (render_paused) return;
+    
+    // Mark clock area + a bit of buffer
+    int sw = get_screen_width();
+    int sh = get_screen_height();
+    wm_mark_dirty(sw - 90, sh - 30, 90, 20);
+    
+    // Auto-refresh desktop every second, but NOT while dragging something,
+    // to avoid state conflicts
+    if (!is_dragging && !is_dragging_file) {
+        refresh_desktop_icons();
+        request_full_redraw();
+    }
+}
+
+static WorkItem second_work = WORK_INIT(wm_second_work, NULL);
+
+// Runs just after the RTC's seconds change. The timer is aimed slightly early
+// and retries every 10ms until the RTC has ticked over, so the clock stays in
+// step without polling the RTC on every frame.
+static void wm_second_tick(void *arg) {
+    (void)arg;
+    uint64_t now = clock_monotonic_ns();
+    outb(0x70, 0x00);
+    uint8_t current_sec = inb(0x71);
+    
+    if (current_sec == last_second) {
+        timer_start(&second_timer, now + 10 * CLOCK_NS_PER_MS, wm_second_tick, NULL);
+        return;
+    }
+    last_second = current_sec;
+    timer_start(&second_timer, now + CLOCK_NS_PER_SEC - 5 * CLOCK_NS_PER_MS, wm_second_tick, NULL);
+    work_queue(&second_work);
 }
 
 void wm_init(void) {
+    icon_cache_init();
+    
     notepad_init();
     cmd_init();
     calculator_init();
@@ -1700,54 +2079,76 @@ void wm_init(void) {
     win_about.visible = false;
     win_minesweeper.visible = false;
     
-    force_redraw = true;
+    graphics_set_dirty_callback(wm_request_frame);
+    timer_start(&second_timer, clock_monotonic_ns(), wm_second_tick, NULL);
+    request_full_redraw();
 }
 
 uint32_t wm_get_ticks(void) {
-    return timer_ticks;
+    return (uint32_t)(clock_monotonic_ns() / FRAME_INTERVAL_NS);
 }
 
-// Called by timer interrupt ~60Hz
-void wm_timer_tick(void) {
-    timer_ticks++;
-    
-    // Auto-refresh desktop every second (approx 60 ticks)
-    // But NOT if we are currently dragging something, to avoid state conflicts
-    if (!is_dragging && !is_dragging_file) {
-        desktop_refresh_timer++;
-        if (desktop_refresh_timer >= 60) {
-            refresh_desktop_icons();
-            desktop_refresh_timer = 0;
-            force_redraw = true;
-        }
-    }
-    
-    // Only redraw if there are dirty areas (clock updates at most every second, cursor rarely moves in timer only)
-    // Most of the time, nothing changes between ticks
-    
-    static uint8_t last_second = 0xFF;
-    
-    outb(0x70, 0x00);
-    uint8_t current_sec = inb(0x71);
-    
-    if (current_sec != last_second) {
-        last_second = current_sec;
-        int sw = get_screen_width();
-        int sh = get_screen_height();
-        // Mark clock area + a bit of buffer
-        wm_mark_dirty(sw - 90, sh - 30, 90, 20);
-    }
-    
+void wm_set_render_paused(bool paused) {
+    render_paused = paused;
+}
+
+void wm_get_mouse_pos(int *x, int *y) {
+    *x = mx;
+    *y = my;
+}
+
+// Paint everything that is dirty right now. Normally called from the frame
+// work item; benchmarks call it directly to render as fast as possible.
+void wm_render_frame(void) {
     // If force_redraw is set, do a full redraw
     if (force_redraw) {
         graphics_mark_screen_dirty();
         force_redraw = false;
     }
     
-    // Perform redraw if there are dirty areas
-    DirtyRect dirty = graphics_get_dirty_rect();
-    if (dirty.active) {
+    // Repaint and flip each dirty region on its own. A full-screen region
+    // takes the plain full-frame path. Regions moved by graphics_copy_rect
+    // are already right in the back buffer and only get flipped.
+    // Shell threads keep marking things dirty and scrolling the back buffer
+    // (wm_scroll_window_region) under irq_save. The whole frame runs with
+    // interrupts off so a scroll can't move pixels between taking the lists
+    // and painting them, or shift a text buffer that is being painted from.
+    DirtyRect rects[GRAPHICS_MAX_DIRTY_RECTS];
+    DirtyRect flips[GRAPHICS_MAX_DIRTY_RECTS];
+    uint64_t flags = irq_save();
+    int count = graphics_get_dirty_rects(rects, GRAPHICS_MAX_DIRTY_RECTS);
+    if (count > 0) graphics_clear_dirty();
+    int flip_count = graphics_get_flip_rects(flips, GRAPHICS_MAX_DIRTY_RECTS);
+    if (flip_count > 0) graphics_clear_flip();
+    if (count == 0 && flip_count == 0) {
+        irq_restore(flags);
+        return;
+    }
+    // Anything marked dirty up to here is painted by this frame
+    timer_cancel(&frame_timer);
+    
+    TRACE_BEGIN(TRACE_CAT_WM, "wm_paint", count);
+    perf_frame_begin();
+    if (count == 1 && rects[0].w == get_screen_width() && rects[0].h == get_screen_height()) {
         wm_paint();
-        graphics_clear_dirty();
+    } else {
+        for (int i = 0; i < count; i++) {
+            wm_paint_region(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+            uint64_t t0 = clock_cycles();
+            graphics_flip_rect(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+            perf_stage_add(PERF_STAGE_FLIP, clock_cycles() - t0);
+        }
+        uint64_t t0 = clock_cycles();
+        for (int i = 0; i < flip_count; i++) {
+            graphics_flip_rect(flips[i].x, flips[i].y, flips[i].w, flips[i].h);
+        }
+        perf_stage_add(PERF_STAGE_FLIP, clock_cycles() - t0);
+    }
+    perf_frame_end();
+    TRACE_END(TRACE_CAT_WM, "wm_paint", count);
+    irq_restore(flags);
+    
+    if (perf_hud_visible() && !timer_pending(&hud_timer)) {
+        timer_start(&hud_timer, clock_monotonic_ns() + HUD_REFRESH_NS, wm_hud_refresh, NULL);
     }
 }
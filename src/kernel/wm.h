@@ -33,6 +33,7 @@ struct Window {
     int cursor_pos;
     bool focused;
     int z_index;  // Layering depth (higher = on top)
+    bool partial_redraw;  // Window marks its own dirty areas after keys (no full-window repaint)
     
     // Callbacks
     void (*paint)(Window *win);
@@ -46,6 +47,7 @@ void wm_handle_mouse(int dx, int dy, uint8_t buttons);
 void wm_handle_key(char c);
 void wm_handle_click(int x, int y);
 void wm_handle_right_click(int x, int y);
+void wm_wait_for_input(void);            // Block the calling thread until a key is queued
 void wm_process_input(void);
 
 // Redraw system
@@ -53,11 +55,19 @@ void wm_mark_dirty(int x, int y, int w, int h);
 void wm_refresh(void);
 void wm_paint(void);
 void wm_refresh_desktop(void);
-void wm_timer_tick(void);
+void wm_request_frame(void);             // Schedule a repaint of whatever is dirty
+void wm_render_frame(void);
+void wm_set_render_paused(bool paused);  // Frame timer stops painting (see wmbench)
+void wm_get_mouse_pos(int *x, int *y);
 uint32_t wm_get_ticks(void);
 int wm_get_desktop_icon_count(void);
 void wm_show_message(const char *title, const char *message);
 
+// Scroll part of a window by shifting the pixels already on screen (dy < 0 moves
+// content up). Only the exposed strip is marked dirty. Returns false if the
+// window is covered by something, in which case the caller must repaint normally.
+bool wm_scroll_window_region(Window *win, int x, int y, int w, int h, int dy);
+
 // Hook for external rendering (e.g. VM overlay)
 extern void (*wm_custom_paint_hook)(void);
 
@@ -0,0 +1,69 @@
+#include "workqueue.h"
+#include "thread.h"
+#include "io.h"
+#include <stddef.h>
+
+static WorkItem *work_head = NULL;
+static WorkItem *work_tail = NULL;
+static Thread *worker = NULL;
+static bool worker_waiting = false;
+
+void work_init(WorkItem *work, WorkFn fn, void *arg) {
+    work->fn = fn;
+    work->arg = arg;
+    work->pending = false;
+    work->next = NULL;
+}
+
+bool work_queue(WorkItem *work) {
+    uint64_t flags = irq_save();
+    if (work->pending) {
+        irq_restore(flags);
+        return false;
+    }
+    work->pending = true;
+    work->next = NULL;
+    if (work_tail) {
+        work_tail->next = work;
+    } else {
+        work_head = work;
+    }
+    work_tail = work;
+
+    // Only wake the worker from its own wait, not from a sleep inside an item
+    if (worker_waiting) {
+        worker_waiting = false;
+        thread_wake(worker);
+    }
+    irq_restore(flags);
+    return true;
+}
+
+bool work_pending(const WorkItem *work) {
+    return work->pending;
+}
+
+static void worker_main(void *arg) {
+    (void)arg;
+    for (;;) {
+        uint64_t flags = irq_save();
+        while (!work_head) {
+            worker_waiting = true;
+            thread_block();
+        }
+        WorkItem *work = work_head;
+        work_head = work->next;
+        if (!work_head) work_tail = NULL;
+        work->next = NULL;
+        work->pending = false;
+        irq_restore(flags);
+
+        work->fn(work->arg);
+    }
+}
+
+void workqueue_init(void) {
+    uint64_t flags = irq_save();
+    worker = thread_create("worker", worker_main, NULL, THREAD_PRIORITY_HIGH);
+    irq_restore(flags);
+}
@@ -0,0 +1,33 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Work queue: items run in order on a dedicated kernel thread with interrupts
+// enabled, so they may take as long as they need and may sleep. Interrupt
+// handlers and softirqs queue work; an item already queued is not queued
+// twice, which batches repeated requests into one run.
+
+typedef void (*WorkFn)(void *arg);
+
+typedef struct WorkItem {
+    WorkFn fn;
+    void *arg;
+    volatile bool pending;
+    struct WorkItem *next;
+} WorkItem;
+
+#define WORK_INIT(fn, arg) {(fn), (arg), false, NULL}
+
+void work_init(WorkItem *work, WorkFn fn, void *arg);
+
+// Safe from interrupts. Returns false if the item was already queued.
+bool work_queue(WorkItem *work);
+bool work_pending(const WorkItem *work);
+
+// Start the worker thread; items queued earlier run once it is up
+void workqueue_init(void);
+
+#endif